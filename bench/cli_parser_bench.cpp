@@ -0,0 +1,999 @@
+#include <cli_batch.h>
+#include <cli_parser.h>
+#include <cli_reload.h>
+#include <cli_static_schema.h>
+#include <cli_tokenizer.h>
+
+#include "compile_command.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+    // Counted per thread: multi-threaded cases report the measuring thread only
+    thread_local std::size_t allocation_count{};
+    thread_local std::size_t allocated_bytes{};
+
+    template<typename T>
+    void keep(T&& value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+    long peak_rss_kb()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters{};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+        return 0;
+#else
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return static_cast<long>(usage.ru_maxrss / 1024);
+#else
+        return static_cast<long>(usage.ru_maxrss);
+#endif
+#endif
+    }
+
+    struct NullBuffer : std::streambuf {
+        int overflow(int ch) override { return ch; }
+        std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+    };
+
+    // argv built once per size and reused by every iteration
+    struct Argv {
+        std::vector<std::string> storage;
+        std::vector<char*> pointers;
+
+        explicit Argv(std::size_t token_count)
+        {
+            static const char* const pattern[] = {
+                "--port=8080", "-a", "127.0.0.1", "--verbose", "--name=benchmark-value", "-t", "30s"
+            };
+
+            storage.emplace_back("program");
+            for (std::size_t i = 0; storage.size() < token_count; ++i)
+                storage.emplace_back(pattern[i % std::size(pattern)]);
+
+            // A value key must not be the last token
+            if (storage.back() == "-a" || storage.back() == "-t")
+                storage.back() = "--verbose";
+
+            for (auto& str : storage)
+                pointers.push_back(str.data());
+        }
+
+        int argc() const { return static_cast<int>(pointers.size()); }
+        char** argv() { return pointers.data(); }
+    };
+
+    void register_options(cliap::ArgParser& parser)
+    {
+        parser
+            .add_parameter(cliap::Arg().short_name("-h").long_name("--help").flag().description("show help message"))
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required().default_value("8080").description("listen port"))
+            .add_parameter(cliap::Arg().short_name("-a").long_name("--ip-address").required().description("ip address"))
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag().description("verbose output"))
+            .add_parameter(cliap::Arg().short_name("-n").long_name("--name").default_value("cli").description("instance name"))
+            .add_parameter(cliap::Arg().short_name("-t").long_name("--timeout").default_value("5s").description("request timeout"))
+            .add_parameter(cliap::Arg().short_name("-m").long_name("--max-memory").default_value("64MiB").description("memory limit"))
+            .add_parameter(cliap::Arg().short_name("-r").long_name("--ratio").default_value("0.75").description("sampling ratio"));
+
+        for (int i = 0; i < 24; ++i)
+            parser.add_parameter(cliap::Arg().long_name("--filler-option-" + std::to_string(i)).description("unused option"));
+    }
+
+    static constexpr auto static_schema = cliap::make_static_schema(
+        cliap::StaticArg().short_name("-h").long_name("--help").flag(),
+        cliap::StaticArg().short_name("-p").long_name("--port").required().default_value("8080"),
+        cliap::StaticArg().short_name("-a").long_name("--ip-address").required(),
+        cliap::StaticArg().short_name("-v").long_name("--verbose").flag(),
+        cliap::StaticArg().short_name("-n").long_name("--name").default_value("cli"),
+        cliap::StaticArg().short_name("-t").long_name("--timeout").default_value("5s")
+    );
+
+    struct Result {
+        std::string name;
+        std::size_t iterations{};
+        double ns_per_op{};
+        double allocs_per_op{};
+        double bytes_per_op{};
+        long peak_rss_kb{};
+    };
+
+    // Runs the measured operation the given number of times
+    using Body = std::function<void(std::size_t)>;
+
+    struct Benchmark {
+        std::string name;
+        // Builds the inputs outside of the measured time
+        std::function<Body()> prepare;
+    };
+
+    Result measure(const Benchmark& bench, std::chrono::nanoseconds min_time)
+    {
+        using clock = std::chrono::steady_clock;
+
+        bench.prepare()(1);
+
+        std::size_t iterations = 1;
+        std::chrono::nanoseconds elapsed{};
+        std::size_t allocs{};
+        std::size_t bytes{};
+
+        for (;;) {
+            const auto body = bench.prepare();
+
+            const auto allocs_before = allocation_count;
+            const auto bytes_before = allocated_bytes;
+            const auto start = clock::now();
+
+            body(iterations);
+
+            elapsed = clock::now() - start;
+            allocs = allocation_count - allocs_before;
+            bytes = allocated_bytes - bytes_before;
+
+            if (elapsed >= min_time || iterations >= (std::size_t{1} << 40))
+                break;
+
+            // Aim a bit past min_time, but never grow more than 10x per round
+            const auto per_op = std::max<double>(1.0, static_cast<double>(elapsed.count()) / iterations);
+            const auto wanted = static_cast<double>(min_time.count()) * 1.2 / per_op;
+            iterations = static_cast<std::size_t>(std::min(wanted, iterations * 10.0)) + 1;
+        }
+
+        Result result;
+        result.name = bench.name;
+        result.iterations = iterations;
+        result.ns_per_op = static_cast<double>(elapsed.count()) / iterations;
+        result.allocs_per_op = static_cast<double>(allocs) / iterations;
+        result.bytes_per_op = static_cast<double>(bytes) / iterations;
+        result.peak_rss_kb = peak_rss_kb();
+        return result;
+    }
+
+    // Parser-independent work; the regression gate scales timings by it to
+    // compare runs on machines of different speed
+    constexpr std::string_view calibration_benchmark = "calibrate/fnv1a/4096";
+
+    std::vector<Benchmark> make_benchmarks()
+    {
+        std::vector<Benchmark> benchmarks;
+
+        benchmarks.push_back({std::string{calibration_benchmark}, []() -> Body {
+            auto data = std::make_shared<std::vector<unsigned char>>(4096);
+            for (std::size_t i = 0; i < data->size(); ++i)
+                (*data)[i] = static_cast<unsigned char>(i * 31);
+
+            return [data](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    std::uint32_t hash = 2166136261u;
+                    for (const auto byte : *data)
+                        hash = (hash ^ byte) * 16777619u;
+                    keep(hash);
+                }
+            };
+        }});
+
+        for (const std::size_t size : {10u, 1000u, 100000u}) {
+            const auto suffix = std::to_string(size);
+
+            benchmarks.push_back({"parse/argv/" + suffix, [size]() -> Body {
+                auto args = std::make_shared<Argv>(size);
+                auto parser = std::make_shared<cliap::ArgParser>();
+                register_options(*parser);
+
+                return [args, parser](std::size_t n) {
+                    for (std::size_t i = 0; i < n; ++i)
+                        keep(parser->parse(args->argc(), args->argv()));
+                };
+            }});
+
+            benchmarks.push_back({"parse/argv/borrowed/" + suffix, [size]() -> Body {
+                auto args = std::make_shared<Argv>(size);
+                auto parser = std::make_shared<cliap::ArgParser>();
+                register_options(*parser);
+                parser->borrow_argv();
+
+                return [args, parser](std::size_t n) {
+                    for (std::size_t i = 0; i < n; ++i)
+                        keep(parser->parse(args->argc(), args->argv()));
+                };
+            }});
+
+            benchmarks.push_back({"parse/vector/" + suffix, [size]() -> Body {
+                auto args = std::make_shared<Argv>(size);
+                auto parser = std::make_shared<cliap::ArgParser>();
+                register_options(*parser);
+
+                return [args, parser](std::size_t n) {
+                    for (std::size_t i = 0; i < n; ++i)
+                        keep(parser->parse(args->storage));
+                };
+            }});
+
+            benchmarks.push_back({"parse/static/" + suffix, [size]() -> Body {
+                auto args = std::make_shared<Argv>(size);
+                auto parser = std::make_shared<cliap::StaticArgParser<static_schema.size()>>(static_schema);
+
+                return [args, parser](std::size_t n) {
+                    for (std::size_t i = 0; i < n; ++i)
+                        keep(parser->parse(args->argc(), args->argv()));
+                };
+            }});
+        }
+
+        benchmarks.push_back({"parse/schema/argv/10", []() -> Body {
+            auto args = std::make_shared<Argv>(10);
+            cliap::ArgParser parser;
+            register_options(parser);
+            auto schema = parser.schema();
+
+            return [args, schema](std::size_t n) {
+                cliap::ParseResult result;
+                for (std::size_t i = 0; i < n; ++i) {
+                    schema->parse(args->argc(), args->argv(), result);
+                    keep(result);
+                }
+            };
+        }});
+
+        // Wall time per parse with every hardware thread parsing its share
+        benchmarks.push_back({"parse/schema/argv/10/all_threads", []() -> Body {
+            auto args = std::make_shared<Argv>(10);
+            cliap::ArgParser parser;
+            register_options(parser);
+            auto schema = parser.schema();
+
+            return [args, schema](std::size_t n) {
+                const std::size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+                std::vector<std::thread> threads;
+                for (std::size_t t = 0; t < thread_count; ++t) {
+                    threads.emplace_back([&args, &schema, share = n / thread_count + (t < n % thread_count ? 1 : 0)] {
+                        // Each thread parses its own copy of argv
+                        Argv local{args->storage.size()};
+                        cliap::ParseResult result;
+                        for (std::size_t i = 0; i < share; ++i) {
+                            schema->parse(local.argc(), local.argv(), result);
+                            keep(result);
+                        }
+                    });
+                }
+
+                for (auto& thread : threads)
+                    thread.join();
+            };
+        }});
+
+        // A rejected command: the message with its suggestion, and the error alone
+        for (const bool message : {true, false}) {
+            benchmarks.push_back({message ? "parse/error/unknown_key" : "parse/error/unknown_key/try_parse", [message]() -> Body {
+                auto args = std::make_shared<std::vector<std::string>>(std::vector<std::string>{"program", "-p", "80", "--verbsoe"});
+                auto parser = std::make_shared<cliap::ArgParser>();
+                register_options(*parser);
+
+                return [args, parser, message](std::size_t n) {
+                    for (std::size_t i = 0; i < n; ++i) {
+                        if (message)
+                            keep(parser->parse(*args));
+                        else
+                            keep(parser->try_parse(*args));
+                    }
+                };
+            }});
+        }
+
+        benchmarks.push_back({"tokenize/command_line/1000", []() -> Body {
+            auto line = std::make_shared<std::string>();
+            const Argv args{1000};
+            for (const auto& token : args.storage)
+                *line += token + (token.size() % 3 ? " " : " 'quoted value' ");
+
+            return [line](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    cliap::ShellTokenizer tokenizer{*line};
+                    std::string_view token;
+                    while (tokenizer.next(token) == cliap::TokenStatus::token)
+                        keep(token);
+                }
+            };
+        }});
+
+        benchmarks.push_back({"parse/command_line/1000", []() -> Body {
+            auto line = std::make_shared<std::string>();
+            const Argv args{1000};
+            for (const auto& token : args.storage)
+                *line += token + ' ';
+
+            cliap::ArgParser parser;
+            register_options(parser);
+            auto schema = parser.schema();
+
+            return [line, schema](std::size_t n) {
+                cliap::ParseResult result;
+                for (std::size_t i = 0; i < n; ++i) {
+                    schema->parse_command_line(*line, result);
+                    keep(result);
+                }
+            };
+        }});
+
+        // A fresh result per command, released in one step with its arena,
+        // as a daemon handling operator commands would do
+        benchmarks.push_back({"parse/command_line/1000/arena", []() -> Body {
+            auto line = std::make_shared<std::string>();
+            const Argv args{1000};
+            for (const auto& token : args.storage)
+                *line += token + ' ';
+
+            cliap::ArgParser parser;
+            register_options(parser);
+            auto schema = parser.schema();
+            auto buffer = std::make_shared<std::vector<std::byte>>(64 * 1024);
+
+            return [line, schema, buffer](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    std::pmr::monotonic_buffer_resource arena{buffer->data(), buffer->size(), std::pmr::null_memory_resource()};
+                    cliap::ParseResult result{&arena};
+                    schema->parse_command_line(*line, result);
+                    keep(result);
+                }
+            };
+        }});
+
+        benchmarks.push_back({"parse/multi_value/100000", []() -> Body {
+            auto storage = std::make_shared<std::vector<std::string>>();
+            storage->push_back("program");
+            storage->push_back("--input");
+            for (std::size_t i = 0; i < 100000; ++i)
+                storage->push_back("input-" + std::to_string(i));
+
+            auto args = std::make_shared<std::vector<char*>>();
+            for (auto& str : *storage)
+                args->push_back(str.data());
+
+            auto parser = std::make_shared<cliap::ArgParser>();
+            register_options(*parser);
+            parser->add_parameter(cliap::Arg().short_name("-i").long_name("--input").multi_value());
+
+            return [storage, args, parser](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    keep(parser->parse(static_cast<int>(args->size()), args->data()));
+                    for (const auto value : parser->arg("input").values())
+                        keep(value);
+                }
+            };
+        }});
+
+        benchmarks.push_back({"parse/response_file/1000000", []() -> Body {
+            static const auto path = std::filesystem::temp_directory_path() / "cli_parser_bench.rsp";
+            static const bool written = [] {
+                std::ofstream out{path, std::ios::binary};
+                const Argv args{1000000};
+                for (std::size_t i = 1; i < args.storage.size(); ++i)
+                    out << args.storage[i] << '\n';
+                return static_cast<bool>(out);
+            }();
+
+            auto rsp = std::make_shared<std::string>("@" + path.string());
+            auto parser = std::make_shared<cliap::ArgParser>();
+            register_options(*parser);
+            parser->allow_response_files();
+
+            return [rsp, parser](std::size_t n) {
+                char program[] = "program";
+                char* argv[] = {program, rsp->data()};
+                for (std::size_t i = 0; i < n && written; ++i)
+                    keep(parser->parse(2, argv));
+            };
+        }});
+
+        benchmarks.push_back({"parse/config_file/5000", []() -> Body {
+            static constexpr std::size_t key_count = 5000;
+            static const auto path = std::filesystem::temp_directory_path() / "cli_parser_bench.ini";
+            static const bool written = [] {
+                std::ofstream out{path, std::ios::binary};
+                out << "# generated\n[service]\n";
+                for (std::size_t i = 0; i < key_count; ++i)
+                    out << "key" << i << " = " << (i % 2 ? "\"quoted value\"" : "1024") << '\n';
+                return static_cast<bool>(out);
+            }();
+
+            auto parser = std::make_shared<cliap::ArgParser>();
+            for (std::size_t i = 0; i < key_count; ++i)
+                parser->add_parameter(cliap::Arg().long_name("service.key" + std::to_string(i)));
+            parser->add_config_file(path.string());
+
+            return [parser](std::size_t n) {
+                char program[] = "program";
+                char* argv[] = {program};
+                for (std::size_t i = 0; i < n && written; ++i)
+                    keep(parser->parse(1, argv));
+            };
+        }});
+
+        // Wall time per manifest of command lines, on every hardware thread
+        benchmarks.push_back({"batch/validate/100000", []() -> Body {
+            auto manifest = std::make_shared<std::string>();
+            for (std::size_t i = 0; i < 100000; ++i)
+                *manifest += "program --port " + std::to_string(i % 65536) + " -a 127.0.0.1 --name 'batch line' -v\n";
+
+            cliap::ArgParser parser;
+            register_options(parser);
+            auto validator = std::make_shared<cliap::BatchValidator>(parser.schema());
+
+            return [manifest, validator](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(validator->validate(*manifest));
+            };
+        }});
+
+        // Compare with parse/argv/10: the same state, restored instead of parsed
+        benchmarks.push_back({"snapshot/load/10", []() -> Body {
+            Argv args{10};
+            cliap::ArgParser supervisor;
+            register_options(supervisor);
+            supervisor.parse(args.argc(), args.argv());
+            auto snapshot = std::make_shared<std::string>(supervisor.save_snapshot());
+
+            auto worker = std::make_shared<cliap::ArgParser>();
+            register_options(*worker);
+
+            return [snapshot, worker](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(static_cast<bool>(worker->load_snapshot(*snapshot)));
+            };
+        }});
+
+        // What a reader of a reloadable config pays per look at a value
+        benchmarks.push_back({"reload/snapshot", []() -> Body {
+            cliap::ArgParser parser;
+            register_options(parser);
+            auto config = std::make_shared<cliap::LiveConfig>(parser.schema(),
+                std::vector<std::string>{"program", "--port", "8080", "-a", "127.0.0.1"});
+
+            return [config](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(config->snapshot()->arg("port").value_view().size());
+            };
+        }});
+
+        benchmarks.push_back({"register/32", []() -> Body {
+            return [](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    cliap::ArgParser parser;
+                    register_options(parser);
+                    keep(parser);
+                }
+            };
+        }});
+
+        benchmarks.push_back({"lookup/arg", []() -> Body {
+            auto parser = std::make_shared<cliap::ArgParser>();
+            register_options(*parser);
+
+            return [parser](std::size_t n) {
+                static const std::string names[] = {"p", "port", "ip-address", "v", "filler-option-17", "missing"};
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(parser->arg(names[i % std::size(names)]));
+            };
+        }});
+
+        benchmarks.push_back({"lookup/static", []() -> Body {
+            return [](std::size_t n) {
+                static constexpr std::string_view names[] = {"p", "port", "ip-address", "v", "timeout", "missing"};
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(static_schema.find(names[i % std::size(names)]));
+            };
+        }});
+
+        // A hot loop reading a setting by name or through a typed handle
+        benchmarks.push_back({"read/arg", []() -> Body {
+            auto parser = std::make_shared<cliap::ArgParser>();
+            register_options(*parser);
+
+            return [parser](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(parser->arg("port").get_value_as<int>());
+            };
+        }});
+
+        benchmarks.push_back({"read/handle", []() -> Body {
+            auto parser = std::make_shared<cliap::ArgParser>();
+            register_options(*parser);
+            const auto port = parser->add_parameter_as<int>(cliap::Arg().long_name("--bound-port").default_value("8080"));
+
+            return [parser, port](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(*port);
+            };
+        }});
+
+        const auto conversion = [](std::string value, auto read) {
+            return [value, read]() -> Body {
+                auto arg = std::make_shared<cliap::Arg>();
+                arg->value(value);
+
+                return [arg, read](std::size_t n) {
+                    for (std::size_t i = 0; i < n; ++i)
+                        keep(read(*arg));
+                };
+            };
+        };
+
+        benchmarks.push_back({"convert/int", conversion("8080", [](const cliap::Arg& a) { return a.get_value_as<int>(); })});
+        benchmarks.push_back({"convert/hex", conversion("0x7fffffff", [](const cliap::Arg& a) { return a.get_value_as<long>(); })});
+        benchmarks.push_back({"convert/double", conversion("0.75", [](const cliap::Arg& a) { return a.get_value_as<double>(); })});
+        benchmarks.push_back({"convert/bool", conversion("yes", [](const cliap::Arg& a) { return a.get_value_as<bool>(); })});
+        benchmarks.push_back({"convert/string", conversion("benchmark-value", [](const cliap::Arg& a) { return a.get_value_as<std::string>(); })});
+        benchmarks.push_back({"convert/size", conversion("1.5GiB", [](const cliap::Arg& a) { return a.get_value_as_size().value; })});
+        benchmarks.push_back({"convert/duration", conversion("1h30m", [](const cliap::Arg& a) { return a.get_value_as_duration().value; })});
+
+        benchmarks.push_back({"all_params", []() -> Body {
+            auto parser = std::make_shared<cliap::ArgParser>();
+            register_options(*parser);
+
+            return [parser](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(parser->all_params().size());
+            };
+        }});
+
+        benchmarks.push_back({"print_help", []() -> Body {
+            auto parser = std::make_shared<cliap::ArgParser>();
+            register_options(*parser);
+            parser->add_usage_string("program --port 8080 -a 127.0.0.1");
+
+            return [parser](std::size_t n) {
+                NullBuffer null_buffer;
+                auto* const saved = std::cout.rdbuf(&null_buffer);
+                for (std::size_t i = 0; i < n; ++i)
+                    parser->print_help();
+                std::cout.rdbuf(saved);
+            };
+        }});
+
+        // Cold start of a multi-tool with 64 commands of 32 options each:
+        // one flat parser with every option against lazily built commands
+        benchmarks.push_back({"startup/flat/64x32", []() -> Body {
+            return [](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    cliap::ArgParser parser;
+                    for (int command = 0; command < 64; ++command)
+                        for (int option = 0; option < 32; ++option)
+                            parser.add_parameter(cliap::Arg().long_name("--cmd" + std::to_string(command) + "-option-" + std::to_string(option)));
+
+                    std::string prog{"tool"}, arg{"--cmd7-option-3=x"};
+                    char* argv[] = {prog.data(), arg.data()};
+                    keep(parser.parse(2, argv));
+                }
+            };
+        }});
+
+        benchmarks.push_back({"startup/commands/64x32", []() -> Body {
+            return [](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    cliap::ArgParser parser;
+                    for (int command = 0; command < 64; ++command)
+                        parser.add_command("cmd" + std::to_string(command), "a command", [](cliap::ArgParser& sub) {
+                            for (int option = 0; option < 32; ++option)
+                                sub.add_parameter(cliap::Arg().long_name("--option-" + std::to_string(option)));
+                        });
+
+                    std::string prog{"tool"}, command{"cmd7"}, arg{"--option-3=x"};
+                    char* argv[] = {prog.data(), command.data(), arg.data()};
+                    keep(parser.parse(3, argv));
+                }
+            };
+        }});
+
+        // Every other width forces the text to be formatted again
+        benchmarks.push_back({"help_text/rebuild", []() -> Body {
+            auto parser = std::make_shared<cliap::ArgParser>();
+            register_options(*parser);
+            parser->add_usage_string("program --port 8080 -a 127.0.0.1");
+
+            return [parser](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(parser->help_text(80 + i % 2).size());
+            };
+        }});
+
+        // A completion request runs once per keypress of Tab
+        benchmarks.push_back({"complete/options", []() -> Body {
+            auto parser = std::make_shared<cliap::ArgParser>();
+            register_options(*parser);
+
+            return [parser](std::size_t n) {
+                const char* words[] = {"-v", "--filler-option-1"};
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(parser->complete(2, words).size());
+            };
+        }});
+
+        // The whole request as a process sees it: registration included
+        benchmarks.push_back({"complete/startup/commands/64x32", []() -> Body {
+            return [](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    cliap::ArgParser parser;
+                    for (int command = 0; command < 64; ++command)
+                        parser.add_command("cmd" + std::to_string(command), "a command", [](cliap::ArgParser& sub) {
+                            for (int option = 0; option < 32; ++option)
+                                sub.add_parameter(cliap::Arg().long_name("--option-" + std::to_string(option)));
+                        });
+
+                    const char* words[] = {"cmd7", "--option-1"};
+                    keep(parser.complete(2, words).size());
+                }
+            };
+        }});
+
+        // A misspelt key makes the parser rank every known name
+        benchmarks.push_back({"suggest/unknown/4096", []() -> Body {
+            auto parser = std::make_shared<cliap::ArgParser>();
+            for (int i = 0; i < 4096; ++i)
+                parser->add_parameter(cliap::Arg().long_name("--option-" + std::to_string(i)));
+
+            return [parser](std::size_t n) {
+                std::string prog{"tool"}, arg{"--opton-1234=x"};
+                char* argv[] = {prog.data(), arg.data()};
+                for (std::size_t i = 0; i < n; ++i)
+                    keep(parser->parse(2, argv));
+            };
+        }});
+
+        // What including cli_parser.h costs a consumer, in compiler time
+        benchmarks.push_back({"compile/consumer", []() -> Body {
+            return [](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (std::system(CLI_PARSER_COMPILE_COMMAND) != 0) {
+                        std::cerr << "compile/consumer: failed to run " << CLI_PARSER_COMPILE_COMMAND << "\n";
+                        std::exit(EXIT_FAILURE);
+                    }
+                }
+            };
+        }});
+
+        return benchmarks;
+    }
+
+    std::string json_escape(const std::string& str)
+    {
+        std::string out;
+        for (const char ch : str) {
+            if (ch == '"' || ch == '\\')
+                out += '\\';
+            out += ch;
+        }
+        return out;
+    }
+
+    // Allocations per operation once the body is warmed up; exact for a build
+    double count_allocations(const Benchmark& bench)
+    {
+        constexpr std::size_t iterations = 8;
+
+        // Parse storage settles on the second parse, when its chunks are
+        // merged into one
+        const auto body = bench.prepare();
+        body(2);
+
+        const auto before = allocation_count;
+        body(iterations);
+        return static_cast<double>(allocation_count - before) / iterations;
+    }
+
+    bool write_json(const std::string& path, const std::vector<Result>& results)
+    {
+        std::ofstream out{path};
+        if (!out)
+            return false;
+
+        out << "{\n  \"version\": 1,\n  \"peak_rss_kb\": " << peak_rss_kb() << ",\n  \"benchmarks\": [\n";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            out << "    {\"name\": \"" << json_escape(r.name) << "\""
+                << ", \"iterations\": " << r.iterations
+                << ", \"ns_per_op\": " << r.ns_per_op
+                << ", \"allocs_per_op\": " << r.allocs_per_op
+                << ", \"bytes_per_op\": " << r.bytes_per_op
+                << ", \"peak_rss_kb\": " << r.peak_rss_kb
+                << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+
+        return static_cast<bool>(out);
+    }
+
+    struct Baseline {
+        std::string name;
+        double ns_per_op{};
+        double allocs_per_op{};
+    };
+
+    // Reads the benchmarks of a file written by write_json(), one per line
+    bool read_json(const std::string& path, std::vector<Baseline>& baselines)
+    {
+        std::ifstream in{path};
+        if (!in)
+            return false;
+
+        const auto number = [](const std::string& line, const std::string& key) {
+            const auto pos = line.find("\"" + key + "\": ");
+            return pos == std::string::npos ? -1.0 : std::strtod(line.c_str() + pos + key.size() + 4, nullptr);
+        };
+
+        constexpr std::string_view name_key = "{\"name\": \"";
+        for (std::string line; std::getline(in, line);) {
+            const auto name = line.find(name_key);
+            if (name == std::string::npos)
+                continue;
+
+            const auto begin = name + name_key.size();
+            const auto end = line.find('"', begin);
+            baselines.push_back({line.substr(begin, end - begin), number(line, "ns_per_op"), number(line, "allocs_per_op")});
+        }
+
+        return true;
+    }
+
+    struct GateOptions {
+        std::chrono::nanoseconds min_time;
+        // Allowed slowdown as a fraction of the baseline
+        double tolerance;
+        bool timing;
+        bool update;
+    };
+
+    // Runs the benchmarks named in the baseline file and fails when one got
+    // slower by more than the tolerance or allocates more. Each benchmark is
+    // timed as the best of a few runs alternating with the calibration
+    // benchmark, and only the ratio of the two is compared, which absorbs
+    // the speed of the machine and of the moment. An apparent slowdown is
+    // measured again before it counts. With update, the file is rewritten
+    // with this run instead.
+    int check_baseline(const std::string& path, const GateOptions& options)
+    {
+        constexpr int repetitions = 3;
+        constexpr int attempts = 3;
+
+        std::vector<Baseline> baselines;
+        if (!read_json(path, baselines) || baselines.empty()) {
+            std::cerr << "Unable to read baselines from " << path << "\n";
+            return EXIT_FAILURE;
+        }
+
+        const auto benchmarks = make_benchmarks();
+        const auto find = [&benchmarks](std::string_view name) {
+            return std::find_if(benchmarks.begin(), benchmarks.end(), [name](const Benchmark& b) { return b.name == name; });
+        };
+
+        const auto calibration = find(calibration_benchmark);
+        const auto calibration_baseline = std::find_if(baselines.begin(), baselines.end(),
+            [](const Baseline& b) { return b.name == calibration_benchmark; });
+        const bool timing = options.timing || options.update;
+        if (timing && calibration_baseline == baselines.end() && !options.update) {
+            std::cerr << "The baseline has no " << calibration_benchmark << " entry\n";
+            return EXIT_FAILURE;
+        }
+
+        std::vector<Result> results;
+        double best_calibration = std::numeric_limits<double>::max();
+        int failures{};
+
+        if (!options.update)
+            std::printf("%-34s %12s %12s %8s %12s %12s  %s\n", "benchmark", "base ns/op", "ns/op", "ratio", "base allocs", "allocs", "status");
+
+        for (const auto& baseline : baselines) {
+            const auto bench = find(baseline.name);
+            if (bench == benchmarks.end()) {
+                std::cerr << "Unknown benchmark in the baseline: " << baseline.name << "\n";
+                ++failures;
+                continue;
+            }
+
+            Result best;
+            best.name = bench->name;
+            best.ns_per_op = std::numeric_limits<double>::max();
+            double calibration_ns = std::numeric_limits<double>::max();
+            double ratio{};
+
+            for (int attempt = 0; timing && attempt < attempts; ++attempt) {
+                for (int i = 0; i < repetitions; ++i) {
+                    calibration_ns = std::min(calibration_ns, measure(*calibration, options.min_time).ns_per_op);
+                    const auto result = measure(*bench, options.min_time);
+                    if (result.ns_per_op < best.ns_per_op)
+                        best = result;
+                }
+
+                if (options.update || baseline.ns_per_op <= 0 || bench == calibration)
+                    break;
+
+                ratio = (best.ns_per_op / baseline.ns_per_op) / (calibration_ns / calibration_baseline->ns_per_op);
+                if (ratio <= 1.0 + options.tolerance)
+                    break;
+            }
+
+            best_calibration = std::min(best_calibration, calibration_ns);
+            best.allocs_per_op = count_allocations(*bench);
+            results.push_back(best);
+
+            if (options.update)
+                continue;
+
+            const char* status = "ok";
+            if (best.allocs_per_op > baseline.allocs_per_op) {
+                status = "FAIL: allocates more";
+                ++failures;
+            } else if (timing && ratio > 1.0 + options.tolerance) {
+                status = "FAIL: slower";
+                ++failures;
+            } else if (best.allocs_per_op < baseline.allocs_per_op) {
+                status = "ok, allocates less: update the baseline";
+            }
+
+            std::printf("%-34s %12.1f %12.1f %8.2f %12.2f %12.2f  %s\n", best.name.c_str(), baseline.ns_per_op,
+                timing ? best.ns_per_op : 0.0, ratio, baseline.allocs_per_op, best.allocs_per_op, status);
+        }
+
+        if (options.update) {
+            for (auto& result : results)
+                if (result.name == calibration_benchmark)
+                    result.ns_per_op = best_calibration;
+
+            if (failures || !write_json(path, results)) {
+                std::cerr << "Unable to update " << path << "\n";
+                return EXIT_FAILURE;
+            }
+            std::printf("Recorded %zu baselines in %s\n", results.size(), path.c_str());
+            return EXIT_SUCCESS;
+        }
+
+        if (timing)
+            std::printf("Ratios are relative to %s, tolerance %.0f%%\n", std::string{calibration_benchmark}.c_str(), options.tolerance * 100);
+
+        return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+}
+
+// The replacements stay out of line: once LTO inlines them into the
+// library, GCC sees free() called on what operator new returned and warns
+// of a mismatch (-Wmismatched-new-delete) that is not one
+#if defined(__GNUC__) || defined(__clang__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    allocated_bytes += size;
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+BENCH_NOINLINE void operator delete(void* ptr) noexcept { std::free(ptr); }
+BENCH_NOINLINE void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+// The default memory resource of std::pmr allocates through the aligned forms
+BENCH_NOINLINE void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    ++allocation_count;
+    allocated_bytes += size;
+    const auto align = static_cast<std::size_t>(alignment);
+#if defined(_MSC_VER)
+    if (void* ptr = _aligned_malloc(size ? size : 1, align))
+        return ptr;
+#else
+    if (void* ptr = std::aligned_alloc(align, (size + align) / align * align))
+        return ptr;
+#endif
+    throw std::bad_alloc{};
+}
+
+#if defined(_MSC_VER)
+BENCH_NOINLINE void operator delete(void* ptr, std::align_val_t) noexcept { _aligned_free(ptr); }
+BENCH_NOINLINE void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { _aligned_free(ptr); }
+#else
+BENCH_NOINLINE void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+BENCH_NOINLINE void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+#endif
+
+int main(int argc, char* argv[])
+{
+    cliap::ArgParser cli;
+    cli
+        .add_parameter(cliap::Arg().short_name("-h").long_name("--help").flag().description("show help message"))
+        .add_parameter(cliap::Arg().short_name("-j").long_name("--json").description("write results as JSON to this file"))
+        .add_parameter(cliap::Arg().short_name("-f").long_name("--filter").description("run only benchmarks whose name contains this string"))
+        .add_parameter(cliap::Arg().short_name("-t").long_name("--min-time").default_value("200ms").description("minimum measured time per benchmark"))
+        .add_parameter(cliap::Arg().long_name("--check").description("run the benchmarks of this baseline file and fail on regressions"))
+        .add_parameter(cliap::Arg().long_name("--tolerance").default_value("1.0").description("allowed slowdown for --check, as a fraction of the baseline"))
+        .add_parameter(cliap::Arg().long_name("--no-timing").flag().description("make --check compare allocation counts only"))
+        .add_parameter(cliap::Arg().long_name("--update").flag().description("rewrite the --check baseline file with this run"));
+    cli.add_usage_string("cli_parser_bench [--filter parse/] [--json results.json] [--min-time 200ms]");
+    cli.add_usage_string("cli_parser_bench --check baseline.json [--tolerance 1.0] [--no-timing | --update]");
+
+    if (const auto error = cli.parse(argc, argv)) {
+        std::cerr << *error << "\n";
+        return EXIT_FAILURE;
+    }
+
+    if (cli.arg("help").is_parsed()) {
+        cli.print_help();
+        return EXIT_SUCCESS;
+    }
+
+    const auto min_time = cli.arg("min-time").get_value_as_duration();
+    if (!min_time) {
+        std::cerr << "--min-time: " << cliap::convert_error_message(min_time.error) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    if (const auto baseline = cli.arg("check").value(); !baseline.empty()) {
+        const auto tolerance = cli.arg("tolerance").try_get_value_as<double>();
+        if (!tolerance || tolerance.value < 0) {
+            std::cerr << "--tolerance: expected a non-negative number\n";
+            return EXIT_FAILURE;
+        }
+
+        return check_baseline(baseline, {min_time.value, tolerance.value, !cli.arg("no-timing").is_parsed(), cli.arg("update").is_parsed()});
+    }
+
+    const auto filter = cli.arg("filter").value();
+    std::vector<Result> results;
+
+    std::printf("%-30s %14s %14s %14s %14s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op", "peak RSS KB");
+    for (const auto& bench : make_benchmarks()) {
+        if (!filter.empty() && bench.name.find(filter) == std::string::npos)
+            continue;
+
+        results.push_back(measure(bench, min_time.value));
+        const auto& r = results.back();
+        std::printf("%-30s %14zu %14.1f %14.2f %14.1f %12ld\n",
+            r.name.c_str(), r.iterations, r.ns_per_op, r.allocs_per_op, r.bytes_per_op, r.peak_rss_kb);
+    }
+
+    if (const auto json = cli.arg("json").value(); !json.empty() && !write_json(json, results)) {
+        std::cerr << "Unable to write " << json << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,33 @@
+// A typical includer of cli_parser.h, compiled by the compile/consumer
+// benchmark to time what the header costs every translation unit using it
+#include <cli_parser.h>
+
+#include <string>
+
+namespace {
+    struct Options {
+        int port{};
+        bool verbose{};
+        std::string name;
+    };
+}
+
+int configure(int argc, char* argv[])
+{
+    Options options;
+
+    cliap::ArgParser parser;
+    parser
+        .add_parameter(cliap::Arg().short_name("-h").long_name("--help").flag().description("show help message"))
+        .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag().description("verbose output"))
+        .add_parameter(cliap::Arg().short_name("-n").long_name("--name").default_value("cli").description("instance name"));
+    auto port = parser.add_parameter_as<int>(cliap::Arg().short_name("-p").long_name("--port").default_value("8080"), &options.port);
+    port.range(1, 65535);
+
+    if (const auto error = parser.parse(argc, argv))
+        return 1;
+
+    options.verbose = parser.arg("verbose").is_parsed();
+    options.name = parser.arg("name").get_value_as<std::string>();
+    return *port + static_cast<int>(parser.arg("name").try_get_value_as<double>().value_or(0.0));
+}
@@ -0,0 +1,66 @@
+#ifndef cli_batch_h__
+#define cli_batch_h__
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "cli_callback.h"
+
+namespace cliap {
+    class ArgSchema;
+
+    // One line of a batch, as handed to the line handler of BatchValidator
+    struct BatchLine {
+        // Counted from 1, blank lines included
+        std::size_t number{};
+        // The line without its line ending
+        std::string_view text;
+        // Valid until the handler returns
+        std::optional<std::string_view> error;
+
+        bool ok() const { return !error; }
+    };
+
+    struct BatchSummary {
+        std::size_t lines{};
+        std::size_t errors{};
+    };
+
+    struct BatchOptions {
+        // Worker threads; 0 takes one per hardware thread
+        unsigned threads{0};
+        // Lines are handed out to the workers in chunks of about this many bytes
+        std::size_t chunk_size{256 * 1024};
+    };
+
+    // Checks text holding one command line per line against a schema, as
+    // ArgSchema::parse_command_line would parse it: the first token of a line
+    // is the program name. Blank lines are skipped.
+    //
+    // The text is split into line-aligned chunks that the workers parse in
+    // parallel, each taking its own share first and then stealing from the
+    // others. Lines reach the handler in input order, on the calling thread,
+    // as soon as the chunks before them are done.
+    class BatchValidator {
+    public:
+        using LineHandler = Callback<void(const BatchLine& line)>;
+
+        explicit BatchValidator(std::shared_ptr<const ArgSchema> schema, BatchOptions options = {});
+
+        // An exception thrown by the handler or by a worker stops the others
+        // and is passed on once they have finished the chunks in hand
+        BatchSummary validate(std::string_view text, const LineHandler& on_line = {}) const;
+
+        // Maps the file into memory; throws std::runtime_error when it cannot
+        BatchSummary validate_file(const std::string& path, const LineHandler& on_line = {}) const;
+
+    private:
+        std::shared_ptr<const ArgSchema> schema_;
+        BatchOptions options_;
+    };
+}
+
+#endif // cli_batch_h__
@@ -0,0 +1,142 @@
+#ifndef cli_callback_h__
+#define cli_callback_h__
+
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace cliap {
+    template<typename Signature>
+    class Callback;
+
+    // A copyable type-erased callable for the hooks, factories and validators
+    // of ArgParser. It takes anything std::function takes, std::function
+    // included, but costs the includers of cli_parser.h none of <functional>.
+    // Callables up to two pointers in size are stored inline.
+    template<typename R, typename... Args>
+    class Callback<R(Args...)> {
+    public:
+        Callback() noexcept = default;
+        Callback(std::nullptr_t) noexcept {}
+
+        template<typename F, typename Stored = std::decay_t<F>,
+                 typename = std::enable_if_t<!std::is_same_v<Stored, Callback> && std::is_invocable_r_v<R, Stored&, Args...>>>
+        Callback(F&& callable) {
+            // Null function pointers and empty std::functions stay empty
+            if constexpr (std::is_constructible_v<bool, const Stored&>)
+                if (!static_cast<bool>(callable))
+                    return;
+
+            if constexpr (stored_inline<Stored>)
+                ::new (static_cast<void*>(storage_)) Stored(std::forward<F>(callable));
+            else
+                ::new (static_cast<void*>(storage_)) Stored*(new Stored(std::forward<F>(callable)));
+            ops_ = &ops_for<Stored>;
+        }
+
+        Callback(const Callback& other) {
+            if (other.ops_)
+                other.ops_->copy(other.storage_, storage_);
+            ops_ = other.ops_;
+        }
+
+        Callback(Callback&& other) noexcept {
+            if (other.ops_)
+                other.ops_->move(other.storage_, storage_);
+            ops_ = std::exchange(other.ops_, nullptr);
+        }
+
+        Callback& operator=(const Callback& other) {
+            if (this != &other)
+                *this = Callback{other};
+            return *this;
+        }
+
+        Callback& operator=(Callback&& other) noexcept {
+            if (this != &other) {
+                reset();
+                if (other.ops_)
+                    other.ops_->move(other.storage_, storage_);
+                ops_ = std::exchange(other.ops_, nullptr);
+            }
+            return *this;
+        }
+
+        ~Callback() { reset(); }
+
+        explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+        R operator()(Args... args) const {
+            if (!ops_)
+                throw std::logic_error("Call of an empty cliap::Callback");
+            return ops_->invoke(storage_, std::forward<Args>(args)...);
+        }
+
+    private:
+        struct Ops {
+            R (*invoke)(unsigned char* storage, Args&&... args);
+            void (*copy)(const unsigned char* from, unsigned char* to);
+            void (*move)(unsigned char* from, unsigned char* to) noexcept;
+            void (*destroy)(unsigned char* storage) noexcept;
+        };
+
+        static constexpr std::size_t inline_size = 2 * sizeof(void*);
+
+        template<typename F>
+        static constexpr bool stored_inline = sizeof(F) <= inline_size && alignof(F) <= alignof(void*)
+            && std::is_nothrow_move_constructible_v<F>;
+
+        template<typename F>
+        static F& target(unsigned char* storage) {
+            if constexpr (stored_inline<F>)
+                return *std::launder(reinterpret_cast<F*>(storage));
+            else
+                return **std::launder(reinterpret_cast<F**>(storage));
+        }
+
+        template<typename F>
+        static const F& target(const unsigned char* storage) {
+            return target<F>(const_cast<unsigned char*>(storage));
+        }
+
+        template<typename F>
+        static constexpr Ops ops_for{
+            [](unsigned char* storage, Args&&... args) -> R {
+                return static_cast<R>(target<F>(storage)(std::forward<Args>(args)...));
+            },
+            [](const unsigned char* from, unsigned char* to) {
+                if constexpr (stored_inline<F>)
+                    ::new (static_cast<void*>(to)) F(target<F>(from));
+                else
+                    ::new (static_cast<void*>(to)) F*(new F(target<F>(from)));
+            },
+            [](unsigned char* from, unsigned char* to) noexcept {
+                if constexpr (stored_inline<F>) {
+                    ::new (static_cast<void*>(to)) F(std::move(target<F>(from)));
+                    target<F>(from).~F();
+                } else {
+                    ::new (static_cast<void*>(to)) F*(&target<F>(from));
+                }
+            },
+            [](unsigned char* storage) noexcept {
+                if constexpr (stored_inline<F>)
+                    target<F>(storage).~F();
+                else
+                    delete &target<F>(storage);
+            }
+        };
+
+        void reset() noexcept {
+            if (ops_)
+                ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+
+        alignas(void*) mutable unsigned char storage_[inline_size];
+        const Ops* ops_{};
+    };
+}
+
+#endif // cli_callback_h__
@@ -0,0 +1,112 @@
+#ifndef cli_convert_h__
+#define cli_convert_h__
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace cliap {
+    enum class ConvertError {
+        none,
+        empty,
+        invalid_format,
+        trailing_characters,
+        out_of_range,
+        unknown_suffix
+    };
+
+    const char* convert_error_message(ConvertError error);
+
+    template<typename T>
+    struct ConvertResult {
+        T value{};
+        ConvertError error{ConvertError::none};
+
+        explicit operator bool() const { return error == ConvertError::none; }
+
+        T value_or(T fallback) const { return error == ConvertError::none ? value : fallback; }
+    };
+
+    // Accepts true/false, yes/no, on/off and 1/0 in any letter case.
+    ConvertResult<bool> parse_bool(std::string_view str);
+
+    // Byte counts such as "512", "64MiB", "1.5G" or "10kB". Single-letter and
+    // IEC suffixes (K, KiB, M, MiB, ...) are powers of 1024, SI suffixes
+    // (kB, MB, GB, ...) are powers of 1000, as in coreutils.
+    ConvertResult<std::uint64_t> parse_size(std::string_view str);
+
+    // Durations such as "250ms", "2h" or "1h30m". Units are ns, us, ms, s, m
+    // (or min), h and d; a unit is required for every value except "0".
+    ConvertResult<std::chrono::nanoseconds> parse_duration(std::string_view str);
+
+    namespace detail {
+        // Integers accept an optional sign and 0x, 0o or 0b prefix; a leading
+        // zero alone does not switch to octal.
+        ConvertResult<long long> to_signed(std::string_view str, long long min, long long max);
+        ConvertResult<unsigned long long> to_unsigned(std::string_view str, unsigned long long max);
+
+        ConvertResult<float> to_float(std::string_view str);
+        ConvertResult<double> to_double(std::string_view str);
+        ConvertResult<long double> to_long_double(std::string_view str);
+
+        template<typename T, typename From>
+        ConvertResult<T> narrow(const ConvertResult<From>& from) {
+            return {static_cast<T>(from.value), from.error};
+        }
+
+        // Stream extraction and insertion for user types, compiled in
+        // cli_convert.cpp so that the includers of this header are spared
+        // <sstream>. read and write apply operator>> and operator<< to value.
+        ConvertError read_stream(std::string_view str, void (*read)(std::istream& in, void* value), void* value);
+        std::string write_stream(void (*write)(std::ostream& out, const void* value), const void* value);
+
+        // As std::ostream prints it by default
+        std::string format_float(long double value);
+    }
+
+    // Converts the whole of str to T. Unlike stream extraction, partial input
+    // such as "12abc" is reported as an error instead of yielding 12.
+    template<typename T>
+    ConvertResult<T> convert(std::string_view str) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            return {std::string{str}, ConvertError::none};
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+            return {str, ConvertError::none};
+        } else if (str.empty()) {
+            return {T{}, ConvertError::empty};
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return parse_bool(str);
+        } else if constexpr (std::is_same_v<T, char>) {
+            if (str.size() != 1)
+                return {char{}, ConvertError::trailing_characters};
+            return {str.front(), ConvertError::none};
+        } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+            const auto result = detail::to_signed(str, std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+            return detail::narrow<T>(result);
+        } else if constexpr (std::is_integral_v<T>) {
+            const auto result = detail::to_unsigned(str, std::numeric_limits<T>::max());
+            return detail::narrow<T>(result);
+        } else if constexpr (std::is_same_v<T, float>) {
+            return detail::to_float(str);
+        } else if constexpr (std::is_same_v<T, double>) {
+            return detail::to_double(str);
+        } else if constexpr (std::is_same_v<T, long double>) {
+            return detail::to_long_double(str);
+        } else if constexpr (std::is_same_v<T, std::chrono::nanoseconds>) {
+            return parse_duration(str);
+        } else {
+            // User types keep working through operator>>, but must consume the whole value
+            T result{};
+            const auto error = detail::read_stream(str, [](std::istream& in, void* value) { in >> *static_cast<T*>(value); }, &result);
+            if (error != ConvertError::none)
+                return {T{}, error};
+            return {result, ConvertError::none};
+        }
+    }
+}
+
+#endif // cli_convert_h__
@@ -1,111 +1,1249 @@
 ﻿#ifndef cli_parser_h__
 #define cli_parser_h__
 
-#include <iostream>
-#include <unordered_map>
-#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
 #include <optional>
+#include <string_view>
 #include <vector>
-#include <functional>
-#include <sstream>
 #include <memory>
+#include <list>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "cli_callback.h"
+#include "cli_convert.h"
+
+// Builds with CLI_PARSER_INSTRUMENTATION=1 collect ParseStats and call the
+// instrumentation hooks of ArgParser; without it both compile to nothing
+#ifndef CLI_PARSER_INSTRUMENTATION
+#define CLI_PARSER_INSTRUMENTATION 0
+#endif
 
 namespace cliap {
+    // Where the current value of an Arg came from, in increasing precedence
+    enum class ValueSource {
+        none,
+        default_value,
+        config_file,
+        environment,
+        command_line
+    };
+
+    // What made a parse fail; see ParseError
+    enum class ParseErrorCode {
+        none,
+        unknown_key,
+        missing_value,
+        missing_required,
+        unexpected_positional,
+        invalid_format,
+        invalid_value,
+        unterminated_quote,
+        response_file_nesting,
+        response_file_unreadable,
+        config_file_unreadable,
+        config_file_invalid,
+        environment_invalid,
+        snapshot_unreadable,
+        snapshot_invalid,
+        snapshot_mismatch,
+        capacity_exceeded
+    };
+
+    // Shells ArgParser::completion_script() can write a script for
+    enum class Shell {
+        bash,
+        zsh,
+        fish
+    };
+
+    // Where the time of an instrumented ArgParser went and what it did since
+    // it was created or its stats were reset. Phases nest: parse covers
+    // tokenization, lookup, config_files, environment, conversion and
+    // required_check.
+    struct ParseStats {
+        std::chrono::nanoseconds registration{};
+        std::chrono::nanoseconds parse{};
+        std::chrono::nanoseconds tokenization{};
+        std::chrono::nanoseconds lookup{};
+        std::chrono::nanoseconds config_files{};
+        std::chrono::nanoseconds environment{};
+        std::chrono::nanoseconds conversion{};
+        std::chrono::nanoseconds required_check{};
+        std::chrono::nanoseconds help{};
+
+        std::uint64_t parses{};
+        std::uint64_t tokens{};
+        std::uint64_t lookups{};
+        // Allocations through the memory resource of the parser
+        std::uint64_t allocations{};
+        std::uint64_t allocated_bytes{};
+        std::uint64_t errors{};
+
+        // One JSON object with the counters and the phases in nanoseconds
+        // ("parse_ns", "lookup_ns", ...)
+        std::string to_json() const;
+    };
+
+    // The values collected for one Arg, as views in the order they were
+    // given. Ranges over a single value hold it inline, so a range must
+    // outlive the iterators taken from it.
+    class ValueRange {
+    public:
+        using value_type = std::string_view;
+        using iterator = const std::string_view*;
+
+        ValueRange() = default;
+        explicit ValueRange(std::string_view single) : single_{single}, size_{single.empty() ? 0u : 1u} {}
+        ValueRange(const std::string_view* data, std::size_t size) : data_{data}, size_{size} {}
+
+        iterator begin() const { return data_ ? data_ : &single_; }
+        iterator end() const { return begin() + size_; }
+        std::size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        std::string_view operator[](std::size_t index) const { return begin()[index]; }
+        std::string_view front() const { return *begin(); }
+        std::string_view back() const { return end()[-1]; }
+
+    private:
+        const std::string_view* data_{};
+        std::string_view single_;
+        std::size_t size_{};
+    };
+
     class Arg {
     public:
+        // Names, values and collected values are allocated from the memory
+        // resource of the allocator; ArgParser moves the Args it is given
+        // into its own resource. Copies stay in the resource of the source.
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
         Arg() = default;
-        Arg(std::string name);
-        Arg& short_name(std::string short_name);
-        Arg& long_name(std::string long_name);
-        Arg& default_value(std::string default_value);
-        Arg& description(std::string description);
-        Arg& value(std::string value);
+        explicit Arg(const allocator_type& alloc) : text_{alloc}, value_{alloc}, values_{alloc} {}
+        Arg(std::string_view name, const allocator_type& alloc = {});
+
+        Arg(const Arg& other) : Arg{other, other.get_allocator()} {}
+        Arg(Arg&& other) = default;
+        Arg(const Arg& other, const allocator_type& alloc);
+        Arg(Arg&& other, const allocator_type& alloc);
+
+        Arg& operator=(const Arg& other) = default;
+        Arg& operator=(Arg&& other) = default;
+
+        Arg& short_name(std::string_view short_name);
+        Arg& long_name(std::string_view long_name);
+        Arg& default_value(std::string_view default_value);
+        Arg& description(std::string_view description);
+        // The environment variable the arg is read from, taking the place
+        // of the name ArgParser::env_prefix() derives
+        Arg& env(std::string_view name);
+        Arg& value(std::string_view value);
         Arg& required();
         Arg& flag();
 
+        // The arg may be given several times; every value is collected
+        Arg& repeated();
+
+        // The key takes all following tokens up to the next one that starts
+        // with '-' as its values (--input a b c); implies repeated()
+        Arg& multi_value();
+
+        // The arg takes tokens without a leading '-' (and everything after
+        // "--") in declaration order. A repeated positional arg takes all
+        // remaining ones. It can still be given by name as well.
+        Arg& positional();
+
         void set_parsed(bool is_parsed) {
             is_parsed_ = is_parsed;
         }
 
-        std::string short_name() const { return short_name_; }
-        std::string long_name() const { return long_name_; }
-        std::string default_value() const { return default_value_; }
-        std::string description() const { return description_; }
-        std::string value() const { return value_; }
+        std::string short_name() const { return std::string{short_name_view()}; }
+        std::string long_name() const { return std::string{long_name_view()}; }
+        std::string default_value() const { return std::string{default_value_view()}; }
+        std::string description() const { return std::string{description_view()}; }
+        std::string env() const { return std::string{env_view()}; }
+        std::string value() const { return std::string{value_view()}; }
+
+        std::string_view short_name_view() const { return field(short_field); }
+        std::string_view long_name_view() const { return field(long_field); }
+        std::string_view default_value_view() const { return field(default_field); }
+        std::string_view description_view() const { return field(description_field); }
+        std::string_view env_view() const { return field(env_field); }
+
+        // The value without an owned copy. With ArgParser::borrow_argv() it
+        // may refer to the argv storage, which must then outlive the parser.
+        std::string_view value_view() const { return value_borrowed_ ? value_ref_ : std::string_view{value_}; }
+
+        // All values of a repeated arg from the last parse, or the single
+        // value of any other arg. value_view() is the last of them.
+        ValueRange values() const {
+            if (is_repeated_ && !values_.empty())
+                return {values_.data(), values_.size()};
+            return ValueRange{value_view()};
+        }
+
         bool is_required() const { return is_required_; }
         bool is_flag() const { return is_flag_; }
         bool is_parsed() const { return is_parsed_; }
+        bool is_repeated() const { return is_repeated_; }
+        bool is_multi_value() const { return is_multi_value_; }
+        bool is_positional() const { return is_positional_; }
+        ValueSource source() const { return source_; }
+
+        allocator_type get_allocator() const { return text_.get_allocator(); }
 
+        // Returns T{} when the value is empty or cannot be fully converted
         template<typename T>
         T get_value_as() const {
-            if (value_.empty())
-                return {};
+            return convert<T>(value_view()).value;
+        }
 
-            T result{};
-            std::stringstream ss{value_};
-            ss >> result;
-            return result;
+        template<typename T>
+        ConvertResult<T> try_get_value_as() const {
+            return convert<T>(value_view());
         }
 
-        std::string get_value_as_str() const { return value_; }
+        ConvertResult<std::uint64_t> get_value_as_size() const { return parse_size(value_view()); }
+
+        ConvertResult<std::chrono::nanoseconds> get_value_as_duration() const { return parse_duration(value_view()); }
+
+        std::string get_value_as_str() const { return value(); }
 
     private:
-        std::string short_name_;
-        std::string long_name_;
-        std::string default_value_;
-        std::string description_;
-        std::string value_;
+        friend class ArgParser;
+
+        enum Field : std::size_t { short_field, long_field, default_field, description_field, env_field };
+
+        std::string_view field(Field f) const {
+            const std::size_t begin = f == short_field ? 0 : field_ends_[f - 1];
+            const std::size_t end = f == env_field ? text_.size() : field_ends_[f];
+            return std::string_view{text_}.substr(begin, end - begin);
+        }
+
+        void set_field(Field f, std::string_view text);
+
+        void borrow_value(std::string_view value) {
+            value_ref_ = value;
+            value_borrowed_ = true;
+        }
+
+        // The short name, long name, default value, description and
+        // environment variable share one buffer; field_ends_ holds the end
+        // offsets of the first four.
+        std::pmr::string text_;
+        std::array<std::uint32_t, 4> field_ends_{};
+        std::pmr::string value_;
+        std::string_view value_ref_;
+        bool value_borrowed_{false};
         bool is_required_{false};
         bool is_flag_{false};
         bool is_parsed_{false};
+        bool is_repeated_{false};
+        bool is_multi_value_{false};
+        bool is_positional_{false};
+        ValueSource source_{ValueSource::none};
+        std::pmr::vector<std::string_view> values_;
+    };
+
+    namespace detail {
+        struct ParseStorage;
+        class TokenStream;
+
+        // Open-addressing index from short and long names to positions in
+        // ArgParser's vector of Args. Slots store positions rather than
+        // pointers or names, so the index survives vector reallocation and
+        // lookups by string_view never allocate.
+        class NameIndex {
+        public:
+            static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+            using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+            NameIndex() = default;
+            explicit NameIndex(const allocator_type& alloc) : slots_{alloc} {}
+            NameIndex(const NameIndex& other, const allocator_type& alloc) : slots_{other.slots_, alloc}, size_{other.size_} {}
+
+            std::size_t find(std::string_view name, const std::pmr::vector<Arg>& args) const;
+
+            // Indexes the names of args[index], the last element of args
+            void add(std::size_t index, const std::pmr::vector<Arg>& args);
+
+            void rebuild(const std::pmr::vector<Arg>& args);
+
+            void clear();
+
+        private:
+            struct Slot {
+                std::uint32_t hash{};
+                // (position << 1 | is_long_name) + 1, zero for an empty slot
+                std::uint32_t ref{};
+            };
+
+            void insert(std::string_view name, std::uint32_t ref);
+
+            std::pmr::vector<Slot> slots_;
+            std::size_t size_{};
+        };
+
+        // The environment variables args are read from, hashed like NameIndex
+        // for a single pass over the environment. Names derived from a prefix
+        // are kept in the index, explicit ones are those of the args.
+        class EnvIndex {
+        public:
+            static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+            using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+            EnvIndex() = default;
+            explicit EnvIndex(const allocator_type& alloc) : slots_{alloc}, entries_{alloc}, names_{alloc} {}
+            EnvIndex(const EnvIndex& other, const allocator_type& alloc)
+                : slots_{other.slots_, alloc}, entries_{other.entries_, alloc}, names_{other.names_, alloc} {}
+
+            bool empty() const { return entries_.empty(); }
+
+            // Position of the arg read from the variable, or npos
+            std::size_t find(std::string_view name) const;
+
+            // Indexes the variable of args[index], the last element of args
+            void add(std::size_t index, const std::pmr::vector<Arg>& args, std::string_view prefix);
+
+            void rebuild(const std::pmr::vector<Arg>& args, std::string_view prefix);
+
+            void clear();
+
+        private:
+            struct Entry {
+                std::uint32_t hash;
+                std::uint32_t index;
+                // The name in names_
+                std::uint32_t offset;
+                std::uint32_t size;
+            };
+
+            // Puts entries_[entry] in a free slot
+            void insert(std::size_t entry, std::string_view name);
+
+            std::string_view name_of(const Entry& entry) const { return std::string_view{names_}.substr(entry.offset, entry.size); }
+
+            // Positions in entries_ plus one, zero for an empty slot
+            std::pmr::vector<std::uint32_t> slots_;
+            std::pmr::vector<Entry> entries_;
+            std::pmr::string names_;
+        };
+
+        struct ConfigFile {
+            using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+            ConfigFile(std::string_view path, bool required, const allocator_type& alloc = {})
+                : path{path, alloc}, required{required} {}
+            ConfigFile(const ConfigFile& other, const allocator_type& alloc)
+                : path{other.path, alloc}, required{other.required} {}
+
+            std::pmr::string path;
+            bool required;
+        };
+
+        struct CommandInfo {
+            using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+            CommandInfo(std::string_view name, std::string_view description, const allocator_type& alloc = {})
+                : name{name, alloc}, description{description, alloc} {}
+            CommandInfo(const CommandInfo& other, const allocator_type& alloc)
+                : name{other.name, alloc}, description{other.description, alloc} {}
+
+            std::pmr::string name;
+            std::pmr::string description;
+        };
+
+        struct ParseScope;
+        struct CompletionWords;
+        struct CompletionScope;
+        class Instrumentation;
+    }
+
+    class ArgSchema;
+    class ParseResult;
+
+    // A memory resource over a fixed buffer that never falls back to the
+    // heap. Blocks are carved in power-of-two sizes and freed ones are kept
+    // for reuse, so a ParseResult that parses into it again and again runs
+    // in constant space. Running out throws std::bad_alloc, which a
+    // ParseResult over the buffer reports as an error.
+    class FixedBufferResource : public std::pmr::memory_resource {
+    public:
+        // The buffer must outlive the resource
+        FixedBufferResource(void* buffer, std::size_t size);
+
+        FixedBufferResource(const FixedBufferResource&) = delete;
+        FixedBufferResource& operator=(const FixedBufferResource&) = delete;
+
+        std::size_t capacity() const { return static_cast<std::size_t>(end_ - begin_); }
+        // The bytes carved from the buffer so far, freed blocks included
+        std::size_t used() const { return static_cast<std::size_t>(next_ - begin_); }
+
+    private:
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        static constexpr std::size_t min_block_size = alignof(std::max_align_t);
+        static constexpr std::size_t size_classes = sizeof(std::size_t) * 8;
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+        unsigned char* begin_;
+        unsigned char* next_;
+        unsigned char* end_;
+        FreeBlock* free_[size_classes]{};
+    };
+
+    // A FixedBufferResource with a buffer of Bytes inside it, for a capacity
+    // known at compile time
+    template<std::size_t Bytes>
+    class FixedBuffer : public FixedBufferResource {
+    public:
+        FixedBuffer() : FixedBufferResource{storage_, Bytes} {}
+
+    private:
+        alignas(std::max_align_t) unsigned char storage_[Bytes];
+    };
+
+    // The outcome of a parse for one arg of an ArgSchema
+    class ParsedArg {
+    public:
+        ParsedArg(const Arg& spec, std::string_view value, ValueRange values, bool is_parsed, ValueSource source)
+            : spec_{&spec}, value_{value}, values_{values}, is_parsed_{is_parsed}, source_{source} {}
+
+        const Arg& spec() const { return *spec_; }
+        bool is_parsed() const { return is_parsed_; }
+        ValueSource source() const { return source_; }
+        std::string_view value_view() const { return value_; }
+        std::string value() const { return std::string{value_}; }
+        ValueRange values() const { return values_; }
+
+        template<typename T>
+        T get_value_as() const {
+            return convert<T>(value_).value;
+        }
+
+        template<typename T>
+        ConvertResult<T> try_get_value_as() const {
+            return convert<T>(value_);
+        }
+
+        ConvertResult<std::uint64_t> get_value_as_size() const { return parse_size(value_); }
+
+        ConvertResult<std::chrono::nanoseconds> get_value_as_duration() const { return parse_duration(value_); }
+
+    private:
+        const Arg* spec_;
+        std::string_view value_;
+        ValueRange values_;
+        bool is_parsed_;
+        ValueSource source_;
+    };
+
+    // Why a parse failed, as a code and the pieces its message is made of.
+    // Nothing is formatted until message() is called. The views and the arg
+    // point into the arguments parsed and into the parser or result that
+    // failed, and stay valid until its next parse.
+    class ParseError {
+    public:
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+        ParseError() = default;
+        ParseError(ParseErrorCode code, std::size_t token, std::string_view subject = {}, const Arg* arg = nullptr, std::string_view detail = {})
+            : code_{code}, token_{token}, subject_{subject}, detail_{detail}, arg_{arg} {}
+
+        explicit operator bool() const { return code_ != ParseErrorCode::none; }
+
+        ParseErrorCode code() const { return code_; }
+
+        // Position of the token at fault among the parsed tokens, the program
+        // name being 0, or npos when no token is. Tokens read from response
+        // files count where they were expanded.
+        std::size_t token() const { return token_; }
+
+        // The text at fault: a key as given, a token, a file path
+        std::string_view subject() const { return subject_; }
+
+        // Why the value of an arg or a config file was rejected
+        std::string_view detail() const { return detail_; }
+
+        // The declaration of the arg concerned, if any
+        const Arg* arg() const { return arg_; }
+
+        // The message ArgParser::parse returns; an unknown key gets the
+        // names closest to it here, not when the parse fails
+        std::string message() const;
+
+    private:
+        friend class ParseResult;
+
+        ParseErrorCode code_{ParseErrorCode::none};
+        std::size_t token_{npos};
+        std::string_view subject_;
+        std::string_view detail_;
+        const Arg* arg_{};
+        // The result that failed, which knows the names to suggest
+        const ParseResult* origin_{};
+    };
+
+    // Everything one ArgSchema::parse call produced. Values are views into
+    // the parsed arguments or into storage the result owns (response and
+    // config files, unescaped tokens), so the arguments and the schema must
+    // outlive the result.
+    class ParseResult {
+    public:
+        ParseResult() = default;
+
+        // Everything the result allocates, including the storage its values
+        // point into, comes from resource. With a monotonic_buffer_resource a
+        // whole parse is released at once, when the result and then the
+        // buffer go away.
+        explicit ParseResult(std::pmr::memory_resource* resource)
+            : states_{resource}, collected_{resource}, values_{resource}, error_detail_{resource},
+              error_text_{resource}, outer_schemas_{resource} {}
+
+        // A result of fixed capacity: its parses never touch the heap, and one
+        // that does not fit the buffer fails with capacity_exceeded() set.
+        // Its messages name no suggestions for unknown keys, which would need
+        // the heap, and config file errors are the only ones that allocate.
+        explicit ParseResult(FixedBufferResource* buffer)
+            : ParseResult{static_cast<std::pmr::memory_resource*>(buffer)} { fixed_ = true; }
+
+        bool ok() const { return !error_; }
+
+        // The message of failure(), formatted into the result on first use.
+        // A view into the result, valid until its next parse.
+        std::optional<std::string_view> error() const;
+
+        // Why the parse failed; converts to false when it did not
+        ParseError failure() const {
+            auto error = error_;
+            error.origin_ = this;
+            return error;
+        }
+
+        bool capacity_exceeded() const { return error_.code() == ParseErrorCode::capacity_exceeded; }
+
+        // An unknown name yields an arg that is not parsed and has no value
+        ParsedArg arg(std::string_view name) const;
+
+        // The state of the arg at the same position in ArgSchema::all_params()
+        ParsedArg operator[](std::size_t index) const;
+
+        std::size_t size() const { return states_.size(); }
+
+        // The subcommand the parse stopped at, or empty. The tokens after it
+        // are left to the schema of that command.
+        std::string_view command() const;
+
+        // Position of the command among the parsed tokens, the program name
+        // being 0. Without response files this is its index in argv, so the
+        // rest can be parsed with command's schema from argv + position.
+        std::size_t command_position() const { return command_position_; }
+
+    private:
+        friend class ArgSchema;
+        friend class ArgParser;
+        friend class ParseError;
+
+        struct State {
+            std::string_view value;
+            // The collected values of a repeated arg in values_
+            std::uint32_t first_value{};
+            std::uint32_t value_count{};
+            ValueSource source{ValueSource::none};
+            bool is_parsed{false};
+        };
+
+        struct Collected {
+            std::uint32_t index;
+            ValueSource source;
+            std::string_view value;
+        };
+
+        void clear(const ArgSchema& schema);
+
+        void collect_values();
+
+        void fail(ParseErrorCode code, std::size_t token, std::string_view subject = {}, const Arg* arg = nullptr);
+
+        // Keeps a copy of detail, which need not outlive the call
+        void fail(ParseErrorCode code, std::size_t token, std::string_view subject, const Arg* arg, std::string_view detail);
+
+        // ". Did you mean ...?" for an unknown key, or an empty string
+        std::string suggestion(std::string_view name) const;
+
+        detail::ParseStorage& storage();
+
+        std::pmr::memory_resource* resource() const { return states_.get_allocator().resource(); }
+
+#if CLI_PARSER_INSTRUMENTATION
+        detail::Instrumentation* instrumentation() const { return instrumentation_; }
+
+        // Set by the ArgParser that runs the parse
+        detail::Instrumentation* instrumentation_{};
+#else
+        detail::Instrumentation* instrumentation() const { return nullptr; }
+#endif
+
+        const ArgSchema* schema_{};
+        std::pmr::vector<State> states_;
+        // Values of repeated args in the order they were given, grouped by
+        // arg by collect_values() once the parse is done
+        std::pmr::vector<Collected> collected_;
+        std::pmr::vector<std::string_view> values_;
+        std::shared_ptr<detail::ParseStorage> storage_;
+        ParseError error_;
+        std::pmr::string error_detail_;
+        // The message, once error() has formatted it
+        mutable std::pmr::string error_text_;
+        mutable bool error_formatted_{false};
+        // The schemas of the enclosing parsers at an unknown key, whose names
+        // are suggested too
+        std::pmr::vector<const ArgSchema*> outer_schemas_;
+        std::size_t command_{static_cast<std::size_t>(-1)};
+        std::size_t command_position_{};
+        bool fixed_{false};
+    };
+
+    // A frozen set of args, obtained from ArgParser::schema(). Parsing only
+    // reads the schema and writes to the ParseResult, so one schema can be
+    // shared by any number of threads without locking.
+    class ArgSchema {
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+        ArgSchema(const ArgSchema& other) = default;
+        ArgSchema(ArgSchema&& other) = default;
+        ArgSchema& operator=(ArgSchema&& other) = default;
+        ArgSchema(const ArgSchema& other, const allocator_type& alloc);
+
+        // Results returned by value allocate from the default memory
+        // resource; pass a ParseResult constructed with another resource to
+        // the overloads that take one to parse into it instead
+        ParseResult parse(int argc, char* argv[]) const;
+
+        ParseResult parse(const std::vector<std::string>& args) const;
+
+        // Reuses the buffers of a previous result, so a thread that keeps
+        // parsing with one result stops allocating once they have grown
+        void parse(int argc, char* argv[], ParseResult& result) const;
+
+        void parse(const std::vector<std::string>& args, ParseResult& result) const;
+
+        // Splits a whole command line received as text with ShellTokenizer
+        // rules and parses the tokens as they come. Its first token is the
+        // program name. The text is copied into the result, so it need not
+        // outlive the call.
+        ParseResult parse_command_line(std::string_view command_line) const;
+
+        void parse_command_line(std::string_view command_line, ParseResult& result) const;
+
+        static constexpr std::size_t npos = detail::NameIndex::npos;
+
+        // Position of the arg in all_params(), or npos
+        std::size_t find(std::string_view name) const { return index_.find(name, args_); }
+
+        const std::pmr::vector<cliap::Arg>& all_params() const { return args_; }
+
+        std::size_t parameters_count() const { return args_.size(); }
+
+        // The paths given to ArgParser::add_config_file, in the order read
+        std::vector<std::string_view> config_files() const;
+
+        // A hash of what decides how the args parse: their names, defaults,
+        // environment variables, kinds and order. Descriptions are left out.
+        // The same across runs and platforms.
+        std::uint64_t hash() const;
+
+    private:
+        friend class ArgParser;
+        friend class ParseResult;
+
+        ArgSchema() = default;
+        explicit ArgSchema(const allocator_type& alloc);
+
+        // Parses tokens up to the end or to the first subcommand, whose
+        // position in commands_ it returns (npos if none). Names this schema
+        // does not know are looked up in the outer scopes, those of the
+        // commands it is nested in.
+        std::size_t parse_stream(detail::TokenStream& tokens, ParseResult& result, const detail::ParseScope* outer = nullptr) const;
+
+        void parse_tokens(detail::TokenStream& tokens, ParseResult& result) const;
+
+        std::size_t find_command(std::string_view name) const;
+
+        // ". Did you mean ...?" naming the args of this schema and of the
+        // outer scopes closest to an unknown name, or an empty string
+        std::string suggest(std::string_view name, const detail::ParseScope* outer, bool with_dashes) const;
+
+        // Sets the values the config files give; false, with the error set
+        // in result, when one of them is broken
+        bool load_config_files(ParseResult& result) const;
+
+        // Sets the values of the environment variables in env_, in one pass
+        // over the environment
+        bool load_environment(ParseResult& result) const;
+
+        void set_value(ParseResult& result, std::size_t index, std::string_view value, bool stable, ValueSource source) const;
+
+        bool check_required_args(ParseResult& result) const;
+
+        void index_positional_args();
+
+        std::pmr::vector<cliap::Arg> args_;
+        detail::NameIndex index_;
+        // Positions of the positional args in args_, in declaration order
+        std::pmr::vector<std::size_t> positional_args_;
+        std::size_t required_args_count_{};
+        std::pmr::vector<detail::ConfigFile> config_files_;
+        detail::EnvIndex env_;
+        std::pmr::string env_prefix_;
+        std::pmr::vector<detail::CommandInfo> commands_;
+        bool response_files_{false};
+    };
+
+    namespace detail {
+        // The converted value of an arg registered with
+        // ArgParser::add_parameter_as(), updated by every parse
+        class Binding {
+        public:
+            explicit Binding(std::string_view arg_name) : arg_name_{arg_name} {}
+            virtual ~Binding() = default;
+
+            const std::string& arg_name() const { return arg_name_; }
+
+            // Converts and validates the value of parm; returns why it is
+            // invalid, leaving the previous value in place
+            virtual std::optional<std::string> assign(const Arg& parm) = 0;
+
+            // Set by ArgParser::reset(), after which parses no longer update
+            // the binding
+            bool detached() const { return detached_; }
+            void detach() { detached_ = true; }
+
+        private:
+            std::string arg_name_;
+            bool detached_{false};
+        };
+
+        // std::vector<U> binds every value of a repeated arg as a U
+        template<typename T>
+        struct BoundElement {
+            using type = T;
+            static constexpr bool is_vector = false;
+        };
+
+        template<typename T, typename Allocator>
+        struct BoundElement<std::vector<T, Allocator>> {
+            using type = T;
+            static constexpr bool is_vector = true;
+        };
+
+        template<typename T>
+        std::string describe_value(const T& value) {
+            if constexpr (std::is_same_v<T, std::chrono::nanoseconds>) {
+                return std::to_string(value.count()) + "ns";
+            } else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char>) {
+                return std::string(1, static_cast<char>(value));
+            } else if constexpr (std::is_integral_v<T>) {
+                return std::to_string(value);
+            } else if constexpr (std::is_floating_point_v<T>) {
+                return format_float(value);
+            } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                return std::string{std::string_view{value}};
+            } else {
+                return write_stream([](std::ostream& out, const void* v) { out << *static_cast<const T*>(v); }, &value);
+            }
+        }
+
+        template<typename T>
+        class TypedBinding final : public Binding {
+        public:
+            using element_type = typename BoundElement<T>::type;
+            using Validator = Callback<std::optional<std::string>(const element_type&)>;
+
+            TypedBinding(std::string_view arg_name, T* target)
+                : Binding{arg_name}, target_{target ? target : &value_} {}
+
+            const T& value() const { return *target_; }
+
+            // Throws std::runtime_error, without adding it, when the value
+            // held now does not pass validator
+            void add_validator(Validator validator) {
+                if (detached())
+                    throw std::runtime_error("The parser of the handle was reset: " + arg_name());
+
+                std::optional<std::string> error;
+                if constexpr (BoundElement<T>::is_vector) {
+                    for (auto element = target_->begin(); element != target_->end() && !error; ++element)
+                        error = validator(*element);
+                } else if (has_value_) {
+                    error = validator(*target_);
+                }
+
+                if (error)
+                    throw std::runtime_error("Invalid value for the key: " + arg_name() + " (" + *error + ")");
+
+                validators_.push_back(std::move(validator));
+            }
+
+            std::optional<std::string> assign(const Arg& parm) override {
+                T value{};
+                // Whether value came from text, which validators have checked
+                bool has_value = false;
+
+                if constexpr (BoundElement<T>::is_vector) {
+                    for (const auto text : parm.values()) {
+                        element_type element{};
+                        if (auto error = convert_element(text, element))
+                            return error;
+                        value.push_back(std::move(element));
+                    }
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    if (parm.is_flag())
+                        value = parm.is_parsed();
+                    else if (auto error = convert_element(parm.value_view(), value))
+                        return error;
+                    else
+                        has_value = !parm.value_view().empty();
+                } else if (auto error = convert_element(parm.value_view(), value)) {
+                    return error;
+                } else {
+                    has_value = !parm.value_view().empty();
+                }
+
+                *target_ = std::move(value);
+                has_value_ = has_value;
+                return {};
+            }
+
+        private:
+            // An empty value is T{} and skips the validators
+            std::optional<std::string> convert_element(std::string_view text, element_type& element) const {
+                if (text.empty())
+                    return {};
+
+                auto converted = convert<element_type>(text);
+                if (!converted)
+                    return std::string{convert_error_message(converted.error)};
+
+                for (const auto& validator : validators_)
+                    if (auto error = validator(converted.value))
+                        return error;
+
+                element = std::move(converted.value);
+                return {};
+            }
+
+            T value_{};
+            T* target_;
+            bool has_value_{false};
+            std::vector<Validator> validators_;
+        };
+    }
+
+    // Typed access to an arg registered with ArgParser::add_parameter_as().
+    // Every ArgParser::parse converts and validates the value once; reading
+    // it is a plain load with no lookup or conversion. A handle is valid
+    // until the parser is destroyed. After ArgParser::reset() it keeps its
+    // last value, parses no longer update it and adding a constraint throws.
+    //
+    // A constraint applies to the value held when it is added as well, so
+    // adding one that the default or last parsed value does not satisfy
+    // throws std::runtime_error.
+    template<typename T>
+    class ArgHandle {
+    public:
+        using element_type = typename detail::TypedBinding<T>::element_type;
+        using Validator = typename detail::TypedBinding<T>::Validator;
+
+        explicit ArgHandle(std::shared_ptr<detail::TypedBinding<T>> binding) : binding_{std::move(binding)} {}
+
+        // The value from the last successful parse, the default before that
+        const T& get() const { return binding_->value(); }
+        const T& operator*() const { return get(); }
+        const T* operator->() const { return &get(); }
+
+        // Parsing fails unless every value lies in [min, max]
+        ArgHandle& range(element_type min, element_type max) {
+            binding_->add_validator([min, max](const element_type& value) -> std::optional<std::string> {
+                if (value < min || max < value)
+                    return "must be between " + detail::describe_value(min) + " and " + detail::describe_value(max);
+                return {};
+            });
+            return *this;
+        }
+
+        // Parsing fails unless every value is one of choices
+        ArgHandle& choices(std::vector<element_type> choices) {
+            binding_->add_validator([choices = std::move(choices)](const element_type& value) -> std::optional<std::string> {
+                for (const auto& choice : choices)
+                    if (choice == value)
+                        return {};
+
+                std::string error{"must be one of "};
+                for (std::size_t i = 0; i < choices.size(); ++i)
+                    error += (i ? ", " : "") + detail::describe_value(choices[i]);
+                return error;
+            });
+            return *this;
+        }
+
+        // Parsing fails with the reason validator returns for a value
+        ArgHandle& validate(Validator validator) {
+            binding_->add_validator(std::move(validator));
+            return *this;
+        }
+
+    private:
+        std::shared_ptr<detail::TypedBinding<T>> binding_;
     };
 
     class ArgParser {
-        using ArgPtr = std::shared_ptr<cliap::Arg>;
     public:
+        ArgParser();
+
+        // The registered args, their values, the schema snapshots and the
+        // buffers of every parse are allocated from resource, which must
+        // outlive the parser and the schemas and handles it hands out
+        explicit ArgParser(std::pmr::memory_resource* resource);
+
+        // A parser is not copied: the parsers of its commands and the storage
+        // its values point into are its own. Moving one takes them along with
+        // its memory resource and leaves the moved-from parser fit only to be
+        // destroyed or assigned to. Move assignment keeps the resource of the
+        // target: what other allocated from an equal resource is taken over,
+        // anything else is rebuilt in it. Typed handles of the target stop
+        // being updated, as after reset().
+        ArgParser(const ArgParser&) = delete;
+        ArgParser(ArgParser&& other);
+        ArgParser& operator=(const ArgParser&) = delete;
+        ArgParser& operator=(ArgParser&& other);
+
         ArgParser& add_parameter(cliap::Arg parm);
 
+        // Registers parm like add_parameter() and returns a handle to its
+        // value converted to T, which every parse updates before returning.
+        // With target, the value is stored there as well. A flag binds to
+        // bool; std::vector<U> takes all values of a repeated arg. Throws
+        // std::runtime_error when the default value does not convert.
+        template<typename T>
+        ArgHandle<T> add_parameter_as(cliap::Arg parm, T* target = nullptr);
+
         std::optional<std::string> parse(const std::vector<std::string>& args);
 
+        // Tokenizes argv in place: names are looked up without copying, and
+        // values are copied into storage the parser keeps until the next
+        // parse unless borrow_argv() is set.
         std::optional<std::string> parse(int argc, char* argv[]);
 
-        void add_usage_string(std::string usage_string);
+        // See ArgSchema::parse_command_line()
+        std::optional<std::string> parse_command_line(std::string_view command_line);
+
+        // The parse functions without the message: a failure costs no
+        // formatting and, once the parser has warmed up, no allocation
+        // unless a value is rejected or a config file is broken. The error
+        // refers to the parser and stays valid until its next parse.
+        ParseError try_parse(const std::vector<std::string>& args);
+
+        ParseError try_parse(int argc, char* argv[]);
+
+        ParseError try_parse_command_line(std::string_view command_line);
+
+        // The state of every arg after a parse, as a compact versioned
+        // binary blob tagged with ArgSchema::hash(): its values, whether it
+        // was parsed and where its value came from. The args of subcommands
+        // are not included.
+        std::string save_snapshot() const;
+
+        // Restores the state save_snapshot() gave, in place of a parse:
+        // nothing is tokenized, no file is read and required args are not
+        // checked again; only typed handles convert their values, as after
+        // a parse. Fails with snapshot_mismatch for a blob of a parser whose
+        // args differ, and with snapshot_invalid for a damaged one. Values
+        // are views into a copy of the blob, kept until the next parse.
+        ParseError load_snapshot(std::string_view snapshot);
+
+        // Reads the blob from a file into the same storage, so the file may
+        // change or go away afterwards. A snapshot handed down in shared
+        // memory or an inherited descriptor can be loaded from /dev/fd/<n>.
+        ParseError load_snapshot_file(const std::string& path);
+
+        // Expands @path arguments with the contents of the named response
+        // file: whitespace-separated tokens with POSIX shell quoting and #
+        // comments, possibly naming further @files. Files are read into
+        // storage the parser keeps until the next parse and tokenized as the
+        // parse goes, so their values do not change when a file does.
+        ArgParser& allow_response_files(bool allow = true);
+
+        // Keeps the values parse(argc, argv) takes from argv as views into
+        // it instead of copying them, so that a parse copies no values. argv
+        // must then outlive the parser and stay unchanged while its values
+        // are in use.
+        ArgParser& borrow_argv(bool borrow = true);
+
+        // Reads key = value settings for the registered args from an INI-style
+        // file (a subset of TOML: [section] headers prefix keys with
+        // "section.", values may be bare, "quoted" or 'literal') at the start
+        // of every parse. Keys are long or short names; flags take a boolean.
+        // Files are applied in the order they were added, and command-line
+        // args override them all. A missing optional file is skipped.
+        ArgParser& add_config_file(std::string_view path, bool required = true);
+
+        // Reads the args with a long name from environment variables named
+        // prefix plus that name in upper case, with '-' and '.' turned into
+        // '_': MYSVC_ and --log.level make MYSVC_LOG_LEVEL. Args that name a
+        // variable with Arg::env() are read from it with or without a prefix.
+        // Every parse takes the variables in one pass over the environment;
+        // their values override config files and are overridden by
+        // command-line args. Empty values are ignored and flags take a
+        // boolean. The environment must not change during a parse.
+        ArgParser& env_prefix(std::string_view prefix);
+
+        // Fills in the parser of a subcommand
+        using CommandFactory = Callback<void(ArgParser&)>;
+
+        // Adds a subcommand: "program [options] name [command options]". The
+        // first bare token naming a command ends the options of this parser;
+        // the tokens after it go to the command's parser, which also accepts
+        // the options of this one. The factory runs once, when the command
+        // is first parsed or requested, so commands that are never used cost
+        // only their name.
+        ArgParser& add_command(std::string_view name, std::string_view description, CommandFactory factory);
+
+        // The parser of a registered command, built on first use; throws
+        // std::runtime_error for an unknown name
+        ArgParser& command(std::string_view name);
+
+        // The command named by the last parse, or empty
+        std::string_view selected_command() const;
+
+        // Candidate values of an arg for shell completion. prefix is the part
+        // of the value typed so far; candidates that do not start with it are
+        // dropped anyway.
+        using ValueProvider = Callback<void(std::string_view prefix, std::vector<std::string>& candidates)>;
+
+        // Sets the provider that completes the values of a registered arg;
+        // throws std::runtime_error for an unknown name
+        ArgParser& set_value_provider(std::string_view arg_name, ValueProvider provider);
+
+        // The hidden argument the completion scripts run the program with:
+        // "program --__complete words...", the last word being the one to
+        // complete (empty after a space)
+        static constexpr std::string_view completion_key{"--__complete"};
+
+        // Answers a completion request before any parsing: when argv[1] is
+        // completion_key, writes the candidates for the words after it to fd
+        // and returns true, and the program should exit. Otherwise returns
+        // false without reading further.
+        bool handle_completion(int argc, char* argv[], int fd = 1);
+
+        // The candidates for the last of words, the words of a command line
+        // after the program name: option names for a word starting with '-',
+        // commands and positional values for a bare word, and the values of
+        // the option it follows from the value provider. One per line, with
+        // the description after a tab when there is one. The words are only
+        // matched against the registered names; nothing is converted, checked
+        // or read from files, and only the commands walked through are built.
+        // The view is valid until the next call.
+        std::string_view complete(int count, const char* const words[]);
+        std::string_view complete(const std::vector<std::string>& words);
+
+        // A script that makes shell complete program by running it with
+        // completion_key, falling back to file names when it has no
+        // candidates. It does not depend on the registered args.
+        static std::string completion_script(Shell shell, std::string_view program);
+
+        void add_usage_string(std::string_view usage_string);
+
+        // The usage examples and a table of the registered args, wrapped at
+        // width columns (0 for the width of the terminal on stdout). The text
+        // is built once and kept until the args, the usage examples or the
+        // width change; the view is valid until then.
+        std::string_view help_text(std::size_t width = 0);
 
+        // Each writes the help text with a single write to its sink
         void print_help();
+        void print_help(std::ostream& out, std::size_t width = 0);
+        bool print_help(int fd, std::size_t width = 0);
 
-        const cliap::Arg& arg(const std::string& arg_name) const;
+        const cliap::Arg& arg(std::string_view arg_name) const;
 
-        std::size_t parameters_count() const { return all_params().size(); }
+        std::size_t parameters_count() const { return registry_.args_.size(); }
 
         void reset();
 
-        const std::vector<ArgPtr> all_params() const;
+        // Whether the library was built with CLI_PARSER_INSTRUMENTATION
+        static constexpr bool instrumented = CLI_PARSER_INSTRUMENTATION != 0;
+
+        // Called with each arg a parse gave a value, from the command line or
+        // a config file, once the parse has applied it
+        using ArgHook = Callback<void(const Arg&)>;
+
+        // Called with the message of each parse that fails
+        using ErrorHook = Callback<void(std::string_view)>;
+
+        // The hooks of the parsers of commands are not called; their args
+        // and errors reach the hooks of the parser the parse started at.
+        // Without instrumentation the hooks are dropped.
+        ArgParser& on_arg_parsed(ArgHook hook);
+        ArgParser& on_error(ErrorHook hook);
+
+        // All zero without instrumentation
+        const ParseStats& stats() const;
+
+        void reset_stats();
+
+        // Registered args in declaration order
+        const std::pmr::vector<cliap::Arg>& all_params() const { return registry_.args_; }
+
+        // A snapshot of the registered args for parsing on many threads. It is
+        // built on first use after a change to the parser and shared until
+        // the next change; take it once and hand it to the worker threads.
+        std::shared_ptr<const ArgSchema> schema();
 
     private:
-        void print_usage_examples() const;
+        ParseError parse_stream(detail::TokenStream& tokens);
 
-        void adjust_fmt_max_field_lengths(const ArgPtr& p);
+        // Loads a snapshot that already sits in the storage of result_
+        ParseError load_snapshot_storage(std::string_view snapshot);
 
-        std::size_t required_args_count() const {
-            const auto params = all_params();
-            return static_cast<std::size_t>(std::count_if(
-                std::cbegin(params),
-                std::cend(params),
-                [](const auto& ptr) mutable { return ptr->is_required(); }
-            ));
-        }
+        // Parses the tokens that belong to this parser and to the command
+        // they select, if any
+        ParseError parse_scope(detail::TokenStream& tokens, const detail::ParseScope* outer);
+
+        ArgParser& command_parser(std::size_t index);
+
+        // Completes the last of words, starting at pos inside the scopes
+        // of outer
+        void complete_scope(const detail::CompletionWords& words, std::size_t pos, const detail::CompletionScope* outer, std::pmr::string& out);
+
+        // The parser among scope and its outer scopes that knows name, and
+        // the position of the arg there; nullptr if none does
+        static ArgParser* find_in_scopes(const detail::CompletionScope* scope, std::string_view name, std::size_t& index);
+
+        // Appends the values from the provider of args_[index] that start
+        // with word after its first lead characters
+        void complete_values(std::size_t index, std::string_view word, std::size_t lead, std::pmr::string& out);
+
+        void apply_result(const ParseResult& result);
+
+        void release_storage();
+
+        // Points the results of this parser and of its commands that refer
+        // to the registry at from to the one at to
+        void move_schema(const ArgSchema* from, const ArgSchema* to);
+
+        // Copies the values that point into storage to storage of this
+        // parser's own
+        void copy_values_from(const detail::ParseStorage& storage);
+
+        // The resource bindings are allocated from: the one the parser was
+        // given, which handles may outlive the instrumentation with
+        std::pmr::memory_resource* binding_resource() const;
+
+        // Drops the cached schema, schema hash and help text after a change
+        // to the args
+        void invalidate();
 
-        std::optional<std::string> check_required_args() const;
+        // ArgSchema::hash() of the registry, computed once per change
+        std::uint64_t schema_hash() const;
 
-        std::unordered_map<std::string, ArgPtr> params_map_;
-        std::vector<std::string> usage_examples_;
+        std::size_t required_args_count() const { return registry_.required_args_count_; }
 
-        std::streamsize max_long_param_name_length_{};
-        std::streamsize max_short_param_name_length_{};
-        std::streamsize max_default_param_value_length_{};
+        ParseError check_required_args() const;
+
+        // Converts the current value of the arg the binding names and keeps it
+        void add_binding(std::shared_ptr<detail::Binding> binding);
+
+        // Converts the values of the args bound to typed handles
+        ParseError assign_bindings();
+
+#if CLI_PARSER_INSTRUMENTATION
+        detail::Instrumentation* instrumentation() const { return instrumentation_.get(); }
+
+        // Declared first, as the members below allocate through it
+        std::shared_ptr<detail::Instrumentation> instrumentation_;
+#else
+        detail::Instrumentation* instrumentation() const { return nullptr; }
+#endif
+
+        // The resource the members below allocate from: the one the parser
+        // was given, or the instrumentation counting what passes through
+        std::pmr::memory_resource* resource_;
+
+        // The registered args with their parsed state; parses run against it
+        // directly, while schema() hands out cleaned-up copies
+        ArgSchema registry_;
+        std::pmr::vector<std::pmr::string> usage_examples_;
+
+        std::shared_ptr<const ArgSchema> schema_;
+        // Reused by every parse, so repeated parses stop allocating
+        ParseResult result_;
+
+        // The storage of the last result, which the values of the args point into
+        std::shared_ptr<detail::ParseStorage> storage_;
+
+        // Factories and, once built, parsers of the commands in registry_.commands_
+        struct Command {
+            CommandFactory factory;
+            ArgParser* parser{};
+        };
+
+        std::pmr::vector<Command> commands_;
+        // Stable storage for the command parsers
+        std::pmr::list<ArgParser> command_parsers_;
+        std::size_t selected_command_{ArgSchema::npos};
+        bool borrow_argv_{false};
+
+        struct ValueProviderEntry {
+            std::string arg_name;
+            ValueProvider provider;
+        };
+
+        std::pmr::vector<ValueProviderEntry> value_providers_;
+        std::pmr::vector<std::shared_ptr<detail::Binding>> bindings_;
+        // Reused by the providers and for the output of complete()
+        std::vector<std::string> completion_values_;
+        std::pmr::string completion_;
+
+        std::pmr::string help_;
+        // The width help_ was built for, 0 for the terminal width
+        std::size_t help_width_{};
+        bool help_valid_{false};
+
+        mutable std::optional<std::uint64_t> schema_hash_;
 
         cliap::Arg empty_arg_{};
     };
+
+    template<typename T>
+    ArgHandle<T> ArgParser::add_parameter_as(cliap::Arg parm, T* target)
+    {
+        if (parm.is_flag() && !std::is_same_v<T, bool>)
+            throw std::runtime_error("Command line flag can only be bound to bool: " + parm.long_name());
+
+        const auto name = parm.long_name_view().empty() ? parm.short_name_view() : parm.long_name_view();
+        auto binding = std::allocate_shared<detail::TypedBinding<T>>(
+            std::pmr::polymorphic_allocator<detail::TypedBinding<T>>{binding_resource()}, name, target);
+        ArgHandle<T> handle{binding};
+
+        add_parameter(std::move(parm));
+        add_binding(std::move(binding));
+        return handle;
+    }
 }
 
 #endif // cli_parser_h__
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef cli_reload_h__
+#define cli_reload_h__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cli_callback.h"
+
+namespace cliap {
+    class ArgSchema;
+    class ParseResult;
+
+    namespace detail {
+        class ReloadWatch;
+    }
+
+    struct ReloadOptions {
+        // Reload when a config file of the schema is written or replaced
+        bool watch_files{true};
+        // Reload on SIGHUP, where there is one
+        bool reload_on_hangup{true};
+        // How often the files are checked where inotify is not available
+        std::chrono::milliseconds poll_interval{1000};
+    };
+
+    // The values of a long-running service, reparsed from the same args, and
+    // so from the config files and environment variables of the schema, on
+    // reload(). A reload that parses publishes a new immutable snapshot in
+    // place of the current one; one that fails keeps the current one.
+    //
+    // Readers never block or retry: snapshot() takes the current snapshot
+    // with a fixed number of atomic operations, and a reload only waits for
+    // the snapshot() calls in progress, in the manner of RCU. A snapshot is
+    // freed with the last Snapshot holding it, so readers may keep one for
+    // as long as they like, even past the LiveConfig.
+    class LiveConfig {
+    private:
+        struct Published;
+
+    public:
+        using ReloadHandler = Callback<void(const ParseResult& result)>;
+
+        // The values as of one parse
+        class Snapshot {
+        public:
+            Snapshot(Snapshot&& other) noexcept : published_{std::exchange(other.published_, nullptr)} {}
+            Snapshot& operator=(Snapshot&& other) noexcept;
+            ~Snapshot() { release(published_); }
+
+            Snapshot(const Snapshot&) = delete;
+            Snapshot& operator=(const Snapshot&) = delete;
+
+            const ParseResult& operator*() const;
+            const ParseResult* operator->() const { return &**this; }
+
+            // 1 for the first parse, one more for each published reload
+            std::uint64_t version() const;
+
+        private:
+            friend class LiveConfig;
+
+            explicit Snapshot(const Published* published) : published_{published} {}
+
+            const Published* published_;
+        };
+
+        // Parses args, the program name first, and throws std::runtime_error
+        // with the message when they do not parse
+        LiveConfig(std::shared_ptr<const ArgSchema> schema, std::vector<std::string> args);
+
+        // Stops watching
+        ~LiveConfig();
+
+        LiveConfig(const LiveConfig&) = delete;
+        LiveConfig& operator=(const LiveConfig&) = delete;
+
+        Snapshot snapshot() const noexcept;
+
+        // Parses again and publishes the result if it parses. The handler,
+        // if any, gets the result either way, after it has been published.
+        bool reload(const ReloadHandler& on_reload = {});
+
+        // Reloads on a thread of its own when a config file changes or the
+        // process gets SIGHUP, calling on_reload on that thread. Throws
+        // std::runtime_error when already watching.
+        void watch(const ReloadOptions& options = {}, ReloadHandler on_reload = {});
+
+        // Waits for a reload in progress, if any, and stops watching
+        void stop();
+
+    private:
+        // Drops a reference to a snapshot, freeing it with the last one
+        static void release(const Published* published) noexcept;
+
+        // Waits for the snapshot() calls that may have loaded the snapshot
+        // in place before the last swap
+        void synchronize();
+
+        std::shared_ptr<const ArgSchema> schema_;
+        std::vector<std::string> args_;
+
+        std::atomic<const Published*> current_{nullptr};
+
+        // snapshot() counts itself in the slot the epoch selects while it
+        // takes a reference; a reload moves the epoch on and waits for each
+        // slot to drain in turn
+        struct alignas(64) ReaderSlot {
+            std::atomic<std::size_t> count{0};
+        };
+        mutable ReaderSlot readers_[2];
+        mutable std::atomic<std::size_t> epoch_{0};
+
+        // Serializes reloads
+        std::mutex reload_mutex_;
+        std::unique_ptr<detail::ReloadWatch> watch_;
+    };
+}
+
+#endif // cli_reload_h__
@@ -0,0 +1,349 @@
+#ifndef cli_static_schema_h__
+#define cli_static_schema_h__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "cli_convert.h"
+#include "cli_token.h"
+
+namespace cliap {
+    // Compile-time counterpart of cliap::Arg. All strings are views, so a
+    // schema built from literals lives entirely in read-only data.
+    class StaticArg {
+    public:
+        constexpr StaticArg() = default;
+        constexpr StaticArg& short_name(std::string_view short_name) {
+            short_name_ = detail::ltrim_view(short_name, '-');
+            return *this;
+        }
+        constexpr StaticArg& long_name(std::string_view long_name) {
+            long_name_ = detail::ltrim_view(long_name, '-');
+            return *this;
+        }
+        constexpr StaticArg& default_value(std::string_view default_value) {
+            default_value_ = default_value;
+            return *this;
+        }
+        constexpr StaticArg& description(std::string_view description) {
+            description_ = description;
+            return *this;
+        }
+        constexpr StaticArg& required() {
+            is_required_ = true;
+            return *this;
+        }
+        constexpr StaticArg& flag() {
+            is_flag_ = true;
+            return *this;
+        }
+
+        constexpr std::string_view short_name() const { return short_name_; }
+        constexpr std::string_view long_name() const { return long_name_; }
+        constexpr std::string_view default_value() const { return default_value_; }
+        constexpr std::string_view description() const { return description_; }
+        constexpr bool is_required() const { return is_required_; }
+        constexpr bool is_flag() const { return is_flag_; }
+
+    private:
+        std::string_view short_name_;
+        std::string_view long_name_;
+        std::string_view default_value_;
+        std::string_view description_;
+        bool is_required_{false};
+        bool is_flag_{false};
+    };
+
+    namespace detail {
+        constexpr std::uint64_t name_hash(std::string_view name, std::uint64_t seed) {
+            std::uint64_t h = 0xcbf29ce484222325ull ^ (seed * 0x9e3779b97f4a7c15ull);
+            for (const char ch : name) {
+                h ^= static_cast<unsigned char>(ch);
+                h *= 0x100000001b3ull;
+            }
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        // At most half of the slots are used, which keeps the displacement
+        // search short
+        constexpr std::size_t static_table_size(std::size_t arg_count) {
+            std::size_t size = 4;
+            while (size < arg_count * 4)
+                size *= 2;
+            return size;
+        }
+    }
+
+    // An immutable option table with a perfect hash over all short and long
+    // names, built during constant evaluation (hash-and-displace: every name
+    // is first hashed into a bucket, and each bucket gets a displacement seed
+    // that sends its names to free slots). A lookup is two hashes of the
+    // name, one table load and one comparison.
+    template<std::size_t N>
+    class StaticSchema {
+    public:
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+        static constexpr std::size_t table_size = detail::static_table_size(N);
+        static constexpr std::size_t bucket_count = N > 0 ? N : 1;
+
+        constexpr explicit StaticSchema(const std::array<StaticArg, N>& args) : args_{args} {
+            build();
+        }
+
+        static constexpr std::size_t size() { return N; }
+
+        constexpr const StaticArg& operator[](std::size_t index) const { return args_[index]; }
+
+        constexpr const std::array<StaticArg, N>& args() const { return args_; }
+
+        // Index of the arg with the given short or long name, or npos
+        constexpr std::size_t find(std::string_view name) const {
+            const auto bucket = detail::name_hash(name, 0) % bucket_count;
+            const auto slot = table_[detail::name_hash(name, displacement_[bucket] + 1ull) & (table_size - 1)];
+
+            if (slot == 0)
+                return npos;
+
+            const auto index = (slot - 1) >> 1;
+            const auto candidate = ((slot - 1) & 1) ? args_[index].long_name() : args_[index].short_name();
+
+            return candidate == name ? index : npos;
+        }
+
+    private:
+        static constexpr std::size_t max_names = N * 2;
+
+        constexpr std::string_view name_of(std::uint32_t key) const {
+            return (key & 1) ? args_[key >> 1].long_name() : args_[key >> 1].short_name();
+        }
+
+        constexpr void build() {
+            // Keys encode (arg index << 1 | is_long_name)
+            std::array<std::uint32_t, max_names> keys{};
+            std::size_t key_count{};
+
+            for (std::size_t i = 0; i < N; ++i) {
+                if (!args_[i].short_name().empty())
+                    keys[key_count++] = static_cast<std::uint32_t>(i << 1);
+                if (!args_[i].long_name().empty())
+                    keys[key_count++] = static_cast<std::uint32_t>(i << 1 | 1);
+            }
+
+            // Group the keys by bucket (counting sort)
+            std::array<std::size_t, bucket_count + 1> bucket_begin{};
+            std::array<std::size_t, max_names> key_bucket{};
+
+            for (std::size_t i = 0; i < key_count; ++i) {
+                key_bucket[i] = detail::name_hash(name_of(keys[i]), 0) % bucket_count;
+                ++bucket_begin[key_bucket[i] + 1];
+            }
+
+            for (std::size_t b = 0; b < bucket_count; ++b)
+                bucket_begin[b + 1] += bucket_begin[b];
+
+            std::array<std::uint32_t, max_names> grouped{};
+            std::array<std::size_t, bucket_count + 1> fill{bucket_begin};
+
+            for (std::size_t i = 0; i < key_count; ++i)
+                grouped[fill[key_bucket[i]]++] = keys[i];
+
+            // Place the largest buckets first, while the table is still empty
+            std::array<std::size_t, bucket_count> order{};
+            for (std::size_t b = 0; b < bucket_count; ++b)
+                order[b] = b;
+
+            const auto bucket_len = [&bucket_begin](std::size_t b) { return bucket_begin[b + 1] - bucket_begin[b]; };
+
+            for (std::size_t i = 1; i < bucket_count; ++i) {
+                const auto b = order[i];
+                std::size_t j = i;
+                for (; j > 0 && bucket_len(order[j - 1]) < bucket_len(b); --j)
+                    order[j] = order[j - 1];
+                order[j] = b;
+            }
+
+            for (std::size_t ord = 0; ord < bucket_count; ++ord) {
+                const auto b = order[ord];
+                if (bucket_len(b) == 0)
+                    break;
+
+                // Equal names always share a bucket
+                for (std::size_t i = bucket_begin[b]; i < bucket_begin[b + 1]; ++i)
+                    for (std::size_t j = i + 1; j < bucket_begin[b + 1]; ++j)
+                        if (name_of(grouped[i]) == name_of(grouped[j]))
+                            throw std::logic_error("Duplicate name in a static argument schema");
+
+                const auto slot_of = [this, &grouped](std::size_t k, std::uint32_t d) {
+                    return detail::name_hash(name_of(grouped[k]), d + 1ull) & (table_size - 1);
+                };
+
+                bool placed{false};
+                std::uint32_t d = 0;
+                for (; d < (1u << 16) && !placed; ++d) {
+                    placed = true;
+                    for (std::size_t k = bucket_begin[b]; k < bucket_begin[b + 1] && placed; ++k) {
+                        const auto slot = slot_of(k, d);
+                        if (table_[slot] != 0)
+                            placed = false;
+                        for (std::size_t prev = bucket_begin[b]; prev < k && placed; ++prev)
+                            if (slot_of(prev, d) == slot)
+                                placed = false;
+                    }
+                }
+
+                if (!placed)
+                    throw std::logic_error("Unable to build a perfect hash for a static argument schema");
+
+                displacement_[b] = --d;
+                for (std::size_t k = bucket_begin[b]; k < bucket_begin[b + 1]; ++k)
+                    table_[slot_of(k, d)] = grouped[k] + 1;
+            }
+        }
+
+        std::array<StaticArg, N> args_{};
+        std::array<std::uint32_t, bucket_count> displacement_{};
+        std::array<std::uint32_t, table_size> table_{};
+    };
+
+    template<typename... Args>
+    constexpr StaticSchema<sizeof...(Args)> make_static_schema(const Args&... args) {
+        return StaticSchema<sizeof...(Args)>{std::array<StaticArg, sizeof...(Args)>{args...}};
+    }
+
+    // The parsed state of one arg of a StaticArgParser
+    class StaticArgRef {
+    public:
+        constexpr StaticArgRef(const StaticArg& spec, std::string_view value, bool is_parsed)
+            : spec_{&spec}, value_{value}, is_parsed_{is_parsed} {}
+
+        constexpr const StaticArg& spec() const { return *spec_; }
+        constexpr bool is_parsed() const { return is_parsed_; }
+        constexpr std::string_view value_view() const { return value_; }
+        std::string value() const { return std::string{value_}; }
+
+        template<typename T>
+        T get_value_as() const {
+            return convert<T>(value_).value;
+        }
+
+        template<typename T>
+        ConvertResult<T> try_get_value_as() const {
+            return convert<T>(value_);
+        }
+
+        ConvertResult<std::uint64_t> get_value_as_size() const { return parse_size(value_); }
+
+        ConvertResult<std::chrono::nanoseconds> get_value_as_duration() const { return parse_duration(value_); }
+
+    private:
+        const StaticArg* spec_;
+        std::string_view value_;
+        bool is_parsed_;
+    };
+
+    // Parses argv against a StaticSchema. Values are views into argv and the
+    // parser itself holds no heap memory; only error messages allocate.
+    // The schema must outlive the parser, so declare it static constexpr.
+    template<std::size_t N>
+    class StaticArgParser {
+    public:
+        constexpr explicit StaticArgParser(const StaticSchema<N>& schema) : schema_{&schema} {
+            reset();
+        }
+
+        std::optional<std::string> parse(int argc, char* argv[]) {
+            if (argc < 1 || argv == nullptr)
+                return check_required_args();
+
+            const auto count = static_cast<std::size_t>(argc);
+
+            std::size_t required_count{};
+            for (const auto& spec : schema_->args())
+                required_count += spec.is_required() ? 1 : 0;
+
+            if (count - 1 < required_count)
+                return {"Not all required arguments are specified"};
+
+            for (std::size_t i = 1; i < count; ++i) {
+                if (argv[i] == nullptr)
+                    return {"Parameter format parse error: null argument"};
+
+                const std::string_view parm{detail::ltrim_view(argv[i], '-')};
+                std::string_view parm_name, parm_value;
+
+                if (parm.size() != 1) {
+                    if (!detail::parse_key_arg(parm, parm_name, parm_value))
+                        return {"Parameter format parse error: " + std::string{parm}};
+                } else {
+                    parm_name = parm;
+                }
+
+                const auto index = schema_->find(parm_name);
+                if (index == StaticSchema<N>::npos)
+                    return {"An unknown parameter key is specified: " + std::string{parm}};
+
+                if ((*schema_)[index].is_flag()) {
+                    parsed_[index] = true;
+                    continue;
+                }
+
+                if (parm_value.empty()) {
+                    if (i + 1 >= count || argv[i + 1] == nullptr)
+                        return {"Expected value for the key: " + std::string{parm_name}};
+
+                    parm_value = argv[++i];
+                }
+
+                values_[index] = parm_value;
+                parsed_[index] = true;
+            }
+
+            return check_required_args();
+        }
+
+        StaticArgRef arg(std::string_view name) const {
+            const auto index = schema_->find(name);
+            if (index == StaticSchema<N>::npos)
+                return {empty_arg_, {}, false};
+
+            return {(*schema_)[index], values_[index], parsed_[index]};
+        }
+
+        constexpr const StaticSchema<N>& schema() const { return *schema_; }
+
+        // Restores the default values and clears the parsed flags
+        constexpr void reset() {
+            for (std::size_t i = 0; i < N; ++i) {
+                values_[i] = (*schema_)[i].default_value();
+                parsed_[i] = false;
+            }
+        }
+
+    private:
+        std::optional<std::string> check_required_args() const {
+            for (std::size_t i = 0; i < N; ++i) {
+                const auto& spec = (*schema_)[i];
+                if (spec.is_required() && values_[i].empty())
+                    return {"Expected required parameter value: " + std::string{spec.short_name()} + " [" + std::string{spec.long_name()} + "]"};
+            }
+
+            return {};
+        }
+
+        static constexpr StaticArg empty_arg_{};
+
+        const StaticSchema<N>* schema_;
+        std::array<std::string_view, N> values_{};
+        std::array<bool, N> parsed_{};
+    };
+}
+
+#endif // cli_static_schema_h__
@@ -0,0 +1,36 @@
+#ifndef cli_token_h__
+#define cli_token_h__
+
+#include <string_view>
+
+namespace cliap::detail {
+    // Strips trailing repetitions of pattern
+    constexpr std::string_view rtrim_copy(std::string_view str, std::string_view pattern) {
+        while (!pattern.empty() && str.size() >= pattern.size() && str.substr(str.size() - pattern.size()) == pattern)
+            str.remove_suffix(pattern.size());
+
+        return str;
+    }
+
+    constexpr std::string_view ltrim_view(std::string_view s, char sym = ' ') {
+        const auto pos = s.find_first_not_of(sym);
+        return pos == std::string_view::npos ? std::string_view{} : s.substr(pos);
+    }
+
+    // parse parameters like --listen-port=1010
+    constexpr bool parse_key_arg(std::string_view in_str, std::string_view& key, std::string_view& value) {
+        key = {};
+        value = {};
+
+        if (const auto equal_pos = in_str.find('='); equal_pos != std::string_view::npos) {
+            key = rtrim_copy(in_str.substr(0, equal_pos), " ");
+            value = rtrim_copy(in_str.substr(equal_pos + 1, in_str.size() - equal_pos), " ");
+        } else {
+            key = in_str;
+        }
+
+        return !key.empty() || !value.empty();
+    }
+}
+
+#endif // cli_token_h__
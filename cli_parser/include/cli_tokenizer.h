@@ -0,0 +1,64 @@
+#ifndef cli_tokenizer_h__
+#define cli_tokenizer_h__
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+namespace cliap {
+    enum class TokenStatus {
+        token,
+        // All input is consumed
+        end,
+        // The input so far ends inside a token, a quote or a comment; feed()
+        // more or call finish()
+        need_more,
+        // The input ends inside a quoted string
+        unterminated
+    };
+
+    // Splits command strings into arguments like a POSIX shell: whitespace
+    // runs separate tokens, 'single quotes' are literal, "double quotes"
+    // honour \", \\, \$, \` and line continuations, a backslash outside
+    // quotes escapes the next character and a # at the start of a token
+    // comments out the rest of the line.
+    //
+    // Tokens without quotes or escapes are views into the input; the others
+    // are unescaped into a buffer of the tokenizer. Either way a token stays
+    // valid until the next call to next() or feed().
+    class ShellTokenizer {
+    public:
+        // Tokenizes input that arrives in chunks through feed()
+        ShellTokenizer() = default;
+
+        // Tokenizes one complete command string without copying it
+        explicit ShellTokenizer(std::string_view text) : rest_{text}, finished_{true} {}
+
+        // Appends a chunk of input. A token is only returned once the
+        // whitespace after it has arrived, or after finish().
+        void feed(std::string_view chunk);
+
+        // Marks the end of the input
+        void finish() { finished_ = true; }
+
+        TokenStatus next(std::string_view& token);
+
+    private:
+        std::string buffer_;
+        std::string_view rest_;
+        std::pmr::string scratch_;
+        bool buffered_{false};
+        bool finished_{false};
+    };
+
+    namespace detail {
+        // Splits the next token off rest; returns token, end or unterminated
+        TokenStatus next_shell_token(std::string_view& rest, std::string_view& token, std::pmr::string& scratch);
+
+        // Offset of the first whitespace, quote or backslash in text, or its size
+        std::size_t find_shell_special(std::string_view text);
+    }
+}
+
+#endif // cli_tokenizer_h__
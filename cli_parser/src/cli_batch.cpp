@@ -0,0 +1,258 @@
+#include "cli_batch.h"
+#include "cli_parser.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cliap
+{
+    namespace {
+        // Takes the next line off the front of text, without its line ending
+        std::string_view take_line(std::string_view& text)
+        {
+            const auto end = text.find('\n');
+            auto line = text.substr(0, end);
+            text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            return line;
+        }
+
+        bool is_blank_line(std::string_view line)
+        {
+            return line.find_first_not_of(" \t\v\f") == std::string_view::npos;
+        }
+
+        struct BatchFailure {
+            // Position of the line in its chunk, blank lines included
+            std::size_t line;
+            // Span of the error in the messages of the chunk
+            std::size_t offset;
+            std::size_t size;
+        };
+
+        struct BatchChunk {
+            std::string_view text;
+            std::vector<BatchFailure> failures;
+            std::string messages;
+            bool done{false};
+        };
+
+        // The chunks of one worker. Its owner takes them from the front, in
+        // input order; thieves take them from the back, furthest from the
+        // lines waiting to be handed out.
+        struct BatchQueue {
+            std::mutex mutex;
+            std::deque<std::size_t> chunks;
+
+            std::optional<std::size_t> take_front()
+            {
+                std::lock_guard lock{mutex};
+                if (chunks.empty())
+                    return {};
+                const auto chunk = chunks.front();
+                chunks.pop_front();
+                return chunk;
+            }
+
+            std::optional<std::size_t> take_back()
+            {
+                std::lock_guard lock{mutex};
+                if (chunks.empty())
+                    return {};
+                const auto chunk = chunks.back();
+                chunks.pop_back();
+                return chunk;
+            }
+        };
+
+        class BatchRun {
+        public:
+            BatchRun(const ArgSchema& schema, std::string_view text, const BatchOptions& options)
+                : schema_{schema}
+            {
+                const auto chunk_size = std::max<std::size_t>(options.chunk_size, 1);
+                while (!text.empty()) {
+                    auto end = std::min(chunk_size, text.size());
+                    if (end < text.size()) {
+                        const auto newline = text.find('\n', end - 1);
+                        end = newline == std::string_view::npos ? text.size() : newline + 1;
+                    }
+                    chunks_.emplace_back().text = text.substr(0, end);
+                    text.remove_prefix(end);
+                }
+
+                const auto hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+                const auto thread_count = std::min<std::size_t>(options.threads ? options.threads : hardware_threads, chunks_.size());
+
+                // Dealt out in turn, so the chunks handed out next are spread
+                // over all the workers
+                queues_ = std::vector<BatchQueue>(thread_count);
+                for (std::size_t i = 0; i < chunks_.size(); ++i)
+                    queues_[i % thread_count].chunks.push_back(i);
+
+                threads_.reserve(thread_count);
+                try {
+                    for (std::size_t worker = 0; worker < thread_count; ++worker)
+                        threads_.emplace_back([this, worker] { work(worker); });
+                } catch (...) {
+                    join();
+                    throw;
+                }
+            }
+
+            ~BatchRun() { join(); }
+
+            BatchRun(const BatchRun&) = delete;
+            BatchRun& operator=(const BatchRun&) = delete;
+
+            BatchSummary hand_out(const BatchValidator::LineHandler& on_line)
+            {
+                BatchSummary summary;
+                std::size_t number = 0;
+                for (auto& chunk : chunks_) {
+                    wait_for(chunk);
+
+                    auto text = chunk.text;
+                    auto failure = chunk.failures.begin();
+                    for (std::size_t line_index = 0; !text.empty(); ++line_index) {
+                        BatchLine line;
+                        line.number = ++number;
+                        line.text = take_line(text);
+                        if (is_blank_line(line.text))
+                            continue;
+
+                        ++summary.lines;
+                        if (failure != chunk.failures.end() && failure->line == line_index) {
+                            line.error = std::string_view{chunk.messages}.substr(failure->offset, failure->size);
+                            ++summary.errors;
+                            ++failure;
+                        }
+
+                        if (on_line)
+                            on_line(line);
+                    }
+
+                    // Done with: the memory goes back while later chunks are parsed
+                    std::vector<BatchFailure>{}.swap(chunk.failures);
+                    std::string{}.swap(chunk.messages);
+                }
+
+                return summary;
+            }
+
+        private:
+            void join()
+            {
+                stop_ = true;
+                for (auto& thread : threads_)
+                    thread.join();
+            }
+
+            void work(std::size_t worker)
+            {
+                ParseResult result;
+                try {
+                    while (!stop_) {
+                        const auto index = next_chunk(worker);
+                        if (!index)
+                            break;
+
+                        parse(chunks_[*index], result);
+
+                        {
+                            std::lock_guard lock{mutex_};
+                            chunks_[*index].done = true;
+                        }
+                        done_.notify_one();
+                    }
+                } catch (...) {
+                    {
+                        std::lock_guard lock{mutex_};
+                        if (!failure_)
+                            failure_ = std::current_exception();
+                    }
+                    stop_ = true;
+                    done_.notify_one();
+                }
+            }
+
+            std::optional<std::size_t> next_chunk(std::size_t worker)
+            {
+                if (auto index = queues_[worker].take_front())
+                    return index;
+
+                for (std::size_t i = 1; i < queues_.size(); ++i) {
+                    if (auto index = queues_[(worker + i) % queues_.size()].take_back())
+                        return index;
+                }
+
+                return {};
+            }
+
+            void parse(BatchChunk& chunk, ParseResult& result) const
+            {
+                auto text = chunk.text;
+                for (std::size_t line_index = 0; !text.empty(); ++line_index) {
+                    const auto line = take_line(text);
+                    if (is_blank_line(line))
+                        continue;
+
+                    schema_.parse_command_line(line, result);
+                    if (const auto error = result.error()) {
+                        chunk.failures.push_back({line_index, chunk.messages.size(), error->size()});
+                        chunk.messages.append(*error);
+                    }
+                }
+            }
+
+            void wait_for(const BatchChunk& chunk)
+            {
+                std::unique_lock lock{mutex_};
+                done_.wait(lock, [this, &chunk] { return chunk.done || failure_; });
+                if (failure_)
+                    std::rethrow_exception(failure_);
+            }
+
+            const ArgSchema& schema_;
+            std::vector<BatchChunk> chunks_;
+            std::vector<BatchQueue> queues_;
+            std::vector<std::thread> threads_;
+            std::mutex mutex_;
+            std::condition_variable done_;
+            std::exception_ptr failure_;
+            std::atomic<bool> stop_{false};
+        };
+    }
+
+    BatchValidator::BatchValidator(std::shared_ptr<const ArgSchema> schema, BatchOptions options)
+        : schema_{std::move(schema)}, options_{options}
+    {
+        if (!schema_)
+            throw std::runtime_error("BatchValidator needs a schema");
+    }
+
+    BatchSummary BatchValidator::validate(std::string_view text, const LineHandler& on_line) const
+    {
+        BatchRun run{*schema_, text, options_};
+        return run.hand_out(on_line);
+    }
+
+    BatchSummary BatchValidator::validate_file(const std::string& path, const LineHandler& on_line) const
+    {
+        detail::MappedFile file;
+        if (!file.open(path.c_str()))
+            throw std::runtime_error("Unable to read " + path);
+
+        return validate(file.view(), on_line);
+    }
+}
@@ -0,0 +1,372 @@
+#include "cli_convert.h"
+
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <system_error>
+
+namespace cliap
+{
+    namespace {
+        constexpr ConvertError from_errc(std::errc ec)
+        {
+            if (ec == std::errc{})
+                return ConvertError::none;
+
+            return ec == std::errc::result_out_of_range ? ConvertError::out_of_range : ConvertError::invalid_format;
+        }
+
+        bool iequals(std::string_view lhs, std::string_view rhs)
+        {
+            if (lhs.size() != rhs.size())
+                return false;
+
+            for (std::size_t i = 0; i < lhs.size(); ++i) {
+                const auto l = (lhs[i] >= 'A' && lhs[i] <= 'Z') ? static_cast<char>(lhs[i] - 'A' + 'a') : lhs[i];
+                if (l != rhs[i])
+                    return false;
+            }
+
+            return true;
+        }
+
+        bool is_digit(char ch) { return ch >= '0' && ch <= '9'; }
+
+        // Strips a 0x/0o/0b prefix and returns the radix it selects
+        int take_radix_prefix(std::string_view& str)
+        {
+            if (str.size() > 2 && str[0] == '0') {
+                switch (str[1]) {
+                case 'x': case 'X': str.remove_prefix(2); return 16;
+                case 'o': case 'O': str.remove_prefix(2); return 8;
+                case 'b': case 'B': str.remove_prefix(2); return 2;
+                default: break;
+                }
+            }
+
+            return 10;
+        }
+
+        ConvertResult<unsigned long long> to_magnitude(std::string_view str)
+        {
+            const int radix = take_radix_prefix(str);
+
+            // from_chars accepts a sign for signed types only, but be explicit
+            if (str.empty() || str.front() == '-' || str.front() == '+')
+                return {0, ConvertError::invalid_format};
+
+            unsigned long long value{};
+            const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value, radix);
+
+            if (ec != std::errc{})
+                return {0, from_errc(ec)};
+            if (ptr != str.data() + str.size())
+                return {0, ConvertError::trailing_characters};
+
+            return {value, ConvertError::none};
+        }
+
+        template<typename T>
+        ConvertResult<T> to_floating(std::string_view str)
+        {
+            if (!str.empty() && str.front() == '+')
+                str.remove_prefix(1);
+
+            if (str.empty() || str.front() == '+')
+                return {T{}, ConvertError::invalid_format};
+
+            T value{};
+#if defined(__cpp_lib_to_chars)
+            const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+
+            if (ec != std::errc{})
+                return {T{}, from_errc(ec)};
+            if (ptr != str.data() + str.size())
+                return {T{}, ConvertError::trailing_characters};
+#else
+            // Standard libraries without floating-point from_chars
+            const std::string buffer{str};
+            char* end{};
+            errno = 0;
+            value = static_cast<T>(std::strtold(buffer.c_str(), &end));
+
+            if (end == buffer.c_str())
+                return {T{}, ConvertError::invalid_format};
+            if (errno == ERANGE)
+                return {T{}, ConvertError::out_of_range};
+            if (end != buffer.c_str() + buffer.size())
+                return {T{}, ConvertError::trailing_characters};
+#endif
+            return {value, ConvertError::none};
+        }
+
+        // Splits a leading unsigned decimal number (with an optional fraction) off str
+        std::string_view take_number(std::string_view& str)
+        {
+            std::size_t pos{};
+            while (pos < str.size() && is_digit(str[pos]))
+                ++pos;
+
+            if (pos < str.size() && str[pos] == '.') {
+                ++pos;
+                while (pos < str.size() && is_digit(str[pos]))
+                    ++pos;
+            }
+
+            const auto number = str.substr(0, pos);
+            str.remove_prefix(pos);
+            return number;
+        }
+
+        // Multiplies a decimal number by unit with overflow detection
+        ConvertResult<std::uint64_t> scale(std::string_view number, std::uint64_t unit)
+        {
+            constexpr auto max = std::numeric_limits<std::uint64_t>::max();
+
+            if (number.empty() || number == ".")
+                return {0, ConvertError::invalid_format};
+
+            const auto dot = number.find('.');
+            const auto int_part = number.substr(0, dot);
+
+            std::uint64_t whole{};
+            if (!int_part.empty()) {
+                const auto [ptr, ec] = std::from_chars(int_part.data(), int_part.data() + int_part.size(), whole);
+                if (ec != std::errc{})
+                    return {0, from_errc(ec)};
+            }
+
+            if (whole > max / unit)
+                return {0, ConvertError::out_of_range};
+
+            std::uint64_t result = whole * unit;
+
+            if (dot != std::string_view::npos && dot + 1 < number.size()) {
+                // Only the fraction goes through floating point, so large integral
+                // values stay exact
+                const auto frac_digits = number.substr(dot + 1);
+                long double fraction{};
+                long double weight{0.1L};
+                for (const char ch : frac_digits) {
+                    fraction += static_cast<long double>(ch - '0') * weight;
+                    weight /= 10;
+                }
+
+                const auto extra = static_cast<std::uint64_t>(std::floor(fraction * static_cast<long double>(unit)));
+                if (extra > max - result)
+                    return {0, ConvertError::out_of_range};
+                result += extra;
+            }
+
+            return {result, ConvertError::none};
+        }
+
+        struct Unit {
+            std::string_view suffix;
+            std::uint64_t factor;
+        };
+
+        constexpr std::uint64_t KiB = 1024;
+        constexpr std::uint64_t KB = 1000;
+
+        constexpr std::array<Unit, 21> size_units{{
+            {"B", 1},
+            {"K", KiB}, {"k", KiB}, {"KiB", KiB}, {"KB", KB}, {"kB", KB},
+            {"M", KiB * KiB}, {"MiB", KiB * KiB}, {"MB", KB * KB},
+            {"G", KiB * KiB * KiB}, {"GiB", KiB * KiB * KiB}, {"GB", KB * KB * KB},
+            {"T", KiB * KiB * KiB * KiB}, {"TiB", KiB * KiB * KiB * KiB}, {"TB", KB * KB * KB * KB},
+            {"P", KiB * KiB * KiB * KiB * KiB}, {"PiB", KiB * KiB * KiB * KiB * KiB}, {"PB", KB * KB * KB * KB * KB},
+            {"E", KiB * KiB * KiB * KiB * KiB * KiB}, {"EiB", KiB * KiB * KiB * KiB * KiB * KiB}, {"EB", KB * KB * KB * KB * KB * KB},
+        }};
+
+        constexpr std::uint64_t ns_per_s = 1000000000;
+
+        // Two-letter units come first so that "ms" is not taken for "m"
+        constexpr std::array<Unit, 9> duration_units{{
+            {"ns", 1}, {"us", 1000}, {"\xC2\xB5s", 1000}, {"ms", 1000000},
+            {"min", 60 * ns_per_s}, {"s", ns_per_s}, {"m", 60 * ns_per_s},
+            {"h", 3600 * ns_per_s}, {"d", 86400 * ns_per_s},
+        }};
+    }
+
+    const char* convert_error_message(ConvertError error)
+    {
+        switch (error) {
+        case ConvertError::none: return "no error";
+        case ConvertError::empty: return "value is empty";
+        case ConvertError::invalid_format: return "invalid format";
+        case ConvertError::trailing_characters: return "unexpected trailing characters";
+        case ConvertError::out_of_range: return "value is out of range";
+        case ConvertError::unknown_suffix: return "unknown unit suffix";
+        }
+
+        return "unknown error";
+    }
+
+    ConvertResult<bool> parse_bool(std::string_view str)
+    {
+        if (str.empty())
+            return {false, ConvertError::empty};
+
+        for (const auto word : {"true", "yes", "on", "1"})
+            if (iequals(str, word))
+                return {true, ConvertError::none};
+
+        for (const auto word : {"false", "no", "off", "0"})
+            if (iequals(str, word))
+                return {false, ConvertError::none};
+
+        return {false, ConvertError::invalid_format};
+    }
+
+    ConvertResult<std::uint64_t> parse_size(std::string_view str)
+    {
+        if (str.empty())
+            return {0, ConvertError::empty};
+
+        const auto number = take_number(str);
+
+        while (!str.empty() && str.front() == ' ')
+            str.remove_prefix(1);
+
+        if (str.empty())
+            return scale(number, 1);
+
+        for (const auto& unit : size_units)
+            if (unit.suffix == str)
+                return scale(number, unit.factor);
+
+        if (number.empty())
+            return {0, ConvertError::invalid_format};
+
+        return {0, ConvertError::unknown_suffix};
+    }
+
+    ConvertResult<std::chrono::nanoseconds> parse_duration(std::string_view str)
+    {
+        using std::chrono::nanoseconds;
+
+        if (str.empty())
+            return {nanoseconds{}, ConvertError::empty};
+
+        const bool negative = str.front() == '-';
+        if (negative || str.front() == '+')
+            str.remove_prefix(1);
+
+        if (str == "0")
+            return {nanoseconds{}, ConvertError::none};
+
+        constexpr auto max = static_cast<std::uint64_t>(std::numeric_limits<nanoseconds::rep>::max());
+        std::uint64_t total{};
+
+        do {
+            const auto number = take_number(str);
+            if (number.empty())
+                return {nanoseconds{}, ConvertError::invalid_format};
+
+            const Unit* found{};
+            for (const auto& unit : duration_units) {
+                if (str.substr(0, unit.suffix.size()) == unit.suffix) {
+                    found = &unit;
+                    break;
+                }
+            }
+
+            if (!found)
+                return {nanoseconds{}, str.empty() ? ConvertError::invalid_format : ConvertError::unknown_suffix};
+
+            str.remove_prefix(found->suffix.size());
+
+            const auto part = scale(number, found->factor);
+            if (!part)
+                return {nanoseconds{}, part.error};
+
+            if (part.value > max - total)
+                return {nanoseconds{}, ConvertError::out_of_range};
+
+            total += part.value;
+        } while (!str.empty());
+
+        const auto count = static_cast<nanoseconds::rep>(total);
+        return {nanoseconds{negative ? -count : count}, ConvertError::none};
+    }
+
+    namespace detail {
+        ConvertResult<long long> to_signed(std::string_view str, long long min, long long max)
+        {
+            const bool negative = !str.empty() && str.front() == '-';
+            if (negative || (!str.empty() && str.front() == '+'))
+                str.remove_prefix(1);
+
+            const auto magnitude = to_magnitude(str);
+            if (!magnitude)
+                return {0, magnitude.error};
+
+            if (negative) {
+                const auto limit = static_cast<unsigned long long>(-(min + 1)) + 1;
+                if (magnitude.value > limit)
+                    return {0, ConvertError::out_of_range};
+
+                if (magnitude.value == 0)
+                    return {0, ConvertError::none};
+
+                return {-static_cast<long long>(magnitude.value - 1) - 1, ConvertError::none};
+            }
+
+            if (magnitude.value > static_cast<unsigned long long>(max))
+                return {0, ConvertError::out_of_range};
+
+            return {static_cast<long long>(magnitude.value), ConvertError::none};
+        }
+
+        ConvertResult<unsigned long long> to_unsigned(std::string_view str, unsigned long long max)
+        {
+            if (!str.empty() && str.front() == '+')
+                str.remove_prefix(1);
+
+            const auto magnitude = to_magnitude(str);
+            if (!magnitude)
+                return magnitude;
+
+            if (magnitude.value > max)
+                return {0, ConvertError::out_of_range};
+
+            return magnitude;
+        }
+
+        ConvertResult<float> to_float(std::string_view str) { return to_floating<float>(str); }
+
+        ConvertResult<double> to_double(std::string_view str) { return to_floating<double>(str); }
+
+        ConvertResult<long double> to_long_double(std::string_view str) { return to_floating<long double>(str); }
+
+        ConvertError read_stream(std::string_view str, void (*read)(std::istream& in, void* value), void* value)
+        {
+            std::istringstream ss{std::string{str}};
+            read(ss, value);
+            if (!ss)
+                return ConvertError::invalid_format;
+            if (ss.peek() != std::istringstream::traits_type::eof())
+                return ConvertError::trailing_characters;
+            return ConvertError::none;
+        }
+
+        std::string write_stream(void (*write)(std::ostream& out, const void* value), const void* value)
+        {
+            std::ostringstream out;
+            write(out, value);
+            return out.str();
+        }
+
+        std::string format_float(long double value)
+        {
+            char buffer[64];
+            const auto length = std::snprintf(buffer, sizeof(buffer), "%Lg", value);
+            return {buffer, static_cast<std::size_t>(length)};
+        }
+    }
+}
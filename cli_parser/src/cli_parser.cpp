@@ -1,94 +1,255 @@
 ﻿#include "cli_parser.h"
-
+#include "cli_token.h"
+#include "cli_tokenizer.h"
+#include "completion.h"
+#include "config_file.h"
+#include "environment.h"
+#include "help_format.h"
+#include "instrumentation.h"
+#include "parse_storage.h"
+#include "snapshot_format.h"
+#include "suggest.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
 #include <sstream>
 #include <memory>
 #include <utility>
-#include <iomanip>
 
 namespace cliap
 {
     using namespace std::string_literals;
+    using detail::ltrim_view;
+    using detail::parse_key_arg;
+    using detail::rtrim_copy;
 
     namespace {
-        std::string_view rtrim_copy(std::string_view str, std::string_view pattern) {
-            if (const auto pos = str.rfind(pattern.data()); pos != std::string_view::npos)
-                return std::string_view{str.data(), pos};
+        // The comma-separated names of an Arg without surrounding spaces and
+        // leading dashes. Empty items are skipped and only the first two
+        // names are kept; returns the number of names found.
+        std::size_t split_names(std::string_view str, std::array<std::string_view, 2>& names)
+        {
+            std::size_t count{};
+
+            while (!str.empty()) {
+                const auto comma = std::min(str.find(','), str.size());
+                if (comma > 0) {
+                    if (count < names.size())
+                        names[count] = ltrim_view(rtrim_copy(ltrim_view(str.substr(0, comma)), " "), '-');
+                    ++count;
+                }
+                str.remove_prefix(std::min(comma + 1, str.size()));
+            }
 
-            return str;
+            return count;
         }
+    }
 
-        std::vector<std::string> split(const std::string& str, std::string_view delimeter)
-        {
-            std::string::size_type cur_pos{};
-            std::string::size_type next_pos{};
+    namespace detail {
+        namespace {
+            constexpr std::size_t max_response_file_depth = 16;
+        }
 
-            std::vector<std::string> items;
+        // The tokens of one parse: the caller's arguments or command string,
+        // with @file tokens replaced by the contents of the response file once
+        // expansion is enabled. Command strings and files are tokenized
+        // lazily, one token at a time.
+        class TokenStream {
+        public:
+            struct Token {
+                std::string_view text;
+                // The text outlives the parse (borrowed argv or parser storage)
+                bool stable{};
+            };
+
+            // Tokens from argv are stable when borrow_argv is set; the
+            // others are copied when kept
+            TokenStream(char* const* argv, const std::string* strings, std::size_t count, bool borrow_argv = false)
+                : argv_{argv}, strings_{strings}, count_{count}, borrow_argv_{borrow_argv} {}
+
+            // A command string split like a shell would; its first token is
+            // the program name
+            explicit TokenStream(std::string_view command_line)
+                : argv_{}, strings_{}, count_{}, command_line_{command_line}, is_command_line_{true} {}
+
+            // Unknown for a command string until it is tokenized
+            std::optional<std::size_t> argument_count() const
+            {
+                if (is_command_line_)
+                    return {};
+                return count_;
+            }
 
-            while ((next_pos = str.find_first_of(delimeter, cur_pos)) != std::string::npos) {
-                if ((next_pos - cur_pos) > 0)
-                    items.emplace_back(std::string{str.data() + cur_pos, next_pos - cur_pos});
-                cur_pos = next_pos + 1;
+            // Where command strings, response files and unescaped tokens are
+            // kept, created from resource on first use; @file tokens are only
+            // expanded when expand is set
+            void use_storage(std::shared_ptr<ParseStorage>& storage, std::pmr::memory_resource* resource, bool expand)
+            {
+                storage_ = &storage;
+                resource_ = resource;
+                expand_ = expand;
             }
 
-            if (cur_pos < str.size())
-                items.emplace_back(std::string{str.data() + cur_pos, str.size() - cur_pos});
+            bool next(Token& token)
+            {
+                if (pending_) {
+                    token = *pending_;
+                    pending_.reset();
+                    return true;
+                }
 
-            return items;
-        }
+                if (is_command_line_ && !started_) {
+                    // Copied once, so that the tokens are views into storage
+                    auto& storage = this->storage();
+                    storage.sources.push_back({{}, storage.arena.store(command_line_)});
+                }
+                started_ = true;
 
-        void ltrim(std::string& s, char sym = ' ')
-        {
-            s.erase(s.begin(), std::find_if(s.begin(), s.end(), [sym](int ch)
-            {
-                return !(ch == sym);
-            }));
-        }
+                while (error_ == ParseErrorCode::none) {
+                    if (storage_ && *storage_ && !(*storage_)->sources.empty()) {
+                        auto& storage = **storage_;
+                        auto& source = storage.sources.back();
+                        std::string_view text;
+                        const auto status = next_shell_token(source.rest, text, storage.scratch);
 
-        void rtrim(std::string& s, char sym = ' ')
-        {
-            s.erase(std::find_if(s.rbegin(), s.rend(), [sym](int ch)
-            {
-                return !(ch == sym);
-            }).base(), s.end());
-        }
+                        if (status == TokenStatus::end) {
+                            storage.sources.pop_back();
+                            continue;
+                        }
 
-        void trim(std::string& s, char sym = ' ')
-        {
-            ltrim(s, sym);
-            rtrim(s, sym);
-        }
+                        if (status == TokenStatus::unterminated) {
+                            // No path for the command string itself
+                            error_ = ParseErrorCode::unterminated_quote;
+                            error_subject_ = source.path;
+                            return false;
+                        }
 
-        // parse parameters like --listen-port=1010
-        bool parse_key_arg(std::string_view in_str, std::string& key, std::string& value) {
-            key.clear();
-            value.clear();
+                        if (text.data() == storage.scratch.data())
+                            text = storage.arena.store(text);
 
-            if (const auto equal_pos = in_str.find('='); equal_pos != std::string::npos) {
-                key = rtrim_copy(in_str.substr(0, equal_pos), " ");
-                value = rtrim_copy(in_str.substr(equal_pos + 1, in_str.size() - equal_pos), " ");
-            } else {
-                key = in_str;
+                        // The program name is never expanded
+                        if (returned_ > 0 && expand(text))
+                            continue;
+
+                        return emit({text, true}, token);
+                    }
+
+                    if (pos_ >= count_)
+                        return false;
+
+                    const auto text = argv_ ? std::string_view{argv_[pos_]} : std::string_view{strings_[pos_]};
+                    ++pos_;
+
+                    if (returned_ > 0 && expand(text))
+                        continue;
+
+                    return emit({text, borrow_argv_}, token);
+                }
+
+                return false;
             }
 
-            return !key.empty() || !value.empty();
-        }
+            // Returns a token to the stream; the next call to next() yields it again
+            void put_back(const Token& token) { pending_ = token; }
 
-        std::vector<std::string> strings_from_raw_args(int argc, char* argv[]) {
-            if (argc < 1 || argv == nullptr)
-                return {};
+            // Position of the last token returned, the program name being 0
+            std::size_t position() const { return returned_ - 1; }
 
-            std::vector<std::string> args;
-            args.reserve(static_cast<std::size_t>(argc));
+            // Number of tokens returned so far
+            std::size_t count() const { return returned_; }
 
-            for (int i = 0; i < argc; ++i) {
-                if (argv[i] == nullptr)
-                    return {};
+            bool failed() const { return error_ != ParseErrorCode::none; }
 
-                args.emplace_back(std::string{argv[i]});
+            // What failed and the path it is about, if any
+            ParseErrorCode error() const { return error_; }
+            std::string_view error_subject() const { return error_subject_; }
+
+        private:
+            bool emit(const Token& value, Token& token)
+            {
+                token = value;
+                ++returned_;
+                return true;
             }
 
-            return args;
-        }
+            ParseStorage& storage()
+            {
+                if (!*storage_)
+                    *storage_ = make_parse_storage(resource_);
+
+                return **storage_;
+            }
+
+            // Reads the response file named by an @path token into storage
+            bool expand(std::string_view text)
+            {
+                if (!expand_ || text.size() < 2 || text.front() != '@')
+                    return false;
+
+                auto& storage = this->storage();
+                const auto path = storage.arena.store_c_str(text.substr(1));
+
+                if (storage.sources.size() >= max_response_file_depth) {
+                    error_ = ParseErrorCode::response_file_nesting;
+                    error_subject_ = path;
+                    return true;
+                }
+
+                const auto contents = storage.arena.store_file(path.data());
+                if (!contents) {
+                    error_ = ParseErrorCode::response_file_unreadable;
+                    error_subject_ = path;
+                    return true;
+                }
+
+                storage.sources.push_back({path, *contents});
+                return true;
+            }
+
+            char* const* argv_;
+            const std::string* strings_;
+            std::size_t count_;
+            bool borrow_argv_{false};
+            std::size_t pos_{};
+            std::string_view command_line_;
+            bool is_command_line_{false};
+            bool started_{false};
+            std::size_t returned_{};
+            std::shared_ptr<ParseStorage>* storage_{};
+            std::pmr::memory_resource* resource_{};
+            bool expand_{false};
+            std::optional<Token> pending_;
+            ParseErrorCode error_{ParseErrorCode::none};
+            std::string_view error_subject_;
+        };
+
+        // The schema and result of an enclosing parser while one of its
+        // commands is parsed
+        struct ParseScope {
+            const ArgSchema* schema;
+            ParseResult* result;
+            const ParseScope* outer;
+        };
+
+        // The words of a command line being completed
+        struct CompletionWords {
+            const char* const* argv;
+            const std::string* strings;
+            std::size_t count;
+
+            std::string_view operator[](std::size_t index) const
+            {
+                return argv ? std::string_view{argv[index]} : std::string_view{strings[index]};
+            }
+        };
+
+        // The parser of an enclosing scope while the words of one of its
+        // commands are completed
+        struct CompletionScope {
+            ArgParser* parser;
+            const CompletionScope* outer;
+        };
     }
 
     Arg& Arg::required()
@@ -103,261 +264,1958 @@ namespace cliap
         return *this;
     }
 
-    Arg::Arg(std::string name)
+    Arg& Arg::repeated()
     {
-        auto names = split(name, ",");
+        is_repeated_ = true;
+        return *this;
+    }
 
-        for (auto& it : names)
-        {
-            trim(it);
-            ltrim(it, '-');
-        }
+    Arg& Arg::multi_value()
+    {
+        is_multi_value_ = true;
+        is_repeated_ = true;
+        return *this;
+    }
+
+    Arg& Arg::positional()
+    {
+        is_positional_ = true;
+        return *this;
+    }
+
+    Arg::Arg(std::string_view name, const allocator_type& alloc)
+        : text_{alloc}, value_{alloc}, values_{alloc}
+    {
+        std::array<std::string_view, 2> names{};
+        const auto count = split_names(name, names);
 
-        if (names.empty())
+        if (count == 0)
             throw std::runtime_error("Command line parameter must have name");
 
-        if (names.size() > 1 && names[0].size() == 1 && names[1].size() == 1)
+        if (count > 1 && names[0].size() == 1 && names[1].size() == 1)
             throw std::runtime_error("Command line parameter must have only one short name");
 
-        if (names.size() > 1 && names[0].size() > 1 && names[1].size() > 1)
+        if (count > 1 && names[0].size() > 1 && names[1].size() > 1)
             throw std::runtime_error("Command line parameter must have only one long name");
 
-        if (names.size() == 1)
+        if (count == 1)
         {
-            if (names[0].size() > 1)
-                long_name_ = names[0];
-            else
-                short_name_ = names[0];
-        } else if (names.size() > 1) {
-            short_name_ = names[0];
-            long_name_ = names[1];
-
+            set_field(names[0].size() > 1 ? long_field : short_field, names[0]);
+        } else {
             if (names[0].size() > names[1].size())
-                std::swap(short_name_, long_name_);
+                std::swap(names[0], names[1]);
+
+            set_field(short_field, names[0]);
+            set_field(long_field, names[1]);
         }
     }
 
-    Arg& Arg::short_name(std::string short_name)
+    Arg::Arg(const Arg& other, const allocator_type& alloc)
+        : text_{other.text_, alloc}, field_ends_{other.field_ends_}, value_{other.value_, alloc},
+          value_ref_{other.value_ref_}, value_borrowed_{other.value_borrowed_}, is_required_{other.is_required_},
+          is_flag_{other.is_flag_}, is_parsed_{other.is_parsed_}, is_repeated_{other.is_repeated_},
+          is_multi_value_{other.is_multi_value_}, is_positional_{other.is_positional_}, source_{other.source_},
+          values_{other.values_, alloc}
+    {
+    }
+
+    Arg::Arg(Arg&& other, const allocator_type& alloc)
+        : text_{std::move(other.text_), alloc}, field_ends_{other.field_ends_}, value_{std::move(other.value_), alloc},
+          value_ref_{other.value_ref_}, value_borrowed_{other.value_borrowed_}, is_required_{other.is_required_},
+          is_flag_{other.is_flag_}, is_parsed_{other.is_parsed_}, is_repeated_{other.is_repeated_},
+          is_multi_value_{other.is_multi_value_}, is_positional_{other.is_positional_}, source_{other.source_},
+          values_{std::move(other.values_), alloc}
+    {
+    }
+
+    Arg& Arg::short_name(std::string_view short_name)
     {
-        short_name_ = short_name;
-        ltrim(short_name_, '-');
+        set_field(short_field, ltrim_view(short_name, '-'));
         return *this;
     }
 
-    Arg& Arg::long_name(std::string long_name)
+    Arg& Arg::long_name(std::string_view long_name)
     {
-        long_name_ = long_name;
-        ltrim(long_name_, '-');
+        set_field(long_field, ltrim_view(long_name, '-'));
         return *this;
     }
 
-    Arg& Arg::default_value(std::string default_value)
+    Arg& Arg::default_value(std::string_view default_value)
     {
-        default_value_ = default_value;
+        set_field(default_field, default_value);
         return *this;
     }
 
-    Arg& Arg::description(std::string description)
+    Arg& Arg::description(std::string_view description)
     {
-        description_ = description;
+        set_field(description_field, description);
         return *this;
     }
 
-    Arg& Arg::value(std::string value)
+    Arg& Arg::env(std::string_view name)
     {
-        value_ = value;
+        set_field(env_field, name);
         return *this;
     }
 
-    ArgParser& ArgParser::add_parameter(Arg parm)
+    void Arg::set_field(Field f, std::string_view text)
+    {
+        const std::size_t begin = f == short_field ? 0 : field_ends_[f - 1];
+        const std::size_t end = f == env_field ? text_.size() : field_ends_[f];
+
+        text_.replace(begin, end - begin, text);
+
+        for (std::size_t i = f; i < field_ends_.size(); ++i)
+            field_ends_[i] = static_cast<std::uint32_t>(field_ends_[i] - (end - begin) + text.size());
+    }
+
+    Arg& Arg::value(std::string_view value)
+    {
+        value_.assign(value);
+        value_borrowed_ = false;
+        return *this;
+    }
+
+    ArgParser::ArgParser()
+        : ArgParser{std::pmr::get_default_resource()}
+    {
+    }
+
+    ArgParser::ArgParser(std::pmr::memory_resource* resource)
+        :
+#if CLI_PARSER_INSTRUMENTATION
+          instrumentation_{std::allocate_shared<detail::Instrumentation>(std::pmr::polymorphic_allocator<detail::Instrumentation>{resource}, resource)},
+          resource_{instrumentation_.get()},
+#else
+          resource_{resource},
+#endif
+          registry_{ArgSchema::allocator_type{resource_}}, usage_examples_{resource_}, result_{resource_},
+          commands_{resource_}, command_parsers_{resource_}, value_providers_{resource_}, bindings_{resource_}, completion_{resource_},
+          help_{resource_}, empty_arg_{Arg::allocator_type{resource_}}
+    {
+    }
+
+    ArgParser::ArgParser(ArgParser&& other)
+        :
+#if CLI_PARSER_INSTRUMENTATION
+          instrumentation_{std::move(other.instrumentation_)},
+#endif
+          resource_{other.resource_}, registry_{std::move(other.registry_)}, usage_examples_{std::move(other.usage_examples_)},
+          schema_{std::move(other.schema_)}, result_{std::move(other.result_)}, storage_{std::move(other.storage_)},
+          commands_{std::move(other.commands_)}, command_parsers_{std::move(other.command_parsers_)},
+          selected_command_{other.selected_command_}, borrow_argv_{other.borrow_argv_},
+          value_providers_{std::move(other.value_providers_)}, bindings_{std::move(other.bindings_)},
+          completion_values_{std::move(other.completion_values_)}, completion_{std::move(other.completion_)},
+          help_{std::move(other.help_)}, help_width_{other.help_width_}, help_valid_{other.help_valid_},
+          schema_hash_{other.schema_hash_}, empty_arg_{std::move(other.empty_arg_)}
+    {
+        // The command parsers keep their nodes, and so their addresses; only
+        // the registry has moved
+        move_schema(&other.registry_, &registry_);
+    }
+
+    void ArgParser::move_schema(const ArgSchema* from, const ArgSchema* to)
     {
-        const auto ptr{std::make_shared<Arg>(parm)};
+        if (result_.schema_ == from)
+            result_.schema_ = to;
+        std::replace(result_.outer_schemas_.begin(), result_.outer_schemas_.end(), from, to);
 
-        if (!ptr->short_name().empty()) {
-            if (const auto& p = params_map_.find(ptr->short_name()); p != params_map_.end()) {
-                if (ptr->long_name() != p->second->long_name()) {
-                    params_map_.erase(p->second->long_name());
-                    p->second = ptr;
+        for (auto& parser : command_parsers_)
+            parser.move_schema(from, to);
+    }
+
+    ArgParser& ArgParser::operator=(ArgParser&& other)
+    {
+        if (this == &other)
+            return *this;
+
+        // Handles of the args being replaced are not updated any more
+        for (const auto& binding : bindings_)
+            binding->detach();
+
+#if CLI_PARSER_INSTRUMENTATION
+        // The instrumentation is the resource of this parser and stays; only
+        // what it reports is taken over
+        if (other.instrumentation_) {
+            instrumentation_->stats = other.instrumentation_->stats;
+            instrumentation_->on_arg_parsed = std::move(other.instrumentation_->on_arg_parsed);
+            instrumentation_->on_error = std::move(other.instrumentation_->on_error);
+        }
+#endif
+
+        if (*resource_ == *other.resource_) {
+            // Everything is taken over as it is, so the command parsers keep
+            // their nodes and addresses
+            registry_ = std::move(other.registry_);
+            usage_examples_ = std::move(other.usage_examples_);
+            schema_ = std::move(other.schema_);
+            result_ = std::move(other.result_);
+            storage_ = std::move(other.storage_);
+            commands_ = std::move(other.commands_);
+            command_parsers_ = std::move(other.command_parsers_);
+            bindings_ = std::move(other.bindings_);
+            move_schema(&other.registry_, &registry_);
+        }
+        else {
+            // Everything is rebuilt in the resource of this parser, and the
+            // values copied out of the storage of other, which goes with it
+            const auto values = std::move(other.storage_);
+            storage_.reset();
+            registry_ = std::move(other.registry_);
+            usage_examples_ = std::move(other.usage_examples_);
+            invalidate();
+            result_.clear(registry_);
+            result_.outer_schemas_.clear();
+            if (values)
+                copy_values_from(*values);
+
+            command_parsers_.clear();
+            commands_ = std::move(other.commands_);
+            for (auto& command : commands_)
+                if (command.parser) {
+                    auto& parser = command_parsers_.emplace_back(resource_);
+                    parser = std::move(*command.parser);
+                    command.parser = &parser;
                 }
-            } else {
-                params_map_.insert({ptr->short_name(), ptr});
-            }
+            bindings_ = std::move(other.bindings_);
         }
 
-        if (!ptr->long_name().empty()) {
-            if (const auto& p = params_map_.find(ptr->long_name()); p != params_map_.end()) {
-                if (ptr->short_name() != p->second->short_name()) {
-                    params_map_.erase(p->second->short_name());
-                    p->second = ptr;
-                }
-            } else {
-                params_map_.insert({ptr->long_name(), ptr});
-            }
+        selected_command_ = other.selected_command_;
+        borrow_argv_ = other.borrow_argv_;
+        value_providers_ = std::move(other.value_providers_);
+        completion_values_ = std::move(other.completion_values_);
+        completion_ = std::move(other.completion_);
+        help_ = std::move(other.help_);
+        help_width_ = other.help_width_;
+        help_valid_ = other.help_valid_;
+        schema_hash_ = other.schema_hash_;
+        empty_arg_ = std::move(other.empty_arg_);
+        return *this;
+    }
+
+    void ArgParser::copy_values_from(const detail::ParseStorage& storage)
+    {
+        auto& arena = result_.storage().arena;
+        for (auto& parm : registry_.args_) {
+            if (parm.value_borrowed_ && storage.contains(parm.value_ref_.data()))
+                parm.value_ref_ = arena.store(parm.value_ref_);
+            for (auto& value : parm.values_)
+                if (storage.contains(value.data()))
+                    value = arena.store(value);
+        }
+        storage_ = result_.storage_;
+    }
+
+    std::pmr::memory_resource* ArgParser::binding_resource() const
+    {
+#if CLI_PARSER_INSTRUMENTATION
+        return instrumentation_->upstream();
+#else
+        return resource_;
+#endif
+    }
+
+    ArgParser& ArgParser::add_parameter(Arg parm)
+    {
+        constexpr auto npos = detail::NameIndex::npos;
+        const detail::PhaseTimer timer{instrumentation(), &ParseStats::registration};
+
+        const auto short_name = parm.short_name_view();
+        const auto long_name = parm.long_name_view();
+
+        if (short_name.empty() && long_name.empty())
+            return *this;
+
+        const auto by_short = short_name.empty() ? npos : registry_.index_.find(short_name, registry_.args_);
+        const auto by_long = long_name.empty() ? npos : registry_.index_.find(long_name, registry_.args_);
+
+        if (!parm.default_value_view().empty() && parm.value_view().empty())
+            parm.value(parm.default_value_view());
+
+        if (!parm.value_view().empty())
+            parm.source_ = ValueSource::default_value;
+
+        if (by_short == npos && by_long == npos) {
+            registry_.required_args_count_ += parm.is_required() ? 1 : 0;
+            if (parm.is_positional())
+                registry_.positional_args_.push_back(registry_.args_.size());
+
+            invalidate();
+            registry_.args_.push_back(std::move(parm));
+            registry_.index_.add(registry_.args_.size() - 1, registry_.args_);
+            registry_.env_.add(registry_.args_.size() - 1, registry_.args_, registry_.env_prefix_);
+
+            // Grown here rather than by the first parse
+            result_.states_.resize(registry_.args_.size());
+            return *this;
+        }
+
+        // An exact duplicate keeps the arg registered first
+        const auto& existing = registry_.args_[by_short != npos ? by_short : by_long];
+        if (existing.short_name_view() == short_name && existing.long_name_view() == long_name)
+            return *this;
+
+        // Otherwise the new arg takes the place of every arg it shares a name with
+        const auto slot = std::min(by_short, by_long);
+        const auto other = std::max(by_short, by_long);
+
+        registry_.required_args_count_ -= registry_.args_[slot].is_required() ? 1 : 0;
+        registry_.required_args_count_ += parm.is_required() ? 1 : 0;
+        registry_.args_[slot] = std::move(parm);
+
+        if (other != npos && other != slot) {
+            registry_.required_args_count_ -= registry_.args_[other].is_required() ? 1 : 0;
+            registry_.args_.erase(registry_.args_.begin() + static_cast<std::ptrdiff_t>(other));
         }
 
-        if (!ptr->default_value().empty() && ptr->value().empty())
-            ptr->value(ptr->default_value());
+        registry_.index_.rebuild(registry_.args_);
+        registry_.env_.rebuild(registry_.args_, registry_.env_prefix_);
+        registry_.index_positional_args();
+        invalidate();
 
         return *this;
     }
 
-    std::optional<std::string> ArgParser::parse(int argc, char* argv[])
+    ArgParser& ArgParser::allow_response_files(bool allow)
     {
-        return parse(strings_from_raw_args(argc, argv));
+        registry_.response_files_ = allow;
+        invalidate();
+        return *this;
     }
 
-    std::optional<std::string> ArgParser::parse(const std::vector<std::string>& args)
+    ArgParser& ArgParser::borrow_argv(bool borrow)
     {
-        std::size_t parm_count = args.size() - 1;
+        borrow_argv_ = borrow;
+        return *this;
+    }
 
-        if (parm_count < required_args_count())
-            return {"Not all required arguments are specified"};
+    ArgParser& ArgParser::add_config_file(std::string_view path, bool required)
+    {
+        registry_.config_files_.emplace_back(path, required);
+        invalidate();
+        return *this;
+    }
 
-        for (std::size_t i = 1; i < args.size(); ++i) {
-            std::string parm{args[i]};
-            ltrim(parm, '-');
-            std::string parm_name, parm_value;
+    ArgParser& ArgParser::env_prefix(std::string_view prefix)
+    {
+        registry_.env_prefix_.assign(prefix);
+        registry_.env_.rebuild(registry_.args_, registry_.env_prefix_);
+        invalidate();
+        return *this;
+    }
 
-            // check for short parm_name case
-            if (parm.size() != 1) {
-                if (!parse_key_arg(parm, parm_name, parm_value))
-                    return {"Parameter format parse error: " + std::string{parm}};
-            } else {
-                parm_name = parm;
+    ArgParser& ArgParser::add_command(std::string_view name, std::string_view description, CommandFactory factory)
+    {
+        if (name.empty() || name.front() == '-')
+            throw std::runtime_error("Command name must not be empty or start with '-'");
+
+        const detail::PhaseTimer timer{instrumentation(), &ParseStats::registration};
+
+        if (const auto index = registry_.find_command(name); index != ArgSchema::npos) {
+            // A command added again replaces the earlier one, parser included
+            auto& command = commands_[index];
+            command_parsers_.remove_if([&command](const ArgParser& parser) { return &parser == command.parser; });
+            command = {std::move(factory), nullptr};
+            registry_.commands_[index].description.assign(description);
+        } else {
+            registry_.commands_.emplace_back(name, description);
+            commands_.push_back({std::move(factory), nullptr});
+        }
+
+        invalidate();
+        return *this;
+    }
+
+    ArgParser& ArgParser::command(std::string_view name)
+    {
+        const auto index = registry_.find_command(name);
+        if (index == ArgSchema::npos)
+            throw std::runtime_error("Unknown command: " + std::string{name});
+
+        return command_parser(index);
+    }
+
+    ArgParser& ArgParser::command_parser(std::size_t index)
+    {
+        auto& command = commands_[index];
+        if (!command.parser) {
+            command.parser = &command_parsers_.emplace_back(resource_);
+            command.factory(*command.parser);
+        }
+
+        return *command.parser;
+    }
+
+    std::string_view ArgParser::selected_command() const
+    {
+        if (selected_command_ == ArgSchema::npos)
+            return {};
+
+        return registry_.commands_[selected_command_].name;
+    }
+
+    ArgParser& ArgParser::set_value_provider(std::string_view arg_name, ValueProvider provider)
+    {
+        if (registry_.find(arg_name) == ArgSchema::npos)
+            throw std::runtime_error("Unknown parameter: " + std::string{arg_name});
+
+        for (auto& entry : value_providers_)
+            if (entry.arg_name == arg_name) {
+                entry.provider = std::move(provider);
+                return *this;
             }
 
-            const auto it_arg = params_map_.find(parm_name);
-            if (it_arg != params_map_.end()) {
-                auto parg{it_arg->second};
-                if (parg->is_flag()) {
-                    parg->set_parsed(true);
+        value_providers_.push_back({std::string{arg_name}, std::move(provider)});
+        return *this;
+    }
+
+    bool ArgParser::handle_completion(int argc, char* argv[], int fd)
+    {
+        if (argc < 2 || argv == nullptr || argv[1] == nullptr || argv[1] != completion_key)
+            return false;
+
+        for (int i = 2; i < argc; ++i)
+            if (argv[i] == nullptr)
+                return true;
+
+        detail::write_all(fd, complete(argc - 2, argv + 2));
+        return true;
+    }
+
+    std::string_view ArgParser::complete(int count, const char* const words[])
+    {
+        completion_.clear();
+        complete_scope({words, nullptr, count > 0 ? static_cast<std::size_t>(count) : 0u}, 0, nullptr, completion_);
+        return completion_;
+    }
+
+    std::string_view ArgParser::complete(const std::vector<std::string>& words)
+    {
+        completion_.clear();
+        complete_scope({nullptr, words.data(), words.size()}, 0, nullptr, completion_);
+        return completion_;
+    }
+
+    std::string ArgParser::completion_script(Shell shell, std::string_view program)
+    {
+        std::string out;
+        detail::write_completion_script(out, shell, program, completion_key);
+        return out;
+    }
+
+    void ArgParser::complete_scope(const detail::CompletionWords& words, std::size_t pos, const detail::CompletionScope* outer, std::pmr::string& out)
+    {
+        constexpr auto npos = ArgSchema::npos;
+
+        const detail::CompletionScope scope{this, outer};
+        const auto last = words.count ? words.count - 1 : 0;
+        const std::string_view word = words.count ? words[last] : std::string_view{};
+
+        const auto is_option = [](std::string_view text) { return text.size() > 1 && text.front() == '-'; };
+
+        // The arg that takes the next word as its value
+        ArgParser* value_owner{};
+        std::size_t value_index{};
+        bool options_ended{false};
+        std::size_t next_positional{};
+
+        // The same walk as ArgSchema::parse_stream(), minus the values
+        for (; pos < last; ++pos) {
+            const auto text = words[pos];
+
+            if (value_owner) {
+                if (!value_owner->registry_.args_[value_index].is_multi_value()) {
+                    value_owner = nullptr;
                     continue;
                 }
 
-                // The case when the Param parm_name is given in a short form
-                // and requires its parm_value, but the parm_value is not provided
-                if (parm_value.empty()) {
-                    if (i == parm_count)
-                        return {"Expected value for the key: " + parm_name};
+                // A multi-value arg takes words up to the next option
+                if (!is_option(text))
+                    continue;
+                value_owner = nullptr;
+            }
+
+            if (!options_ended && text == "--") {
+                options_ended = true;
+                continue;
+            }
 
-                    parm_value = args[i + 1];
-                    ++i;
+            if (options_ended || !is_option(text)) {
+                if (!options_ended && !registry_.commands_.empty()) {
+                    if (const auto command = registry_.find_command(text); command != npos) {
+                        command_parser(command).complete_scope(words, pos + 1, &scope, out);
+                        return;
+                    }
                 }
 
-                parg->value(parm_value);
-                parg->set_parsed(true);
-            } else {
-                return {"An unknown parameter key is specified: " + parm};
+                const auto& positional = registry_.positional_args_;
+                if (next_positional < positional.size() && !registry_.args_[positional[next_positional]].is_repeated())
+                    ++next_positional;
+                continue;
+            }
+
+            // --name=value carries its value
+            const auto name = ltrim_view(text, '-');
+            if (name.find('=') != std::string_view::npos)
+                continue;
+
+            std::size_t index{};
+            if (auto owner = find_in_scopes(&scope, name, index); owner && !owner->registry_.args_[index].is_flag()) {
+                value_owner = owner;
+                value_index = index;
             }
         }
 
-        return check_required_args();
+        if (value_owner && !(value_owner->registry_.args_[value_index].is_multi_value() && is_option(word))) {
+            value_owner->complete_values(value_index, word, 0, out);
+            return;
+        }
+
+        if (!options_ended && !word.empty() && word.front() == '-') {
+            if (const auto equals = word.find('='); equals != std::string_view::npos) {
+                std::size_t index{};
+                auto owner = find_in_scopes(&scope, ltrim_view(word.substr(0, equals), '-'), index);
+                if (owner && !owner->registry_.args_[index].is_flag())
+                    owner->complete_values(index, word, equals + 1, out);
+                return;
+            }
+
+            for (auto current = &scope; current; current = current->outer) {
+                for (const auto& parm : current->parser->registry_.args_) {
+                    // Names an inner scope takes over are offered only once
+                    std::size_t index{};
+                    const auto short_name = parm.short_name_view();
+                    const auto long_name = parm.long_name_view();
+                    const bool shadowed = current != &scope && find_in_scopes(&scope, long_name.empty() ? short_name : long_name, index) != current->parser;
+                    if (shadowed)
+                        continue;
+
+                    detail::add_candidate(out, "--", long_name, word, parm.description_view());
+                    detail::add_candidate(out, "-", short_name, word, parm.description_view());
+                }
+            }
+            return;
+        }
+
+        if (!options_ended)
+            for (const auto& command : registry_.commands_)
+                detail::add_candidate(out, {}, command.name, word, command.description);
+
+        if (next_positional < registry_.positional_args_.size())
+            complete_values(registry_.positional_args_[next_positional], word, 0, out);
     }
 
-    void ArgParser::add_usage_string(std::string usage_string)
+    ArgParser* ArgParser::find_in_scopes(const detail::CompletionScope* scope, std::string_view name, std::size_t& index)
     {
-        usage_examples_.push_back(usage_string);
+        for (; scope; scope = scope->outer)
+            if ((index = scope->parser->registry_.find(name)) != ArgSchema::npos)
+                return scope->parser;
+
+        return nullptr;
     }
 
-    void ArgParser::print_help()
+    void ArgParser::complete_values(std::size_t index, std::string_view word, std::size_t lead, std::pmr::string& out)
     {
-        static const std::string tab(4, ' ');
+        for (const auto& entry : value_providers_) {
+            if (registry_.find(entry.arg_name) != index)
+                continue;
 
-        const auto params = all_params();
+            completion_values_.clear();
+            entry.provider(word.substr(lead), completion_values_);
 
-        for (const auto& parm : params)
-            adjust_fmt_max_field_lengths(parm);
+            for (const auto& value : completion_values_)
+                if (value.find('\n') == std::string::npos)
+                    detail::add_candidate(out, word.substr(0, lead), value, word, {});
+            return;
+        }
+    }
 
-        std::cout << "Usage: \n";
-        print_usage_examples();
+    std::optional<std::string> ArgParser::parse(int argc, char* argv[])
+    {
+        if (const auto error = try_parse(argc, argv))
+            return error.message();
+        return {};
+    }
 
-        for (const auto& parm : params) {
-            std::cout << tab << "-" << std::left << std::setw(max_short_param_name_length_) << parm->short_name() << "";
+    std::optional<std::string> ArgParser::parse(const std::vector<std::string>& args)
+    {
+        if (const auto error = try_parse(args))
+            return error.message();
+        return {};
+    }
 
-            const auto preamble{parm->long_name().empty() ? "[   "s : " [ --"s};
+    std::optional<std::string> ArgParser::parse_command_line(std::string_view command_line)
+    {
+        if (const auto error = try_parse_command_line(command_line))
+            return error.message();
+        return {};
+    }
 
-            std::cout << std::left << preamble << std::setw(max_long_param_name_length_) << parm->long_name() << " ] ";
+    ParseError ArgParser::try_parse(int argc, char* argv[])
+    {
+        if (argc < 1 || argv == nullptr)
+            return try_parse(std::vector<std::string>{});
 
-            if (!parm->description().empty())
-                std::cout << parm->description();
+        for (int i = 0; i < argc; ++i)
+            if (argv[i] == nullptr)
+                return try_parse(std::vector<std::string>{});
 
-            if (parm->is_required())
-                std::cout << " [required]";
+        detail::TokenStream tokens{argv, nullptr, static_cast<std::size_t>(argc), borrow_argv_};
+        return parse_stream(tokens);
+    }
 
-            if (!parm->default_value().empty())
-                std::cout << " (default: " << std::setw(max_default_param_value_length_) << parm->default_value() << ")";
-            else
-                std::cout << std::string(max_default_param_value_length_ + tab.size(), ' ');
+    ParseError ArgParser::try_parse(const std::vector<std::string>& args)
+    {
+        detail::TokenStream tokens{nullptr, args.data(), args.size()};
+        return parse_stream(tokens);
+    }
 
-            std::cout << "\n";
-        }
+    ParseError ArgParser::try_parse_command_line(std::string_view command_line)
+    {
+        detail::TokenStream tokens{command_line};
+        return parse_stream(tokens);
     }
 
-    const Arg& ArgParser::arg(const std::string& arg_name) const
+    std::string ArgParser::save_snapshot() const
     {
-        if (const auto& arg_it = params_map_.find(arg_name); arg_it != params_map_.end())
-            return *arg_it->second;
+        std::string out;
+        detail::write_snapshot_header(out, {detail::snapshot_version, schema_hash(), static_cast<std::uint32_t>(registry_.args_.size())});
 
-        return empty_arg_;
+        // Defaults come back with the schema; flags have no value
+        for (const auto& parm : registry_.args_) {
+            const bool has_value = parm.source() > ValueSource::default_value && !parm.is_flag();
+            detail::write_snapshot_arg(out, parm.source(), parm.is_parsed(), has_value ? parm.values() : ValueRange{});
+        }
+
+        return out;
     }
 
-    void ArgParser::reset()
+    ParseError ArgParser::load_snapshot(std::string_view snapshot)
     {
-        params_map_.clear();
-        usage_examples_.clear();
+        release_storage();
+        result_.clear(registry_);
+        return load_snapshot_storage(result_.storage().arena.store(snapshot));
+    }
+
+    ParseError ArgParser::load_snapshot_file(const std::string& path)
+    {
+        release_storage();
+        result_.clear(registry_);
+
+        // Read rather than mapped: the supervisor may rewrite or truncate the
+        // file once it has been handed over
+        auto& arena = result_.storage().arena;
+        const auto snapshot = arena.store_file(path.c_str());
+        if (!snapshot) {
+            result_.fail(ParseErrorCode::snapshot_unreadable, ParseError::npos, arena.store(path));
+            return result_.failure();
+        }
 
-        max_long_param_name_length_ = 0;
-        max_short_param_name_length_ = 0;
-        max_default_param_value_length_ = 0;
+        return load_snapshot_storage(*snapshot);
     }
 
-    const std::vector<ArgParser::ArgPtr> ArgParser::all_params() const
+    ParseError ArgParser::load_snapshot_storage(std::string_view snapshot)
     {
-        std::vector<ArgPtr> params;
-        for (const auto& [key, value] : params_map_) {
-            if (value->long_name().empty())
-                params.push_back(value);
-            else {
-                const auto& p = params_map_.find(value->long_name());
-                if (p != params_map_.end())
-                    params.push_back(value);
+#if CLI_PARSER_INSTRUMENTATION
+        result_.instrumentation_ = instrumentation_.get();
+#endif
+        selected_command_ = ArgSchema::npos;
+
+        const auto invalid = [this](std::string_view reason) {
+            result_.fail(ParseErrorCode::snapshot_invalid, ParseError::npos, {}, nullptr, reason);
+            return result_.failure();
+        };
+
+        detail::SnapshotReader reader{snapshot};
+        detail::SnapshotHeader header;
+        if (!reader.header(header))
+            return invalid("not a snapshot");
+        if (header.version != detail::snapshot_version)
+            return invalid("unsupported version");
+
+        if (header.schema_hash != schema_hash() || header.arg_count != registry_.args_.size()) {
+            result_.fail(ParseErrorCode::snapshot_mismatch, ParseError::npos);
+            return result_.failure();
+        }
+
+        for (std::size_t i = 0; i < registry_.args_.size(); ++i) {
+            auto& state = result_.states_[i];
+            ValueSource source;
+            bool is_parsed;
+            std::size_t value_count;
+            if (!reader.arg(source, is_parsed, value_count))
+                return invalid("truncated or damaged");
+
+            // The values of a repeated arg are collected as after a parse,
+            // any other arg has at most one
+            const bool repeated = registry_.args_[i].is_repeated();
+            if (value_count > 1 && !repeated)
+                return invalid("truncated or damaged");
+
+            if (repeated) {
+                state.first_value = static_cast<std::uint32_t>(result_.values_.size());
+                state.value_count = static_cast<std::uint32_t>(value_count);
             }
+
+            std::string_view value;
+            for (std::size_t v = 0; v < value_count; ++v) {
+                if (!reader.value(value))
+                    return invalid("truncated or damaged");
+                if (repeated)
+                    result_.values_.push_back(value);
+            }
+
+            if (source <= ValueSource::default_value)
+                continue;
+
+            state.source = source;
+            state.is_parsed = is_parsed;
+            state.value = value;
         }
 
-        std::sort(std::begin(params), std::end(params));
-        const auto last = std::unique(std::begin(params), std::end(params));
-        params.erase(last, params.end());
+        if (!reader.at_end())
+            return invalid("trailing data");
 
-        return params;
+        storage_ = result_.storage_;
+        apply_result(result_);
+        return assign_bindings();
     }
 
-    void ArgParser::print_usage_examples() const
+    std::shared_ptr<const ArgSchema> ArgParser::schema()
     {
-        static const std::string tab(4, ' ');
-        for (const auto& str : usage_examples_)
-            std::cout << tab << str << std::endl;
-        std::cout << std::endl;
+        if (schema_)
+            return schema_;
+
+        // Allocated from the resource the parser was given, the control block
+        // included. Not from the instrumentation: schemas outlive parsers.
+#if CLI_PARSER_INSTRUMENTATION
+        const auto resource = instrumentation_->upstream();
+#else
+        const auto resource = resource_;
+#endif
+        auto schema = std::allocate_shared<ArgSchema>(std::pmr::polymorphic_allocator<ArgSchema>{resource}, registry_);
+
+        // The schema keeps only the declarations, not the parsed state
+        for (auto& spec : schema->args_) {
+            spec.values_.clear();
+            spec.value(spec.default_value_view());
+            spec.set_parsed(false);
+            spec.source_ = spec.value_view().empty() ? ValueSource::none : ValueSource::default_value;
+        }
+
+        schema_ = std::move(schema);
+        return schema_;
     }
 
-    void ArgParser::adjust_fmt_max_field_lengths(const ArgPtr& p)
+    ParseError ArgParser::parse_stream(detail::TokenStream& tokens)
     {
-        if (p) {
-            if (p->long_name().size() > max_long_param_name_length_)
-                max_long_param_name_length_ = p->long_name().size();
-            if (p->short_name().size() > max_short_param_name_length_)
-                max_short_param_name_length_ = p->short_name().size();
-            if (p->default_value().size() > max_default_param_value_length_)
-                max_default_param_value_length_ = p->default_value().size();
+        const auto instrumentation = this->instrumentation();
+        const detail::PhaseTimer timer{instrumentation, &ParseStats::parse};
+
+        release_storage();
+        auto error = parse_scope(tokens, nullptr);
+
+        if (instrumentation) {
+            instrumentation->count_parse();
+            instrumentation->count_tokens(tokens.count());
+            if (error)
+                instrumentation->error(error);
         }
+
+        return error;
     }
 
-    std::optional<std::string> ArgParser::check_required_args() const
+    ParseError ArgParser::parse_scope(detail::TokenStream& tokens, const detail::ParseScope* outer)
     {
-        const auto params = all_params();
-        for (const auto& parm : params)
-            if (parm->is_required() && parm->value().empty())
-                return {"Expected required parameter value: " + parm->short_name() + " [" + parm->long_name() + "]"};
+#if CLI_PARSER_INSTRUMENTATION
+        // Commands report to the parser the parse started at
+        result_.instrumentation_ = outer ? outer->result->instrumentation_ : instrumentation_.get();
+#endif
 
-        return {};
+        selected_command_ = registry_.parse_stream(tokens, result_, outer);
+
+        auto error = result_.failure();
+        if (!error && selected_command_ != ArgSchema::npos) {
+            const detail::ParseScope scope{&registry_, &result_, outer};
+            error = command_parser(selected_command_).parse_scope(tokens, &scope);
+        }
+
+        // Only now, as the command may have set args of this parser
+        result_.collect_values();
+        storage_ = result_.storage_;
+
+        apply_result(result_);
+
+        if (error)
+            return error;
+
+        if ((error = assign_bindings()))
+            return error;
+
+        // Checked against the args themselves, where values persist from
+        // earlier parses
+        return check_required_args();
+    }
+
+    void ArgParser::apply_result(const ParseResult& result)
+    {
+        for (std::size_t i = 0; i < registry_.args_.size(); ++i) {
+            auto& parm = registry_.args_[i];
+            const auto& state = result.states_[i];
+
+            if (state.source <= ValueSource::default_value) {
+                // Repeated args collect their values afresh on every parse;
+                // the others keep values from earlier parses
+                if (parm.is_repeated()) {
+                    parm.values_.clear();
+                    parm.value_.assign(parm.default_value_view());
+                    parm.value_borrowed_ = false;
+                    parm.set_parsed(false);
+                    parm.source_ = state.source;
+                }
+                continue;
+            }
+
+            parm.set_parsed(state.is_parsed);
+            parm.source_ = state.source;
+
+            if (!parm.is_flag()) {
+                parm.borrow_value(state.value);
+
+                if (parm.is_repeated()) {
+                    const auto first = result.values_.begin() + state.first_value;
+                    parm.values_.assign(first, first + state.value_count);
+                }
+            }
+
+            if (const auto instrumentation = result.instrumentation())
+                instrumentation->arg_parsed(parm);
+        }
+    }
+
+    void ArgParser::release_storage()
+    {
+        // Commands share the storage of the outermost parse, which is only
+        // reused once nothing refers to it
+        for (auto& command : commands_)
+            if (command.parser) {
+                command.parser->release_storage();
+                command.parser->result_.storage_.reset();
+            }
+
+        if (!storage_)
+            return;
+
+        // Values left over from the previous parse must not point into the
+        // files and tokens about to be released
+        for (auto& parm : registry_.args_) {
+            if (parm.value_borrowed_ && storage_->contains(parm.value_ref_.data())) {
+                parm.value_.assign(parm.value_ref_);
+                parm.value_borrowed_ = false;
+            }
+
+            // Only the last value is kept of a repeated arg that a command
+            // not selected again will not refresh
+            const auto released = [this](std::string_view value) { return storage_->contains(value.data()); };
+            if (std::any_of(parm.values_.begin(), parm.values_.end(), released))
+                parm.values_.clear();
+        }
+
+        storage_.reset();
+    }
+
+    ArgSchema::ArgSchema(const allocator_type& alloc)
+        : args_{alloc}, index_{alloc}, positional_args_{alloc}, config_files_{alloc}, env_{alloc}, env_prefix_{alloc},
+          commands_{alloc}
+    {
+    }
+
+    ArgSchema::ArgSchema(const ArgSchema& other, const allocator_type& alloc)
+        : args_{other.args_, alloc}, index_{other.index_, alloc}, positional_args_{other.positional_args_, alloc},
+          required_args_count_{other.required_args_count_}, config_files_{other.config_files_, alloc},
+          env_{other.env_, alloc}, env_prefix_{other.env_prefix_, alloc}, commands_{other.commands_, alloc},
+          response_files_{other.response_files_}
+    {
+    }
+
+    void ArgSchema::index_positional_args()
+    {
+        positional_args_.clear();
+
+        for (std::size_t i = 0; i < args_.size(); ++i)
+            if (args_[i].is_positional())
+                positional_args_.push_back(i);
+    }
+
+    ParseResult ArgSchema::parse(int argc, char* argv[]) const
+    {
+        ParseResult result;
+        parse(argc, argv, result);
+        return result;
+    }
+
+    ParseResult ArgSchema::parse(const std::vector<std::string>& args) const
+    {
+        ParseResult result;
+        parse(args, result);
+        return result;
+    }
+
+    void ArgSchema::parse(int argc, char* argv[], ParseResult& result) const
+    {
+        if (argc < 1 || argv == nullptr)
+            return parse(std::vector<std::string>{}, result);
+
+        for (int i = 0; i < argc; ++i)
+            if (argv[i] == nullptr)
+                return parse(std::vector<std::string>{}, result);
+
+        detail::TokenStream tokens{argv, nullptr, static_cast<std::size_t>(argc), true};
+        parse_tokens(tokens, result);
+    }
+
+    void ArgSchema::parse(const std::vector<std::string>& args, ParseResult& result) const
+    {
+        detail::TokenStream tokens{nullptr, args.data(), args.size()};
+        parse_tokens(tokens, result);
+    }
+
+    ParseResult ArgSchema::parse_command_line(std::string_view command_line) const
+    {
+        ParseResult result;
+        parse_command_line(command_line, result);
+        return result;
+    }
+
+    void ArgSchema::parse_command_line(std::string_view command_line, ParseResult& result) const
+    {
+        detail::TokenStream tokens{command_line};
+        parse_tokens(tokens, result);
+    }
+
+    std::vector<std::string_view> ArgSchema::config_files() const
+    {
+        std::vector<std::string_view> paths;
+        paths.reserve(config_files_.size());
+        for (const auto& config : config_files_)
+            paths.emplace_back(config.path);
+        return paths;
+    }
+
+    std::uint64_t ArgSchema::hash() const
+    {
+        // FNV-1a over sized fields, so that no two lists of args run together
+        std::uint64_t hash = 14695981039346656037ull;
+        const auto add_bytes = [&hash](std::string_view bytes) {
+            for (const char ch : bytes) {
+                hash ^= static_cast<unsigned char>(ch);
+                hash *= 1099511628211ull;
+            }
+        };
+        const auto add_number = [&add_bytes](std::uint64_t number) {
+            char bytes[8];
+            for (std::size_t i = 0; i < sizeof bytes; ++i)
+                bytes[i] = static_cast<char>((number >> (8 * i)) & 0xff);
+            add_bytes({bytes, sizeof bytes});
+        };
+        const auto add_field = [&add_bytes, &add_number](std::string_view field) {
+            add_number(field.size());
+            add_bytes(field);
+        };
+
+        add_number(args_.size());
+        add_field(env_prefix_);
+        for (const auto& arg : args_) {
+            add_field(arg.short_name_view());
+            add_field(arg.long_name_view());
+            add_field(arg.default_value_view());
+            add_field(arg.env_view());
+            add_number(static_cast<std::uint64_t>(arg.is_required()) | arg.is_flag() << 1 | arg.is_repeated() << 2 |
+                arg.is_multi_value() << 3 | arg.is_positional() << 4);
+        }
+
+        return hash;
+    }
+
+    void ArgSchema::parse_tokens(detail::TokenStream& tokens, ParseResult& result) const
+    {
+        try {
+            parse_stream(tokens, result);
+            result.collect_values();
+
+            if (result.ok())
+                check_required_args(result);
+        } catch (const std::bad_alloc&) {
+            if (!result.fixed_)
+                throw;
+
+            result.fail(ParseErrorCode::capacity_exceeded, ParseError::npos);
+        }
+    }
+
+    std::size_t ArgSchema::parse_stream(detail::TokenStream& tokens, ParseResult& result, const detail::ParseScope* outer) const
+    {
+        result.clear(*this);
+
+        if (outer) {
+            // Tokens and copied values all live in the storage of the
+            // outermost parse
+            auto root = outer;
+            while (root->outer)
+                root = root->outer;
+
+            root->result->storage();
+            result.storage_ = root->result->storage_;
+        }
+
+        const auto instrumentation = result.instrumentation();
+
+        {
+            const detail::PhaseTimer timer{instrumentation, &ParseStats::config_files};
+            if (!load_config_files(result))
+                return npos;
+        }
+
+        if (!env_.empty()) {
+            const detail::PhaseTimer timer{instrumentation, &ParseStats::environment};
+            if (!load_environment(result))
+                return npos;
+        }
+
+        // Response and config files and the environment may supply required args too
+        if (const auto count = tokens.argument_count(); count && !outer && !response_files_ && config_files_.empty() && env_.empty()) {
+            std::size_t parm_count = *count - 1;
+
+            if (parm_count < required_args_count_) {
+                result.fail(ParseErrorCode::missing_required, ParseError::npos);
+                return npos;
+            }
+        }
+
+        if (!outer)
+            tokens.use_storage(result.storage_, result.resource(), response_files_);
+
+        detail::TokenStream::Token token;
+
+        const auto next = [&tokens, instrumentation](detail::TokenStream::Token& token) {
+            const detail::PhaseTimer timer{instrumentation, &ParseStats::tokenization};
+            return tokens.next(token);
+        };
+
+        // Skip the program name, or the name of the command being parsed
+        if (!next(token))
+            return npos;
+
+        const auto is_option = [](std::string_view text) { return text.size() > 1 && text.front() == '-'; };
+
+        bool options_ended{false};
+        std::size_t next_positional{};
+
+        while (next(token)) {
+            if (!options_ended && token.text == "--") {
+                options_ended = true;
+                continue;
+            }
+
+            if (!options_ended && !commands_.empty() && !is_option(token.text)) {
+                if (const auto command = find_command(token.text); command != npos) {
+                    result.command_ = command;
+                    result.command_position_ = tokens.position();
+
+                    // The command's parse starts with its name
+                    tokens.put_back(token);
+                    return command;
+                }
+            }
+
+            // Tokens without a leading '-' fill the positional args first and
+            // only then fall back to the key=value form
+            if (options_ended || !is_option(token.text)) {
+                if (next_positional < positional_args_.size()) {
+                    const auto index = positional_args_[next_positional];
+                    set_value(result, index, token.text, token.stable, ValueSource::command_line);
+                    if (!args_[index].is_repeated())
+                        ++next_positional;
+                    continue;
+                }
+
+                if (options_ended) {
+                    result.fail(ParseErrorCode::unexpected_positional, tokens.position(), token.text);
+                    return npos;
+                }
+            }
+
+            const std::string_view parm{ltrim_view(token.text, '-')};
+            std::string_view parm_name, parm_value;
+
+            // check for short parm_name case
+            if (parm.size() != 1) {
+                if (!parse_key_arg(parm, parm_name, parm_value)) {
+                    result.fail(ParseErrorCode::invalid_format, tokens.position(), parm);
+                    return npos;
+                }
+            } else {
+                parm_name = parm;
+            }
+
+            // The args of enclosing parsers are accepted after their commands
+            const ArgSchema* owner = this;
+            ParseResult* target = &result;
+            std::size_t index;
+            {
+                const detail::PhaseTimer timer{instrumentation, &ParseStats::lookup};
+                if (instrumentation)
+                    instrumentation->count_lookup();
+
+                index = index_.find(parm_name, args_);
+                for (auto scope = outer; index == npos && scope; scope = scope->outer) {
+                    owner = scope->schema;
+                    target = scope->result;
+                    index = owner->find(parm_name);
+                }
+            }
+
+            if (index == npos) {
+                // Names are suggested from these when the message is asked for
+                result.outer_schemas_.clear();
+                for (auto scope = outer; scope; scope = scope->outer)
+                    result.outer_schemas_.push_back(scope->schema);
+
+                result.fail(ParseErrorCode::unknown_key, tokens.position(), parm);
+                return npos;
+            }
+
+            const auto& parg{owner->args_[index]};
+            const auto key_position = tokens.position();
+            if (parg.is_flag()) {
+                auto& state = target->states_[index];
+                state.is_parsed = true;
+                state.source = ValueSource::command_line;
+                continue;
+            }
+
+            if (parg.is_multi_value()) {
+                std::size_t value_count{};
+                if (!parm_value.empty()) {
+                    owner->set_value(*target, index, parm_value, token.stable, ValueSource::command_line);
+                    ++value_count;
+                }
+
+                while (next(token)) {
+                    if (is_option(token.text)) {
+                        tokens.put_back(token);
+                        break;
+                    }
+
+                    owner->set_value(*target, index, token.text, token.stable, ValueSource::command_line);
+                    ++value_count;
+                }
+
+                if (tokens.failed())
+                    break;
+
+                if (value_count == 0) {
+                    result.fail(ParseErrorCode::missing_value, key_position, parm_name, &parg);
+                    return npos;
+                }
+                continue;
+            }
+
+            // The case when the Param parm_name is given in a short form
+            // and requires its parm_value, but the parm_value is not provided
+            if (parm_value.empty()) {
+                if (!next(token)) {
+                    if (!tokens.failed())
+                        result.fail(ParseErrorCode::missing_value, key_position, parm_name, &parg);
+                    break;
+                }
+
+                parm_value = token.text;
+            }
+
+            owner->set_value(*target, index, parm_value, token.stable, ValueSource::command_line);
+        }
+
+        if (tokens.failed())
+            result.fail(tokens.error(), tokens.count(), tokens.error_subject());
+
+        return npos;
+    }
+
+    std::string ArgSchema::suggest(std::string_view name, const detail::ParseScope* outer, bool with_dashes) const
+    {
+        detail::NameSuggester suggester{name};
+        suggester.add(args_);
+        for (auto scope = outer; scope; scope = scope->outer)
+            suggester.add(scope->schema->args_);
+
+        const auto message = suggester.message(with_dashes);
+        return message.empty() ? message : ". " + message;
+    }
+
+    std::size_t ArgSchema::find_command(std::string_view name) const
+    {
+        for (std::size_t i = 0; i < commands_.size(); ++i)
+            if (commands_[i].name == name)
+                return i;
+
+        return npos;
+    }
+
+    bool ArgSchema::load_config_files(ParseResult& result) const
+    {
+        if (config_files_.empty())
+            return true;
+
+        detail::ConfigReader reader{result.resource()};
+
+        for (const auto& config : config_files_) {
+            // Read into storage rather than mapped, so that values do not
+            // change when the file is edited after the parse
+            const auto contents = result.storage().arena.store_file(config.path.c_str());
+            if (!contents) {
+                if (!config.required)
+                    continue;
+                result.fail(ParseErrorCode::config_file_unreadable, ParseError::npos, config.path);
+                return false;
+            }
+
+            const auto error = reader.read(*contents, [this, &result](const detail::ConfigEntry& entry) -> std::optional<std::string> {
+                const auto index = index_.find(entry.key, args_);
+                if (index == npos)
+                    return {"unknown key " + std::string{entry.key} + suggest(entry.key, nullptr, false)};
+
+                if (!args_[index].is_flag()) {
+                    // Escaped values live in the reader's scratch buffer
+                    set_value(result, index, entry.value, !entry.is_scratch, ValueSource::config_file);
+                    return {};
+                }
+
+                const auto enabled = parse_bool(entry.value);
+                if (!enabled)
+                    return {"expected a boolean for the flag " + std::string{entry.key}};
+
+                auto& state = result.states_[index];
+                state.is_parsed = enabled.value;
+                state.source = ValueSource::config_file;
+                return {};
+            });
+
+            if (error) {
+                result.fail(ParseErrorCode::config_file_invalid, ParseError::npos, config.path, nullptr, *error);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool ArgSchema::load_environment(ParseResult& result) const
+    {
+        const auto environment = detail::environment();
+        if (!environment)
+            return true;
+
+        for (auto entry = environment; *entry; ++entry) {
+            const std::string_view variable{*entry};
+
+            // Windows keeps the current directory of each drive in "=C:=..."
+            const auto equal = variable.find('=');
+            if (equal == 0 || equal == std::string_view::npos)
+                continue;
+
+            const auto name = variable.substr(0, equal);
+            const auto index = env_.find(name);
+            if (index == npos)
+                continue;
+
+            const auto value = variable.substr(equal + 1);
+            if (value.empty())
+                continue;
+
+            if (!args_[index].is_flag()) {
+                // Copied, as the environment may change after the parse
+                set_value(result, index, value, false, ValueSource::environment);
+                continue;
+            }
+
+            const auto enabled = parse_bool(value);
+            if (!enabled) {
+                result.fail(ParseErrorCode::environment_invalid, ParseError::npos, result.storage().arena.store(name), &args_[index], "expected a boolean");
+                return false;
+            }
+
+            auto& state = result.states_[index];
+            state.is_parsed = enabled.value;
+            state.source = ValueSource::environment;
+        }
+
+        return true;
+    }
+
+    void ArgSchema::set_value(ParseResult& result, std::size_t index, std::string_view value, bool stable, ValueSource source) const
+    {
+        if (!stable)
+            value = result.storage().arena.store(value);
+
+        auto& state = result.states_[index];
+        state.value = value;
+        state.is_parsed = true;
+        state.source = source;
+
+        if (args_[index].is_repeated())
+            result.collected_.push_back({static_cast<std::uint32_t>(index), source, value});
+    }
+
+    bool ArgSchema::check_required_args(ParseResult& result) const
+    {
+        if (required_args_count_ == 0)
+            return true;
+
+        for (std::size_t i = 0; i < args_.size(); ++i) {
+            const auto& parm = args_[i];
+            if (parm.is_required() && result.states_[i].value.empty()) {
+                result.fail(ParseErrorCode::missing_required, ParseError::npos, {}, &parm);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    namespace {
+        // The size class of a block: the exponent of its power-of-two size,
+        // or the number of bits of std::size_t for a size none has
+        std::size_t size_class(std::size_t bytes)
+        {
+            constexpr std::size_t bits = std::numeric_limits<std::size_t>::digits;
+            std::size_t index = 0;
+            while (index < bits && (std::size_t{1} << index) < bytes)
+                ++index;
+            return index;
+        }
+    }
+
+    FixedBufferResource::FixedBufferResource(void* buffer, std::size_t size)
+        : begin_{static_cast<unsigned char*>(buffer)}, next_{begin_}, end_{begin_ + size}
+    {
+    }
+
+    void* FixedBufferResource::do_allocate(std::size_t bytes, std::size_t alignment)
+    {
+        const auto index = size_class(std::max({bytes, alignment, min_block_size}));
+        if (index >= size_classes)
+            throw std::bad_alloc{};
+
+        // A freed block may have been carved for less alignment than asked
+        // for now, which every block has up to that of std::max_align_t
+        for (auto** link = &free_[index]; *link; link = &(*link)->next)
+            if (reinterpret_cast<std::uintptr_t>(*link) % alignment == 0) {
+                auto* block = *link;
+                *link = block->next;
+                return block;
+            }
+
+        // Every block size is a multiple of the alignment of std::max_align_t
+        const auto block_size = std::size_t{1} << index;
+        const auto block_alignment = std::max(alignment, min_block_size);
+        void* ptr = next_;
+        auto space = static_cast<std::size_t>(end_ - next_);
+        if (!std::align(block_alignment, block_size, ptr, space))
+            throw std::bad_alloc{};
+
+        next_ = static_cast<unsigned char*>(ptr) + block_size;
+        return ptr;
+    }
+
+    void FixedBufferResource::do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+    {
+        const auto index = size_class(std::max({bytes, alignment, min_block_size}));
+        free_[index] = ::new (ptr) FreeBlock{free_[index]};
+    }
+
+    ParsedArg ParseResult::arg(std::string_view name) const
+    {
+        const auto index = schema_ ? schema_->find(name) : ArgSchema::npos;
+        if (index == ArgSchema::npos) {
+            static const Arg empty_arg{};
+            return {empty_arg, {}, {}, false, ValueSource::none};
+        }
+
+        return (*this)[index];
+    }
+
+    ParsedArg ParseResult::operator[](std::size_t index) const
+    {
+        const auto& spec = schema_->all_params()[index];
+        const auto& state = states_[index];
+
+        const auto values = spec.is_repeated() && state.value_count != 0
+            ? ValueRange{values_.data() + state.first_value, state.value_count}
+            : ValueRange{state.value};
+
+        return {spec, state.value, values, state.is_parsed, state.source};
+    }
+
+    void ParseResult::clear(const ArgSchema& schema)
+    {
+        schema_ = &schema;
+        states_.resize(schema.parameters_count());
+
+        for (std::size_t i = 0; i < states_.size(); ++i) {
+            const auto& spec = schema.all_params()[i];
+            states_[i] = State{};
+            states_[i].value = spec.default_value_view();
+            states_[i].source = spec.default_value_view().empty() ? ValueSource::none : ValueSource::default_value;
+        }
+
+        collected_.clear();
+        values_.clear();
+        error_ = {};
+        error_formatted_ = false;
+        command_ = ArgSchema::npos;
+        command_position_ = 0;
+
+        // Storage nobody else refers to is kept for the next parse
+        if (storage_ && storage_.use_count() == 1)
+            storage_->clear();
+        else
+            storage_.reset();
+    }
+
+    namespace {
+        constexpr std::size_t max_error_parts = 6;
+
+        // The pieces of the message of error, in order; the first one says
+        // what went wrong on its own
+        std::size_t error_parts(const ParseError& error, std::string_view (&parts)[max_error_parts])
+        {
+            const auto with_subject = [&error, &parts](std::string_view what) -> std::size_t {
+                parts[0] = what;
+                parts[1] = ": ";
+                parts[2] = error.subject();
+                return 3;
+            };
+
+            switch (error.code()) {
+            case ParseErrorCode::none:
+                return 0;
+            case ParseErrorCode::unknown_key:
+                return with_subject("An unknown parameter key is specified");
+            case ParseErrorCode::missing_value:
+                return with_subject("Expected value for the key");
+            case ParseErrorCode::missing_required:
+                if (!error.arg()) {
+                    parts[0] = "Not all required arguments are specified";
+                    return 1;
+                }
+                parts[0] = "Expected required parameter value";
+                parts[1] = ": ";
+                parts[2] = error.arg()->short_name_view();
+                parts[3] = " [";
+                parts[4] = error.arg()->long_name_view();
+                parts[5] = "]";
+                return 6;
+            case ParseErrorCode::unexpected_positional:
+                return with_subject("Unexpected positional argument");
+            case ParseErrorCode::invalid_format:
+                return with_subject("Parameter format parse error");
+            case ParseErrorCode::invalid_value:
+                with_subject("Invalid value for the key");
+                parts[3] = " (";
+                parts[4] = error.detail();
+                parts[5] = ")";
+                return 6;
+            case ParseErrorCode::unterminated_quote:
+                if (error.subject().empty()) {
+                    parts[0] = "Unterminated quote in command line";
+                    return 1;
+                }
+                return with_subject("Unterminated quote in response file");
+            case ParseErrorCode::response_file_nesting:
+                return with_subject("Response files are nested too deeply");
+            case ParseErrorCode::response_file_unreadable:
+                return with_subject("Unable to open response file");
+            case ParseErrorCode::config_file_unreadable:
+                return with_subject("Unable to open config file");
+            case ParseErrorCode::config_file_invalid:
+                with_subject("Config file error");
+                parts[3] = ": ";
+                parts[4] = error.detail();
+                return 5;
+            case ParseErrorCode::environment_invalid:
+                with_subject("Environment variable error");
+                parts[3] = ": ";
+                parts[4] = error.detail();
+                return 5;
+            case ParseErrorCode::snapshot_unreadable:
+                return with_subject("Unable to open snapshot file");
+            case ParseErrorCode::snapshot_invalid:
+                parts[0] = "Invalid snapshot";
+                parts[1] = ": ";
+                parts[2] = error.detail();
+                return 3;
+            case ParseErrorCode::snapshot_mismatch:
+                parts[0] = "Snapshot of a parser with different args";
+                return 1;
+            case ParseErrorCode::capacity_exceeded:
+                parts[0] = "Parse capacity exceeded";
+                return 1;
+            }
+
+            return 0;
+        }
+    }
+
+    void ParseResult::fail(ParseErrorCode code, std::size_t token, std::string_view subject, const Arg* arg)
+    {
+        error_ = {code, token, subject, arg};
+        error_formatted_ = false;
+    }
+
+    void ParseResult::fail(ParseErrorCode code, std::size_t token, std::string_view subject, const Arg* arg, std::string_view detail)
+    {
+        error_detail_.assign(detail);
+        fail(code, token, subject, arg);
+        error_.detail_ = error_detail_;
+    }
+
+    std::optional<std::string_view> ParseResult::error() const
+    {
+        if (!error_)
+            return {};
+
+        std::string_view parts[max_error_parts];
+        const auto count = error_parts(error_, parts);
+        if (count == 1 && error_.code() != ParseErrorCode::unknown_key)
+            return parts[0];
+
+        if (!error_formatted_) {
+            try {
+                error_text_.clear();
+                for (std::size_t i = 0; i < count; ++i)
+                    error_text_.append(parts[i]);
+                if (error_.code() == ParseErrorCode::unknown_key)
+                    error_text_.append(suggestion(error_.subject()));
+            } catch (const std::bad_alloc&) {
+                // A full fixed buffer still tells what went wrong
+                if (!fixed_)
+                    throw;
+                return parts[0];
+            }
+            error_formatted_ = true;
+        }
+
+        return std::string_view{error_text_};
+    }
+
+    std::string ParseResult::suggestion(std::string_view name) const
+    {
+        // Built on the heap, which fixed results avoid
+        if (fixed_ || !schema_)
+            return {};
+
+        // Only the name of a --name=value key
+        name = detail::rtrim_copy(name.substr(0, name.find('=')), " ");
+
+        detail::NameSuggester suggester{name};
+        suggester.add(schema_->args_);
+        for (const auto schema : outer_schemas_)
+            suggester.add(schema->args_);
+
+        const auto message = suggester.message(true);
+        return message.empty() ? message : ". " + message;
+    }
+
+    std::string ParseError::message() const
+    {
+        std::string_view parts[max_error_parts];
+        const auto count = error_parts(*this, parts);
+
+        std::string message;
+        for (std::size_t i = 0; i < count; ++i)
+            message.append(parts[i]);
+
+        if (code_ == ParseErrorCode::unknown_key && origin_)
+            message.append(origin_->suggestion(subject_));
+
+        return message;
+    }
+
+    std::string_view ParseResult::command() const
+    {
+        if (!schema_ || command_ == ArgSchema::npos)
+            return {};
+
+        return schema_->commands_[command_].name;
+    }
+
+    void ParseResult::collect_values()
+    {
+        if (collected_.empty())
+            return;
+
+        // Values from a lower-precedence source than the last one were replaced
+        std::size_t kept{};
+        for (const auto& value : collected_) {
+            auto& state = states_[value.index];
+            if (value.source == state.source) {
+                ++state.value_count;
+                ++kept;
+            }
+        }
+
+        // Counting sort by arg, keeping the order within each arg
+        std::uint32_t end{};
+        for (auto& state : states_) {
+            end += state.value_count;
+            state.first_value = end;
+        }
+
+        values_.resize(kept);
+        for (auto it = collected_.rbegin(); it != collected_.rend(); ++it) {
+            auto& state = states_[it->index];
+            if (it->source == state.source)
+                values_[--state.first_value] = it->value;
+        }
+    }
+
+    detail::ParseStorage& ParseResult::storage()
+    {
+        if (!storage_)
+            storage_ = detail::make_parse_storage(resource());
+
+        return *storage_;
+    }
+
+    void ArgParser::add_usage_string(std::string_view usage_string)
+    {
+        usage_examples_.emplace_back(usage_string);
+        help_valid_ = false;
+    }
+
+    std::string_view ArgParser::help_text(std::size_t width)
+    {
+        if (!help_valid_ || help_width_ != width) {
+            const detail::PhaseTimer timer{instrumentation(), &ParseStats::help};
+            help_.clear();
+            detail::format_help(help_, registry_.args_, registry_.commands_, usage_examples_, width ? width : detail::terminal_width());
+            help_width_ = width;
+            help_valid_ = true;
+        }
+
+        return help_;
+    }
+
+    void ArgParser::print_help()
+    {
+        print_help(std::cout);
+    }
+
+    void ArgParser::print_help(std::ostream& out, std::size_t width)
+    {
+        const auto text = help_text(width);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    bool ArgParser::print_help(int fd, std::size_t width)
+    {
+        return detail::write_all(fd, help_text(width));
+    }
+
+    const Arg& ArgParser::arg(std::string_view arg_name) const
+    {
+        if (const auto index = registry_.index_.find(arg_name, registry_.args_); index != detail::NameIndex::npos)
+            return registry_.args_[index];
+
+        return empty_arg_;
+    }
+
+    void ArgParser::reset()
+    {
+        registry_.args_.clear();
+        registry_.index_.clear();
+        registry_.env_.clear();
+        registry_.env_prefix_.clear();
+        registry_.positional_args_.clear();
+        registry_.required_args_count_ = 0;
+        usage_examples_.clear();
+        registry_.config_files_.clear();
+        registry_.commands_.clear();
+        release_storage();
+        commands_.clear();
+        command_parsers_.clear();
+        selected_command_ = ArgSchema::npos;
+        value_providers_.clear();
+        // Handles share the bindings, which stop being updated
+        for (const auto& binding : bindings_)
+            binding->detach();
+        bindings_.clear();
+        invalidate();
+    }
+
+    ArgParser& ArgParser::on_arg_parsed(ArgHook hook)
+    {
+#if CLI_PARSER_INSTRUMENTATION
+        instrumentation_->on_arg_parsed = std::move(hook);
+#else
+        static_cast<void>(hook);
+#endif
+        return *this;
+    }
+
+    ArgParser& ArgParser::on_error(ErrorHook hook)
+    {
+#if CLI_PARSER_INSTRUMENTATION
+        instrumentation_->on_error = std::move(hook);
+#else
+        static_cast<void>(hook);
+#endif
+        return *this;
+    }
+
+    const ParseStats& ArgParser::stats() const
+    {
+#if CLI_PARSER_INSTRUMENTATION
+        return instrumentation_->stats;
+#else
+        static const ParseStats none{};
+        return none;
+#endif
+    }
+
+    void ArgParser::reset_stats()
+    {
+#if CLI_PARSER_INSTRUMENTATION
+        instrumentation_->stats = {};
+#endif
+    }
+
+    void ArgParser::invalidate()
+    {
+        schema_.reset();
+        schema_hash_.reset();
+        help_valid_ = false;
+    }
+
+    std::uint64_t ArgParser::schema_hash() const
+    {
+        if (!schema_hash_)
+            schema_hash_ = registry_.hash();
+        return *schema_hash_;
+    }
+
+    void ArgParser::add_binding(std::shared_ptr<detail::Binding> binding)
+    {
+        const auto index = registry_.find(binding->arg_name());
+        if (index == ArgSchema::npos)
+            throw std::runtime_error("Command line parameter must have name");
+
+        if (const auto error = binding->assign(registry_.args_[index]))
+            throw std::runtime_error("Invalid default value for the key: " + binding->arg_name() + " (" + *error + ")");
+
+        bindings_.push_back(std::move(binding));
+    }
+
+    ParseError ArgParser::assign_bindings()
+    {
+        const detail::PhaseTimer timer{instrumentation(), &ParseStats::conversion};
+
+        for (const auto& binding : bindings_) {
+            // An arg replaced by one without its name no longer updates the handle
+            const auto index = registry_.find(binding->arg_name());
+            if (index == ArgSchema::npos)
+                continue;
+
+            // The binding keeps its name, the result a copy of the reason
+            if (const auto error = binding->assign(registry_.args_[index])) {
+                result_.fail(ParseErrorCode::invalid_value, ParseError::npos, binding->arg_name(), &registry_.args_[index], *error);
+                return result_.failure();
+            }
+        }
+
+        return {};
+    }
+
+    ParseError ArgParser::check_required_args() const
+    {
+        const detail::PhaseTimer timer{instrumentation(), &ParseStats::required_check};
+
+        if (registry_.required_args_count_ == 0)
+            return {};
+
+        for (const auto& parm : registry_.args_)
+            if (parm.is_required() && parm.value_view().empty())
+                return {ParseErrorCode::missing_required, ParseError::npos, {}, &parm};
+
+        return {};
+    }
+
+    namespace detail {
+        namespace {
+            std::size_t name_hash(std::string_view name)
+            {
+                return std::hash<std::string_view>{}(name);
+            }
+
+            std::string_view name_of(std::uint32_t ref, const std::pmr::vector<Arg>& args)
+            {
+                const auto& arg = args[(ref - 1) >> 1];
+                return ((ref - 1) & 1) ? arg.long_name_view() : arg.short_name_view();
+            }
+        }
+
+        std::size_t NameIndex::find(std::string_view name, const std::pmr::vector<Arg>& args) const
+        {
+            if (slots_.empty())
+                return npos;
+
+            const auto hash = name_hash(name);
+            const auto mask = slots_.size() - 1;
+
+            for (auto pos = hash & mask;; pos = (pos + 1) & mask) {
+                const auto& slot = slots_[pos];
+                if (slot.ref == 0)
+                    return npos;
+                if (slot.hash == static_cast<std::uint32_t>(hash) && name_of(slot.ref, args) == name)
+                    return (slot.ref - 1) >> 1;
+            }
+        }
+
+        void NameIndex::add(std::size_t index, const std::pmr::vector<Arg>& args)
+        {
+            // Keep the load factor at or below one half
+            if ((size_ + 2) * 2 > slots_.size()) {
+                rebuild(args);
+                return;
+            }
+
+            const auto& arg = args[index];
+            const auto ref = static_cast<std::uint32_t>(index << 1) + 1;
+
+            if (!arg.short_name_view().empty())
+                insert(arg.short_name_view(), ref);
+            if (!arg.long_name_view().empty())
+                insert(arg.long_name_view(), ref + 1);
+        }
+
+        void NameIndex::rebuild(const std::pmr::vector<Arg>& args)
+        {
+            std::size_t capacity = 16;
+            while (capacity < args.size() * 4)
+                capacity *= 2;
+
+            slots_.assign(capacity, Slot{});
+            size_ = 0;
+
+            for (std::size_t i = 0; i < args.size(); ++i) {
+                const auto ref = static_cast<std::uint32_t>(i << 1) + 1;
+                if (!args[i].short_name_view().empty())
+                    insert(args[i].short_name_view(), ref);
+                if (!args[i].long_name_view().empty())
+                    insert(args[i].long_name_view(), ref + 1);
+            }
+        }
+
+        void NameIndex::clear()
+        {
+            slots_.clear();
+            size_ = 0;
+        }
+
+        void NameIndex::insert(std::string_view name, std::uint32_t ref)
+        {
+            const auto hash = name_hash(name);
+            const auto mask = slots_.size() - 1;
+
+            auto pos = hash & mask;
+            while (slots_[pos].ref != 0)
+                pos = (pos + 1) & mask;
+
+            slots_[pos] = Slot{static_cast<std::uint32_t>(hash), ref};
+            ++size_;
+        }
+
+        std::size_t EnvIndex::find(std::string_view name) const
+        {
+            if (slots_.empty())
+                return npos;
+
+            const auto hash = static_cast<std::uint32_t>(name_hash(name));
+            const auto mask = slots_.size() - 1;
+
+            for (auto pos = hash & mask;; pos = (pos + 1) & mask) {
+                const auto slot = slots_[pos];
+                if (slot == 0)
+                    return npos;
+
+                const auto& entry = entries_[slot - 1];
+                if (entry.hash == hash && name_of(entry) == name)
+                    return entry.index;
+            }
+        }
+
+        void EnvIndex::add(std::size_t index, const std::pmr::vector<Arg>& args, std::string_view prefix)
+        {
+            const auto& arg = args[index];
+            const auto offset = names_.size();
+
+            if (!arg.env_view().empty()) {
+                names_.append(arg.env_view());
+            } else if (!prefix.empty() && !arg.long_name_view().empty()) {
+                names_.append(prefix);
+                for (const char ch : arg.long_name_view()) {
+                    if (ch == '-' || ch == '.')
+                        names_.push_back('_');
+                    else
+                        names_.push_back(ch >= 'a' && ch <= 'z' ? static_cast<char>(ch - 'a' + 'A') : ch);
+                }
+            } else {
+                return;
+            }
+
+            const auto name = std::string_view{names_}.substr(offset);
+            entries_.push_back({static_cast<std::uint32_t>(name_hash(name)), static_cast<std::uint32_t>(index),
+                static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(name.size())});
+
+            // Keep the load factor at or below one half
+            if (entries_.size() * 2 <= slots_.size()) {
+                insert(entries_.size() - 1, name);
+                return;
+            }
+
+            std::size_t capacity = 16;
+            while (capacity < entries_.size() * 4)
+                capacity *= 2;
+
+            slots_.assign(capacity, 0);
+            for (std::size_t i = 0; i < entries_.size(); ++i)
+                insert(i, name_of(entries_[i]));
+        }
+
+        void EnvIndex::rebuild(const std::pmr::vector<Arg>& args, std::string_view prefix)
+        {
+            clear();
+            for (std::size_t i = 0; i < args.size(); ++i)
+                add(i, args, prefix);
+        }
+
+        void EnvIndex::clear()
+        {
+            slots_.clear();
+            entries_.clear();
+            names_.clear();
+        }
+
+        void EnvIndex::insert(std::size_t entry, std::string_view name)
+        {
+            const auto mask = slots_.size() - 1;
+
+            auto pos = name_hash(name) & mask;
+            while (slots_[pos] != 0)
+                pos = (pos + 1) & mask;
+
+            slots_[pos] = static_cast<std::uint32_t>(entry) + 1;
+        }
     }
 }
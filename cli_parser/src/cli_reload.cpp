@@ -0,0 +1,176 @@
+#include "cli_reload.h"
+#include "cli_parser.h"
+#include "file_watch.h"
+
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace cliap
+{
+    // A snapshot owns what its values point into: the args, the schema and,
+    // in the storage of its result, copies of the config files
+    struct LiveConfig::Published {
+        Published(std::shared_ptr<const ArgSchema> schema, std::vector<std::string> args)
+            : schema{std::move(schema)}, args{std::move(args)}
+        {
+            this->schema->parse(this->args, result);
+        }
+
+        std::shared_ptr<const ArgSchema> schema;
+        std::vector<std::string> args;
+        ParseResult result;
+        std::uint64_t version{};
+        // One for being the current snapshot, one per Snapshot
+        mutable std::atomic<std::size_t> references{1};
+    };
+
+    namespace detail {
+        // The thread of LiveConfig::watch()
+        class ReloadWatch {
+        public:
+            ReloadWatch(LiveConfig& config, std::vector<std::string> paths, const ReloadOptions& options, LiveConfig::ReloadHandler on_reload)
+                : watch_{std::move(paths), options.watch_files, options.reload_on_hangup, options.poll_interval},
+                  thread_{[this, &config, on_reload = std::move(on_reload)] { run(config, on_reload); }}
+            {
+            }
+
+            ~ReloadWatch()
+            {
+                watch_.interrupt();
+                thread_.join();
+            }
+
+            ReloadWatch(const ReloadWatch&) = delete;
+            ReloadWatch& operator=(const ReloadWatch&) = delete;
+
+        private:
+            void run(LiveConfig& config, const LiveConfig::ReloadHandler& on_reload)
+            {
+                try {
+                    while (watch_.wait()) {
+                        // A throwing handler costs it the news of this
+                        // reload, not the later ones
+                        try {
+                            config.reload(on_reload);
+                        } catch (...) {
+                        }
+                    }
+                } catch (...) {
+                    // The watch broke; reload() still works
+                }
+            }
+
+            FileWatch watch_;
+            std::thread thread_;
+        };
+    }
+
+    LiveConfig::Snapshot& LiveConfig::Snapshot::operator=(Snapshot&& other) noexcept
+    {
+        if (this != &other)
+            release(std::exchange(published_, std::exchange(other.published_, nullptr)));
+        return *this;
+    }
+
+    const ParseResult& LiveConfig::Snapshot::operator*() const
+    {
+        return published_->result;
+    }
+
+    std::uint64_t LiveConfig::Snapshot::version() const
+    {
+        return published_->version;
+    }
+
+    void LiveConfig::release(const Published* published) noexcept
+    {
+        if (published && published->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete published;
+    }
+
+    LiveConfig::LiveConfig(std::shared_ptr<const ArgSchema> schema, std::vector<std::string> args)
+        : schema_{std::move(schema)}, args_{std::move(args)}
+    {
+        if (!schema_)
+            throw std::runtime_error("LiveConfig needs a schema");
+
+        auto published = std::make_unique<Published>(schema_, args_);
+        if (const auto error = published->result.error())
+            throw std::runtime_error(std::string{*error});
+
+        published->version = 1;
+        current_.store(published.release());
+    }
+
+    LiveConfig::~LiveConfig()
+    {
+        stop();
+        release(current_.load());
+    }
+
+    LiveConfig::Snapshot LiveConfig::snapshot() const noexcept
+    {
+        // Counted before the load, so a reload that swaps the snapshot out
+        // in between waits for the reference to be taken before dropping its
+        // own, which might be the last
+        auto& readers = readers_[epoch_.load() & 1].count;
+        readers.fetch_add(1);
+        const auto published = current_.load();
+        published->references.fetch_add(1, std::memory_order_relaxed);
+        readers.fetch_sub(1, std::memory_order_release);
+        return Snapshot{published};
+    }
+
+    bool LiveConfig::reload(const ReloadHandler& on_reload)
+    {
+        std::lock_guard lock{reload_mutex_};
+
+        auto published = std::make_unique<Published>(schema_, args_);
+        if (!published->result.ok()) {
+            if (on_reload)
+                on_reload(published->result);
+            return false;
+        }
+
+        published->version = current_.load()->version + 1;
+        const auto& result = published->result;
+        const auto previous = current_.exchange(published.release());
+        synchronize();
+        release(previous);
+
+        // Reloads are serialized, so the result is still current or held
+        if (on_reload)
+            on_reload(result);
+        return true;
+    }
+
+    void LiveConfig::synchronize()
+    {
+        // A snapshot() call may have read the epoch before the last reload
+        // moved it and counted itself in either slot; flipping twice drains
+        // both
+        for (int flip = 0; flip < 2; ++flip) {
+            const auto& readers = readers_[epoch_.fetch_add(1) & 1].count;
+            while (readers.load() != 0)
+                std::this_thread::yield();
+        }
+    }
+
+    void LiveConfig::watch(const ReloadOptions& options, ReloadHandler on_reload)
+    {
+        if (watch_)
+            throw std::runtime_error("LiveConfig is already watching");
+
+        std::vector<std::string> paths;
+        for (const auto path : schema_->config_files())
+            paths.emplace_back(path);
+
+        watch_ = std::make_unique<detail::ReloadWatch>(*this, std::move(paths), options, std::move(on_reload));
+    }
+
+    void LiveConfig::stop()
+    {
+        watch_.reset();
+    }
+}
@@ -0,0 +1,190 @@
+#include "cli_tokenizer.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLIAP_TOKENIZER_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace cliap
+{
+    namespace {
+        constexpr bool is_space(char ch)
+        {
+            return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f' || ch == '\v';
+        }
+
+        constexpr bool is_special(char ch)
+        {
+            return is_space(ch) || ch == '\'' || ch == '"' || ch == '\\';
+        }
+
+#if defined(CLIAP_TOKENIZER_SSE2)
+        int first_set_bit(unsigned mask)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctz(mask);
+#endif
+        }
+#endif
+    }
+
+    namespace detail {
+        std::size_t find_shell_special(std::string_view text)
+        {
+            std::size_t pos{};
+
+#if defined(CLIAP_TOKENIZER_SSE2)
+            // 16 bytes per step: ' ', quotes and backslash by equality, and
+            // \t \n \v \f \r as the range 9..13 (byte - 9 <= 4, unsigned)
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i single_quote = _mm_set1_epi8('\'');
+            const __m128i double_quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i control_base = _mm_set1_epi8(9);
+            const __m128i control_span = _mm_set1_epi8(4);
+
+            for (; pos + 16 <= text.size(); pos += 16) {
+                const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+                const __m128i shifted = _mm_sub_epi8(block, control_base);
+
+                __m128i hits = _mm_cmpeq_epi8(_mm_min_epu8(shifted, control_span), shifted);
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, space));
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, single_quote));
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, double_quote));
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, backslash));
+
+                const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+                if (mask != 0)
+                    return pos + static_cast<std::size_t>(first_set_bit(mask));
+            }
+#endif
+
+            while (pos < text.size() && !is_special(text[pos]))
+                ++pos;
+
+            return pos;
+        }
+
+        TokenStatus next_shell_token(std::string_view& rest, std::string_view& token, std::pmr::string& scratch)
+        {
+            for (;;) {
+                std::size_t pos{};
+                while (pos < rest.size() && is_space(rest[pos]))
+                    ++pos;
+                rest.remove_prefix(pos);
+
+                if (rest.empty())
+                    return TokenStatus::end;
+
+                if (rest.front() != '#')
+                    break;
+
+                const auto eol = rest.find('\n');
+                rest.remove_prefix(eol == std::string_view::npos ? rest.size() : eol);
+            }
+
+            std::size_t pos = find_shell_special(rest);
+
+            if (pos == rest.size() || is_space(rest[pos])) {
+                token = rest.substr(0, pos);
+                rest.remove_prefix(pos);
+                return TokenStatus::token;
+            }
+
+            scratch.assign(rest.data(), pos);
+
+            while (pos < rest.size() && !is_space(rest[pos])) {
+                const char ch = rest[pos];
+
+                if (ch == '\\') {
+                    if (pos + 1 < rest.size() && rest[pos + 1] != '\n')
+                        scratch += rest[pos + 1];
+                    else if (pos + 1 == rest.size())
+                        scratch += ch;
+                    pos += 2;
+                } else if (ch == '\'') {
+                    const auto close = rest.find('\'', pos + 1);
+                    if (close == std::string_view::npos)
+                        return TokenStatus::unterminated;
+                    scratch.append(rest.data() + pos + 1, close - pos - 1);
+                    pos = close + 1;
+                } else if (ch == '"') {
+                    for (++pos;; ++pos) {
+                        if (pos >= rest.size())
+                            return TokenStatus::unterminated;
+                        if (rest[pos] == '"')
+                            break;
+
+                        if (rest[pos] == '\\' && pos + 1 < rest.size()) {
+                            const char next = rest[pos + 1];
+                            if (next == '\n') {
+                                ++pos;
+                                continue;
+                            }
+                            if (next == '"' || next == '\\' || next == '$' || next == '`') {
+                                scratch += next;
+                                ++pos;
+                                continue;
+                            }
+                        }
+
+                        scratch += rest[pos];
+                    }
+                    ++pos;
+                } else {
+                    // Plain characters up to the next special one in one go
+                    const auto run = find_shell_special(rest.substr(pos));
+                    scratch.append(rest.data() + pos, run);
+                    pos += run;
+                }
+            }
+
+            token = scratch;
+            rest.remove_prefix(std::min(pos, rest.size()));
+            return TokenStatus::token;
+        }
+    }
+
+    void ShellTokenizer::feed(std::string_view chunk)
+    {
+        // Drop the consumed input; what is left is an incomplete token at most
+        if (buffered_)
+            buffer_.erase(0, static_cast<std::size_t>(rest_.data() - buffer_.data()));
+        else
+            buffer_.assign(rest_.data(), rest_.size());
+
+        buffer_.append(chunk.data(), chunk.size());
+        rest_ = buffer_;
+        buffered_ = true;
+    }
+
+    TokenStatus ShellTokenizer::next(std::string_view& token)
+    {
+        auto rest = rest_;
+        const auto status = detail::next_shell_token(rest, token, scratch_);
+
+        if (finished_) {
+            if (status != TokenStatus::unterminated)
+                rest_ = rest;
+            return status;
+        }
+
+        // A token that reaches the end of the input may go on in the next
+        // chunk, and so may a comment; both are scanned again after feed()
+        if (status == TokenStatus::token && !rest.empty()) {
+            rest_ = rest;
+            return status;
+        }
+
+        return TokenStatus::need_more;
+    }
+}
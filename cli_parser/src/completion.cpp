@@ -0,0 +1,121 @@
+#include "completion.h"
+
+namespace cliap::detail
+{
+    namespace {
+        constexpr std::string_view bash_script = R"(# bash completion for {{PROGRAM}}
+_{{ID}}_complete()
+{
+    local line=${COMP_LINE:0:COMP_POINT} word description strip=
+    local -a words
+    read -ra words <<< "$line"
+    [[ $line == *[[:space:]] ]] && words+=("")
+    local current=${words[${#words[@]}-1]}
+    # Bash splits words at '=', so candidates replace only the part after it
+    [[ $current == *=* && $COMP_WORDBREAKS == *=* ]] && strip=${current%=*}=
+    COMPREPLY=()
+    while IFS=$'\t' read -r word description; do
+        COMPREPLY+=("${word#"$strip"}")
+    done < <("$1" {{KEY}} "${words[@]:1}" 2>/dev/null)
+}
+complete -o default -F _{{ID}}_complete {{PROGRAM}}
+)";
+
+        constexpr std::string_view zsh_script = R"(# zsh completion for {{PROGRAM}}
+_{{ID}}_complete()
+{
+    local word description
+    local -a candidates
+    while IFS=$'\t' read -r word description; do
+        word=${word//:/\\:}
+        candidates+=("${word}${description:+:$description}")
+    done < <("${words[1]}" {{KEY}} "${(@)words[2,CURRENT]}" 2>/dev/null)
+    if (( ${#candidates} )); then
+        _describe -t candidates '{{PROGRAM}}' candidates
+    else
+        _files
+    fi
+}
+compdef _{{ID}}_complete {{PROGRAM}}
+)";
+
+        constexpr std::string_view fish_script = R"(# fish completion for {{PROGRAM}}
+function __{{ID}}_complete
+    set -l words (commandline -opc)
+    set -l current (commandline -ct)
+    set -l program $words[1]
+    set -e words[1]
+    set -l candidates ($program {{KEY}} $words "$current" 2>/dev/null)
+    if set -q candidates[1]
+        printf '%s\n' $candidates
+    else
+        __fish_complete_path "$current"
+    end
+end
+complete -c {{PROGRAM}} -f -a '(__{{ID}}_complete)'
+)";
+
+        // The program name reduced to characters valid in a shell function name
+        std::string function_id(std::string_view program)
+        {
+            if (const auto slash = program.find_last_of("/\\"); slash != std::string_view::npos)
+                program.remove_prefix(slash + 1);
+
+            std::string id;
+            for (const char ch : program) {
+                const bool valid = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9');
+                id += valid ? ch : '_';
+            }
+
+            return id;
+        }
+    }
+
+    void add_candidate(std::pmr::string& out, std::string_view lead, std::string_view name, std::string_view word,
+        std::string_view description)
+    {
+        if (name.empty())
+            return;
+
+        const auto start = out.size();
+        out += lead;
+        out += name;
+
+        if (std::string_view{out}.substr(start).compare(0, word.size(), word) != 0) {
+            out.resize(start);
+            return;
+        }
+
+        description = description.substr(0, description.find('\n'));
+        if (!description.empty()) {
+            out += '\t';
+            out += description;
+        }
+        out += '\n';
+    }
+
+    void write_completion_script(std::string& out, Shell shell, std::string_view program, std::string_view key)
+    {
+        const auto script = shell == Shell::bash ? bash_script : shell == Shell::zsh ? zsh_script : fish_script;
+        const auto id = function_id(program);
+
+        // Fills in the {{NAME}} placeholders
+        for (std::size_t pos = 0; pos < script.size();) {
+            const auto open = script.find("{{", pos);
+            out += script.substr(pos, open - pos);
+            if (open == std::string_view::npos)
+                break;
+
+            const auto close = script.find("}}", open);
+            const auto name = script.substr(open + 2, close - open - 2);
+            if (name == "PROGRAM")
+                out += program;
+            else if (name == "ID")
+                out += id;
+            else
+                out += key;
+
+            pos = close + 2;
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef completion_h__
+#define completion_h__
+
+#include "cli_parser.h"
+
+#include <string>
+#include <string_view>
+
+namespace cliap::detail {
+    // Appends lead + name as a line of completion output when it starts with
+    // word, followed by a tab and the first line of description if that is
+    // not empty
+    void add_candidate(std::pmr::string& out, std::string_view lead, std::string_view name, std::string_view word,
+        std::string_view description);
+
+    // Appends a script for shell that completes program by running
+    // "program key words..." and reading candidates in the format of
+    // add_candidate()
+    void write_completion_script(std::string& out, Shell shell, std::string_view program, std::string_view key);
+}
+
+#endif // completion_h__
@@ -0,0 +1,92 @@
+#include "config_file.h"
+
+namespace cliap::detail
+{
+    namespace {
+        // The remainder of a line after a quoted value may only hold a comment
+        bool only_comment(std::string_view rest)
+        {
+            const auto pos = rest.find_first_not_of(" \t\r");
+            return pos == std::string_view::npos || rest[pos] == '#' || rest[pos] == ';';
+        }
+    }
+
+    const char* ConfigReader::read_value(std::string_view str, std::string_view& value, bool& is_scratch)
+    {
+        is_scratch = false;
+
+        if (str.empty()) {
+            value = {};
+            return nullptr;
+        }
+
+        if (str.front() == '\'') {
+            const auto close = str.find('\'', 1);
+            if (close == std::string_view::npos)
+                return "unterminated literal string";
+            if (!only_comment(str.substr(close + 1)))
+                return "unexpected text after string";
+
+            value = str.substr(1, close - 1);
+            return nullptr;
+        }
+
+        if (str.front() == '"') {
+            const auto close = str.find('"', 1);
+            auto pos = str.substr(0, close).find('\\', 1);
+
+            if (pos == std::string_view::npos) {
+                if (close == std::string_view::npos)
+                    return "unterminated string";
+                if (!only_comment(str.substr(close + 1)))
+                    return "unexpected text after string";
+                value = str.substr(1, close - 1);
+                return nullptr;
+            }
+
+            scratch_.assign(str.data() + 1, pos - 1);
+
+            for (;; ++pos) {
+                if (pos >= str.size())
+                    return "unterminated string";
+                if (str[pos] == '"')
+                    break;
+
+                if (str[pos] != '\\') {
+                    scratch_ += str[pos];
+                    continue;
+                }
+
+                if (++pos >= str.size())
+                    return "unterminated string";
+
+                switch (str[pos]) {
+                case 'n': scratch_ += '\n'; break;
+                case 't': scratch_ += '\t'; break;
+                case 'r': scratch_ += '\r'; break;
+                case '"': scratch_ += '"'; break;
+                case '\\': scratch_ += '\\'; break;
+                default: return "unsupported escape sequence";
+                }
+            }
+
+            if (!only_comment(str.substr(pos + 1)))
+                return "unexpected text after string";
+
+            value = scratch_;
+            is_scratch = true;
+            return nullptr;
+        }
+
+        // A bare value runs up to a comment that follows whitespace
+        for (std::size_t pos = 1; pos < str.size(); ++pos) {
+            if ((str[pos] == '#' || str[pos] == ';') && (str[pos - 1] == ' ' || str[pos - 1] == '\t')) {
+                str = str.substr(0, pos);
+                break;
+            }
+        }
+
+        value = str.substr(0, str.find_last_not_of(" \t") + 1);
+        return nullptr;
+    }
+}
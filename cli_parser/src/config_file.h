@@ -0,0 +1,124 @@
+#ifndef config_file_h__
+#define config_file_h__
+
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace cliap::detail {
+    struct ConfigEntry {
+        // "section.key" inside a [section], otherwise just "key"
+        std::string_view key;
+        std::string_view value;
+        std::size_t line;
+        // The value was unescaped into scratch memory and must be copied
+        bool is_scratch;
+    };
+
+    // Single-pass reader for the INI/TOML subset used by config files:
+    //
+    //     # comment          ; comment
+    //     [section]
+    //     key = bare value   # trailing comment
+    //     key = "basic \"string\"\n"
+    //     key = 'literal string'
+    //
+    // Keys and values are views into text wherever possible. on_entry is
+    // called for every key and may return an error message to stop reading;
+    // errors are prefixed with the line number.
+    class ConfigReader {
+    public:
+        // Section prefixes and unescaped values are kept in buffers allocated
+        // from resource
+        explicit ConfigReader(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : key_{resource}, scratch_{resource} {}
+
+        template<typename OnEntry>
+        std::optional<std::string> read(std::string_view text, OnEntry&& on_entry) {
+            prefix_size_ = 0;
+            std::size_t line_no{};
+
+            while (!text.empty()) {
+                ++line_no;
+                const auto eol = text.find('\n');
+                auto line = text.substr(0, eol);
+                text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+                line = trim(line);
+                if (line.empty() || line.front() == '#' || line.front() == ';')
+                    continue;
+
+                if (line.front() == '[') {
+                    const auto close = line.find(']');
+                    if (close == std::string_view::npos)
+                        return error(line_no, "unterminated section header");
+
+                    const auto rest = trim(line.substr(close + 1));
+                    if (!rest.empty() && rest.front() != '#' && rest.front() != ';')
+                        return error(line_no, "unexpected text after section header");
+
+                    const auto section = trim(line.substr(1, close - 1));
+                    key_.assign(section);
+                    if (!section.empty())
+                        key_ += '.';
+                    prefix_size_ = key_.size();
+                    continue;
+                }
+
+                const auto equal_pos = line.find('=');
+                if (equal_pos == std::string_view::npos)
+                    return error(line_no, "expected key = value");
+
+                const auto key = trim(line.substr(0, equal_pos));
+                if (key.empty())
+                    return error(line_no, "empty key");
+
+                std::string_view value;
+                bool is_scratch{false};
+                if (const auto failure = read_value(trim(line.substr(equal_pos + 1)), value, is_scratch))
+                    return error(line_no, failure);
+
+                std::string_view full_key = key;
+                if (prefix_size_ != 0) {
+                    // key_ keeps the "section." prefix; only the key is copied
+                    if (key_.size() < prefix_size_ + key.size())
+                        key_.resize(prefix_size_ + key.size());
+                    std::memcpy(key_.data() + prefix_size_, key.data(), key.size());
+                    full_key = std::string_view{key_.data(), prefix_size_ + key.size()};
+                }
+
+                if (const auto failure = on_entry(ConfigEntry{full_key, value, line_no, is_scratch}))
+                    return error(line_no, *failure);
+            }
+
+            return {};
+        }
+
+    private:
+        static constexpr bool is_blank(char ch) { return ch == ' ' || ch == '\t' || ch == '\r'; }
+
+        static std::string_view trim(std::string_view str) {
+            while (!str.empty() && is_blank(str.front()))
+                str.remove_prefix(1);
+            while (!str.empty() && is_blank(str.back()))
+                str.remove_suffix(1);
+            return str;
+        }
+
+        static std::string error(std::size_t line_no, std::string_view message) {
+            return "line " + std::to_string(line_no) + ": " + std::string{message};
+        }
+
+        // Returns an error message, or nullptr on success
+        const char* read_value(std::string_view str, std::string_view& value, bool& is_scratch);
+
+        std::pmr::string key_;
+        std::size_t prefix_size_{};
+        std::pmr::string scratch_;
+    };
+}
+
+#endif // config_file_h__
@@ -0,0 +1,26 @@
+#include "environment.h"
+
+#if defined(_WIN32)
+#include <stdlib.h>
+#elif defined(__APPLE__)
+#include <crt_externs.h>
+#else
+extern "C" {
+    extern char** environ;
+}
+#endif
+
+namespace cliap::detail
+{
+    const char* const* environment()
+    {
+#if defined(_WIN32)
+        return _environ;
+#elif defined(__APPLE__)
+        // environ itself is not visible to shared libraries
+        return *_NSGetEnviron();
+#else
+        return environ;
+#endif
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef environment_h__
+#define environment_h__
+
+namespace cliap::detail {
+    // The NAME=value entries of the environment of the process, ending with
+    // a null pointer; null when the process has no narrow environment
+    const char* const* environment();
+}
+
+#endif // environment_h__
@@ -0,0 +1,297 @@
+#include "file_watch.h"
+
+#include <stdexcept>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <algorithm>
+#include <cerrno>
+#include <mutex>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+namespace cliap::detail
+{
+    namespace {
+        std::filesystem::file_time_type write_time(const std::string& path)
+        {
+            std::error_code error;
+            const auto time = std::filesystem::last_write_time(path, error);
+            return error ? std::filesystem::file_time_type::min() : time;
+        }
+
+#if !defined(_WIN32)
+        // The self-pipe of SIGHUP, written by the handler and read by the
+        // watches that take SIGHUP. It is never closed, so that the handler
+        // cannot write into a descriptor since reused for something else.
+        // The handler may only touch lock-free atomics.
+        int hangup_pipe[2]{-1, -1};
+        std::atomic<int> hangup_write_end{-1};
+
+        struct sigaction previous_hangup_action{};
+
+        // The write ends of the wake-up pipes of the watches that take
+        // SIGHUP, which a watch reading the self-pipe passes it on to
+        std::mutex hangup_mutex;
+        std::vector<int> hangup_watches;
+
+        void on_hangup(int signal, siginfo_t* info, void* context)
+        {
+            const int saved_errno = errno;
+            if (const int pipe = hangup_write_end.load(); pipe >= 0)
+                [[maybe_unused]] const auto written = ::write(pipe, "h", 1);
+            errno = saved_errno;
+
+            // Whoever handled SIGHUP before still gets it
+            if (previous_hangup_action.sa_flags & SA_SIGINFO) {
+                if (previous_hangup_action.sa_sigaction)
+                    previous_hangup_action.sa_sigaction(signal, info, context);
+            } else if (previous_hangup_action.sa_handler != SIG_DFL && previous_hangup_action.sa_handler != SIG_IGN) {
+                previous_hangup_action.sa_handler(signal);
+            }
+        }
+
+        // Returns the read end of the self-pipe. The handler is installed
+        // with the first watch, replacing the default action that would end
+        // the process.
+        int add_hangup_watch(int wake)
+        {
+            std::lock_guard lock{hangup_mutex};
+            if (hangup_pipe[0] < 0) {
+                if (::pipe(hangup_pipe) != 0)
+                    throw std::runtime_error("Unable to create the SIGHUP pipe");
+                for (const int end : hangup_pipe) {
+                    ::fcntl(end, F_SETFD, FD_CLOEXEC);
+                    ::fcntl(end, F_SETFL, ::fcntl(end, F_GETFL) | O_NONBLOCK);
+                }
+                hangup_write_end = hangup_pipe[1];
+            }
+
+            if (hangup_watches.empty()) {
+                struct sigaction action{};
+                action.sa_sigaction = on_hangup;
+                action.sa_flags = SA_SIGINFO | SA_RESTART;
+                sigemptyset(&action.sa_mask);
+                if (::sigaction(SIGHUP, &action, &previous_hangup_action) != 0)
+                    throw std::runtime_error("Unable to install a SIGHUP handler");
+            }
+
+            hangup_watches.push_back(wake);
+            return hangup_pipe[0];
+        }
+
+        // The previous action comes back with the last watch, unless another
+        // handler has been installed since
+        void remove_hangup_watch(int wake)
+        {
+            std::lock_guard lock{hangup_mutex};
+            hangup_watches.erase(std::remove(hangup_watches.begin(), hangup_watches.end(), wake), hangup_watches.end());
+            if (!hangup_watches.empty())
+                return;
+
+            struct sigaction current{};
+            if (::sigaction(SIGHUP, nullptr, &current) == 0 && (current.sa_flags & SA_SIGINFO) && current.sa_sigaction == on_hangup)
+                ::sigaction(SIGHUP, &previous_hangup_action, nullptr);
+        }
+
+        // Empties the self-pipe and wakes the other watches that take
+        // SIGHUP; true when there was a SIGHUP to pass on
+        bool forward_hangup(int own_wake)
+        {
+            std::lock_guard lock{hangup_mutex};
+            bool hangup = false;
+            char bytes[64];
+            while (::read(hangup_pipe[0], bytes, sizeof bytes) > 0)
+                hangup = true;
+
+            if (hangup) {
+                for (const int wake : hangup_watches) {
+                    if (wake != own_wake)
+                        [[maybe_unused]] const auto written = ::write(wake, "h", 1);
+                }
+            }
+            return hangup;
+        }
+#endif
+    }
+
+    bool FileWatch::poll_files()
+    {
+        bool changed = false;
+        for (std::size_t i = 0; i < paths_.size(); ++i) {
+            const auto time = write_time(paths_[i]);
+            if (time != write_times_[i]) {
+                write_times_[i] = time;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+#if defined(_WIN32)
+    FileWatch::FileWatch(std::vector<std::string> paths, bool watch_files, bool, std::chrono::milliseconds poll_interval)
+        : paths_{std::move(paths)}, poll_interval_{poll_interval}, polling_{watch_files && !paths_.empty()}
+    {
+        for (const auto& path : paths_)
+            write_times_.push_back(write_time(path));
+    }
+
+    FileWatch::~FileWatch() = default;
+
+    bool FileWatch::wait()
+    {
+        std::unique_lock lock{mutex_};
+        for (;;) {
+            if (polling_)
+                interrupted_cv_.wait_for(lock, poll_interval_, [this] { return interrupted_; });
+            else
+                interrupted_cv_.wait(lock, [this] { return interrupted_; });
+
+            if (interrupted_)
+                return false;
+            if (poll_files())
+                return true;
+        }
+    }
+
+    void FileWatch::interrupt()
+    {
+        {
+            std::lock_guard lock{mutex_};
+            interrupted_ = true;
+        }
+        interrupted_cv_.notify_all();
+    }
+#else
+    FileWatch::FileWatch(std::vector<std::string> paths, bool watch_files, bool hangup, std::chrono::milliseconds poll_interval)
+        : paths_{std::move(paths)}, poll_interval_{poll_interval}
+    {
+        if (::pipe(wake_) != 0)
+            throw std::runtime_error("Unable to create the wake-up pipe of a file watch");
+        for (const int end : wake_) {
+            ::fcntl(end, F_SETFD, FD_CLOEXEC);
+            ::fcntl(end, F_SETFL, ::fcntl(end, F_GETFL) | O_NONBLOCK);
+        }
+
+        if (hangup) {
+            try {
+                hangup_pipe_ = add_hangup_watch(wake_[1]);
+            } catch (...) {
+                ::close(wake_[0]);
+                ::close(wake_[1]);
+                throw;
+            }
+        }
+
+        if (watch_files && !paths_.empty()) {
+#if defined(__linux__)
+            // The directories are watched rather than the files, which
+            // editors and deployment tools tend to replace by renaming
+            inotify_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            for (const auto& path : paths_) {
+                if (inotify_ < 0)
+                    break;
+
+                const std::filesystem::path file{path};
+                const auto directory = file.has_parent_path() ? file.parent_path() : std::filesystem::path{"."};
+                const int descriptor = ::inotify_add_watch(inotify_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+                if (descriptor < 0) {
+                    ::close(inotify_);
+                    inotify_ = -1;
+                    watched_.clear();
+                } else {
+                    watched_.push_back({descriptor, file.filename().string()});
+                }
+            }
+#endif
+            if (inotify_ < 0) {
+                polling_ = true;
+                for (const auto& path : paths_)
+                    write_times_.push_back(write_time(path));
+            }
+        }
+    }
+
+    FileWatch::~FileWatch()
+    {
+        // No SIGHUP is passed on to the wake-up pipe once it is removed
+        if (hangup_pipe_ >= 0)
+            remove_hangup_watch(wake_[1]);
+
+        if (inotify_ >= 0)
+            ::close(inotify_);
+        ::close(wake_[0]);
+        ::close(wake_[1]);
+    }
+
+    bool FileWatch::wait()
+    {
+        // Negative descriptors are skipped by poll()
+        pollfd descriptors[3] = {{wake_[0], POLLIN, 0}, {hangup_pipe_, POLLIN, 0}, {inotify_, POLLIN, 0}};
+        const int timeout = polling_ ? static_cast<int>(poll_interval_.count()) : -1;
+
+        while (!interrupted_) {
+            const int ready = ::poll(descriptors, 3, timeout);
+            if (ready < 0 && errno != EINTR)
+                throw std::runtime_error("Unable to wait for file changes");
+
+            if (interrupted_)
+                break;
+
+            bool changed = false;
+
+            if (ready > 0 && (descriptors[0].revents & POLLIN)) {
+                char bytes[64];
+                while (::read(wake_[0], bytes, sizeof bytes) > 0)
+                    changed = true;
+            }
+
+            if (ready > 0 && (descriptors[1].revents & POLLIN) && forward_hangup(wake_[1]))
+                changed = true;
+
+#if defined(__linux__)
+            if (ready > 0 && (descriptors[2].revents & POLLIN)) {
+                alignas(inotify_event) char events[4096];
+                for (;;) {
+                    const auto size = ::read(inotify_, events, sizeof events);
+                    if (size <= 0)
+                        break;
+
+                    for (auto next = events; next < events + size;) {
+                        const auto event = reinterpret_cast<const inotify_event*>(next);
+                        next += sizeof(inotify_event) + event->len;
+
+                        for (const auto& watched : watched_) {
+                            if (event->len && watched.descriptor == event->wd && watched.name == event->name)
+                                changed = true;
+                        }
+                    }
+                }
+            }
+#endif
+
+            if (polling_ && ready == 0)
+                changed = poll_files();
+
+            if (changed)
+                return true;
+        }
+
+        return false;
+    }
+
+    void FileWatch::interrupt()
+    {
+        interrupted_ = true;
+        [[maybe_unused]] const auto written = ::write(wake_[1], "s", 1);
+    }
+#endif
+}
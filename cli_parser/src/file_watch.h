@@ -0,0 +1,70 @@
+#ifndef file_watch_h__
+#define file_watch_h__
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <condition_variable>
+#include <mutex>
+#else
+#include <atomic>
+#endif
+
+namespace cliap::detail {
+    // Waits for any of a set of files to be written or replaced, or for the
+    // process to get SIGHUP. Files are watched with inotify where there is
+    // one, by comparing their modification times every poll interval
+    // elsewhere. SIGHUP is not available on Windows.
+    class FileWatch {
+    public:
+        // Throws std::runtime_error when the watch cannot be set up
+        FileWatch(std::vector<std::string> paths, bool watch_files, bool hangup, std::chrono::milliseconds poll_interval);
+        ~FileWatch();
+
+        FileWatch(const FileWatch&) = delete;
+        FileWatch& operator=(const FileWatch&) = delete;
+
+        // Blocks until a change or SIGHUP, returning true, or until
+        // interrupt(), returning false from then on
+        bool wait();
+
+        // Callable from any thread
+        void interrupt();
+
+    private:
+        // True when a polled file has a new modification time
+        bool poll_files();
+
+        std::vector<std::string> paths_;
+        std::vector<std::filesystem::file_time_type> write_times_;
+        std::chrono::milliseconds poll_interval_;
+        bool polling_{false};
+
+#if defined(_WIN32)
+        std::mutex mutex_;
+        std::condition_variable interrupted_cv_;
+        bool interrupted_{false};
+#else
+        // The wake-up pipe, written by interrupt() and by the watches that
+        // pass SIGHUP on
+        int wake_[2]{-1, -1};
+        // The read end of the process-wide SIGHUP pipe, or -1
+        int hangup_pipe_{-1};
+        std::atomic<bool> interrupted_{false};
+
+        struct Watched {
+            int descriptor;
+            std::string name;
+        };
+
+        // An inotify instance watching the directories of the files, or -1
+        int inotify_{-1};
+        std::vector<Watched> watched_;
+#endif
+    };
+}
+
+#endif // file_watch_h__
@@ -0,0 +1,205 @@
+#include "help_format.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace cliap::detail
+{
+    namespace {
+        constexpr std::size_t default_width = 80;
+        constexpr std::string_view tab = "    ";
+
+        // Narrower description columns are not wrapped at all
+        constexpr std::size_t min_wrap_width = 20;
+
+        // Appends words, breaking lines before a word that would cross the
+        // right margin
+        class Wrapper {
+        public:
+            Wrapper(std::pmr::string& out, std::size_t indent, std::size_t width)
+                : out_{out}, indent_{indent},
+                  available_{width > indent + min_wrap_width ? width - indent : std::string_view::npos} {}
+
+            // The prefix and suffix are glued to the first and last words of
+            // text, so that they never end up alone on a line
+            void add(std::string_view text, std::string_view prefix = {}, std::string_view suffix = {})
+            {
+                auto begin = text.find_first_not_of(' ');
+                if (begin == std::string_view::npos && !(prefix.empty() && suffix.empty()))
+                    add_word(prefix, {}, suffix);
+
+                while (begin != std::string_view::npos) {
+                    text.remove_prefix(begin);
+
+                    const auto end = std::min(text.find(' '), text.size());
+                    const auto word = text.substr(0, end);
+                    text.remove_prefix(end);
+
+                    begin = text.find_first_not_of(' ');
+                    add_word(prefix, word, begin == std::string_view::npos ? suffix : std::string_view{});
+                    prefix = {};
+                }
+            }
+
+        private:
+            void add_word(std::string_view prefix, std::string_view word, std::string_view suffix)
+            {
+                const auto size = prefix.size() + word.size() + suffix.size();
+
+                if (column_ > 0 && column_ + 1 + size > available_) {
+                    out_ += '\n';
+                    out_.append(indent_, ' ');
+                    column_ = 0;
+                } else if (column_ > 0) {
+                    out_ += ' ';
+                    ++column_;
+                }
+
+                out_ += prefix;
+                out_ += word;
+                out_ += suffix;
+                column_ += size;
+            }
+
+            std::pmr::string& out_;
+            std::size_t indent_;
+            std::size_t available_;
+            std::size_t column_{};
+        };
+
+        void append_padded(std::pmr::string& out, std::string_view text, std::size_t width)
+        {
+            out += text;
+            out.append(width - std::min(width, text.size()), ' ');
+        }
+    }
+
+    std::size_t terminal_width()
+    {
+#if defined(_WIN32)
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+            return static_cast<std::size_t>(info.srWindow.Right - info.srWindow.Left + 1);
+#else
+        winsize size{};
+        if (::ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+            return size.ws_col;
+#endif
+
+        if (const char* columns = std::getenv("COLUMNS")) {
+            const auto width = std::strtoul(columns, nullptr, 10);
+            if (width > 0)
+                return width;
+        }
+
+        return default_width;
+    }
+
+    void format_help(std::pmr::string& out, const std::pmr::vector<Arg>& args, const std::pmr::vector<CommandInfo>& commands,
+        const std::pmr::vector<std::pmr::string>& usage_examples, std::size_t width)
+    {
+        std::size_t short_width{};
+        std::size_t long_width{};
+        std::size_t text_size{};
+
+        for (const auto& parm : args) {
+            short_width = std::max(short_width, parm.short_name_view().size());
+            long_width = std::max(long_width, parm.long_name_view().size());
+            text_size += parm.description_view().size() + parm.default_value_view().size();
+        }
+
+        for (const auto& command : commands)
+            text_size += tab.size() + command.name.size() + command.description.size() + 16;
+
+        // "    -s [ --long ] " in front of every description
+        const auto indent = tab.size() + 1 + short_width + 5 + long_width + 3;
+        out.reserve(out.size() + 64 + args.size() * (indent + 32) + text_size);
+
+        out += "Usage:\n";
+        for (const auto& example : usage_examples) {
+            out += tab;
+            out += example;
+            out += '\n';
+        }
+        out += '\n';
+
+        for (const auto& parm : args) {
+            const auto short_name = parm.short_name_view();
+            const auto long_name = parm.long_name_view();
+
+            out += tab;
+            out += short_name.empty() ? ' ' : '-';
+            append_padded(out, short_name, short_width);
+            out += long_name.empty() ? " [   " : " [ --";
+            append_padded(out, long_name, long_width);
+            out += " ] ";
+
+            Wrapper wrapper{out, indent, width};
+            wrapper.add(parm.description_view());
+
+            if (parm.is_required())
+                wrapper.add("[required]");
+
+            if (!parm.default_value_view().empty())
+                wrapper.add(parm.default_value_view(), "(default: ", ")");
+
+            while (out.back() == ' ')
+                out.pop_back();
+            out += '\n';
+        }
+
+        if (commands.empty())
+            return;
+
+        std::size_t name_width{};
+        for (const auto& command : commands)
+            name_width = std::max(name_width, command.name.size());
+
+        out += "\nCommands:\n";
+        for (const auto& command : commands) {
+            out += tab;
+            append_padded(out, command.name, name_width + 2);
+
+            Wrapper wrapper{out, tab.size() + name_width + 2, width};
+            wrapper.add(command.description);
+
+            while (out.back() == ' ')
+                out.pop_back();
+            out += '\n';
+        }
+    }
+
+    bool write_all(int fd, std::string_view text)
+    {
+        while (!text.empty()) {
+#if defined(_WIN32)
+            const auto chunk = static_cast<unsigned int>(std::min<std::size_t>(text.size(), 1u << 30));
+            const int written = ::_write(fd, text.data(), chunk);
+            if (written < 0)
+                return false;
+#else
+            const auto written = ::write(fd, text.data(), text.size());
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+#endif
+            text.remove_prefix(static_cast<std::size_t>(written));
+        }
+
+        return true;
+    }
+}
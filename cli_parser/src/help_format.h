@@ -0,0 +1,25 @@
+#ifndef help_format_h__
+#define help_format_h__
+
+#include "cli_parser.h"
+
+#include <cstddef>
+#include <string_view>
+
+namespace cliap::detail {
+    // Columns of the terminal on stdout, or of $COLUMNS when stdout is not a
+    // terminal; 80 when neither is known
+    std::size_t terminal_width();
+
+    // Appends the usage examples, a table of args and one of commands to
+    // out. Descriptions are wrapped at width columns and continue under the
+    // description column; width 0 means no wrapping.
+    void format_help(std::pmr::string& out, const std::pmr::vector<Arg>& args, const std::pmr::vector<CommandInfo>& commands,
+        const std::pmr::vector<std::pmr::string>& usage_examples, std::size_t width);
+
+    // Writes all of text to the file descriptor, in one call unless the
+    // system writes only part of it
+    bool write_all(int fd, std::string_view text);
+}
+
+#endif // help_format_h__
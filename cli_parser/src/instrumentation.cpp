@@ -0,0 +1,39 @@
+#include "instrumentation.h"
+
+#include <string>
+
+namespace cliap
+{
+    std::string ParseStats::to_json() const
+    {
+        std::string out{"{"};
+
+        const auto add = [&out](std::string_view name, std::uint64_t value) {
+            if (out.size() > 1)
+                out += ", ";
+            out += '"';
+            out += name;
+            out += "\": ";
+            out += std::to_string(value);
+        };
+
+        add("parses", parses);
+        add("tokens", tokens);
+        add("lookups", lookups);
+        add("allocations", allocations);
+        add("allocated_bytes", allocated_bytes);
+        add("errors", errors);
+        add("registration_ns", static_cast<std::uint64_t>(registration.count()));
+        add("parse_ns", static_cast<std::uint64_t>(parse.count()));
+        add("tokenization_ns", static_cast<std::uint64_t>(tokenization.count()));
+        add("lookup_ns", static_cast<std::uint64_t>(lookup.count()));
+        add("config_files_ns", static_cast<std::uint64_t>(config_files.count()));
+        add("environment_ns", static_cast<std::uint64_t>(environment.count()));
+        add("conversion_ns", static_cast<std::uint64_t>(conversion.count()));
+        add("required_check_ns", static_cast<std::uint64_t>(required_check.count()));
+        add("help_ns", static_cast<std::uint64_t>(help.count()));
+
+        out += '}';
+        return out;
+    }
+}
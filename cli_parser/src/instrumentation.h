@@ -0,0 +1,97 @@
+#ifndef instrumentation_h__
+#define instrumentation_h__
+
+#include "cli_parser.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory_resource>
+
+namespace cliap::detail {
+#if CLI_PARSER_INSTRUMENTATION
+    // The statistics and hooks of an instrumented ArgParser. It is also the
+    // memory resource the parser allocates from, counting what it passes on
+    // to the resource the parser was given.
+    class Instrumentation final : public std::pmr::memory_resource {
+    public:
+        explicit Instrumentation(std::pmr::memory_resource* upstream) : upstream_{upstream} {}
+
+        std::pmr::memory_resource* upstream() const { return upstream_; }
+
+        void count_parse() { ++stats.parses; }
+        void count_tokens(std::size_t count) { stats.tokens += count; }
+        void count_lookup() { ++stats.lookups; }
+
+        void arg_parsed(const Arg& parm) {
+            if (on_arg_parsed)
+                on_arg_parsed(parm);
+        }
+
+        // The message is only formatted for a hook
+        void error(const ParseError& error) {
+            ++stats.errors;
+            if (on_error)
+                on_error(error.message());
+        }
+
+        ParseStats stats;
+        ArgParser::ArgHook on_arg_parsed;
+        ArgParser::ErrorHook on_error;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++stats.allocations;
+            stats.allocated_bytes += bytes;
+            return upstream_->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+            upstream_->deallocate(ptr, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+        std::pmr::memory_resource* upstream_;
+    };
+
+    // Adds the time between its construction and destruction to a phase
+    class PhaseTimer {
+    public:
+        PhaseTimer(Instrumentation* instrumentation, std::chrono::nanoseconds ParseStats::* phase)
+            : instrumentation_{instrumentation}, phase_{phase}, start_{instrumentation ? clock::now() : clock::time_point{}} {}
+
+        ~PhaseTimer() {
+            if (instrumentation_)
+                instrumentation_->stats.*phase_ += clock::now() - start_;
+        }
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        Instrumentation* instrumentation_;
+        std::chrono::nanoseconds ParseStats::* phase_;
+        clock::time_point start_;
+    };
+#else
+    // Compiled out: parsers and results hand out a null pointer known at
+    // compile time, so the calls guarded by it disappear
+    class Instrumentation {
+    public:
+        void count_parse() {}
+        void count_tokens(std::size_t) {}
+        void count_lookup() {}
+        void arg_parsed(const Arg&) {}
+        void error(const ParseError&) {}
+    };
+
+    class PhaseTimer {
+    public:
+        PhaseTimer(Instrumentation*, std::chrono::nanoseconds ParseStats::*) {}
+    };
+#endif
+}
+
+#endif // instrumentation_h__
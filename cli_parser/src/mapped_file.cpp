@@ -0,0 +1,225 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cliap::detail
+{
+    FileReader::~FileReader()
+    {
+#if defined(_WIN32)
+        if (handle_)
+            CloseHandle(handle_);
+#else
+        if (fd_ >= 0)
+            ::close(fd_);
+#endif
+    }
+
+#if defined(_WIN32)
+    bool FileReader::open(const char* path)
+    {
+        const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size{};
+        if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            return false;
+        }
+
+        handle_ = file;
+        size_ = static_cast<std::size_t>(size.QuadPart);
+        return true;
+    }
+
+    bool FileReader::read(char* dest, std::size_t& size)
+    {
+        std::size_t total = 0;
+        while (total < size) {
+            const auto chunk = static_cast<DWORD>(std::min<std::size_t>(size - total, 1u << 30));
+            DWORD count = 0;
+            if (!ReadFile(handle_, dest + total, chunk, &count, nullptr))
+                return false;
+            if (count == 0)
+                break;
+            total += count;
+        }
+
+        size = total;
+        return true;
+    }
+#else
+    bool FileReader::open(const char* path)
+    {
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+
+        fd_ = fd;
+        size_ = static_cast<std::size_t>(st.st_size);
+        return true;
+    }
+
+    bool FileReader::read(char* dest, std::size_t& size)
+    {
+        std::size_t total = 0;
+        while (total < size) {
+            const auto count = ::read(fd_, dest + total, size - total);
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            if (count == 0)
+                break;
+            total += static_cast<std::size_t>(count);
+        }
+
+        size = total;
+        return true;
+    }
+#endif
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            close();
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+#if defined(_WIN32)
+            std::swap(mapping_, other.mapping_);
+#endif
+        }
+
+        return *this;
+    }
+
+#if defined(_WIN32)
+    bool MappedFile::open(const char* path)
+    {
+        close();
+
+        const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            return false;
+        }
+
+        if (size.QuadPart == 0) {
+            CloseHandle(file);
+            return true;
+        }
+
+        const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+            return false;
+
+        const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (data == nullptr) {
+            CloseHandle(mapping);
+            return false;
+        }
+
+        mapping_ = mapping;
+        data_ = static_cast<const char*>(data);
+        size_ = static_cast<std::size_t>(size.QuadPart);
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (size_ != 0) {
+            UnmapViewOfFile(data_);
+            CloseHandle(mapping_);
+        }
+
+        mapping_ = nullptr;
+        data_ = "";
+        size_ = 0;
+    }
+#else
+    bool MappedFile::open(const char* path)
+    {
+        close();
+
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+
+        if (st.st_size == 0) {
+            ::close(fd);
+            return true;
+        }
+
+        // Every page is read, so fault them all in up front where supported
+        int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+        flags |= MAP_POPULATE;
+#endif
+        void* data = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, flags, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return false;
+
+        // Files are tokenized front to back exactly once
+        madvise(data, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+
+        data_ = static_cast<const char*>(data);
+        size_ = static_cast<std::size_t>(st.st_size);
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (size_ != 0)
+            munmap(const_cast<char*>(data_), size_);
+
+        data_ = "";
+        size_ = 0;
+    }
+#endif
+}
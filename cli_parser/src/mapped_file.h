@@ -0,0 +1,68 @@
+#ifndef mapped_file_h__
+#define mapped_file_h__
+
+#include <cstddef>
+#include <string_view>
+
+namespace cliap::detail {
+    // A regular file opened for reading into memory of the caller. Unlike a
+    // mapping, what was read does not change when the file is rewritten or
+    // truncated afterwards, and a file truncated while it is read reads short.
+    class FileReader {
+    public:
+        FileReader() = default;
+        ~FileReader();
+
+        FileReader(const FileReader&) = delete;
+        FileReader& operator=(const FileReader&) = delete;
+
+        // Returns false when the file cannot be opened or is not a regular file
+        bool open(const char* path);
+
+        // The size when the file was opened
+        std::size_t size() const { return size_; }
+
+        // Reads up to size bytes into dest and sets size to the number read;
+        // false on a read error
+        bool read(char* dest, std::size_t& size);
+
+    private:
+#if defined(_WIN32)
+        void* handle_{};
+#else
+        int fd_{-1};
+#endif
+        std::size_t size_{};
+    };
+
+    // A read-only memory mapping of a whole file
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        // Returns false and leaves the object empty when the file cannot be mapped
+        bool open(const char* path);
+
+        void close();
+
+        std::string_view view() const { return {data_, size_}; }
+
+        bool contains(const char* ptr) const { return ptr >= data_ && ptr < data_ + size_; }
+
+    private:
+        const char* data_{""};
+        std::size_t size_{};
+#if defined(_WIN32)
+        void* mapping_{};
+#endif
+    };
+}
+
+#endif // mapped_file_h__
@@ -0,0 +1,116 @@
+#include "parse_storage.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cliap::detail
+{
+    namespace {
+        constexpr std::size_t min_chunk_size = 4096;
+    }
+
+    StringArena::StringArena(std::pmr::memory_resource* resource)
+        : resource_{resource}, chunks_{resource}
+    {
+    }
+
+    StringArena::~StringArena()
+    {
+        for (const auto& chunk : chunks_)
+            release(chunk);
+    }
+
+    std::string_view StringArena::store(std::string_view text)
+    {
+        char* const dest = allocate(text.size());
+        if (!text.empty())
+            std::memcpy(dest, text.data(), text.size());
+
+        return {dest, text.size()};
+    }
+
+    std::string_view StringArena::store_c_str(std::string_view text)
+    {
+        char* const dest = allocate(text.size() + 1);
+        if (!text.empty())
+            std::memcpy(dest, text.data(), text.size());
+        dest[text.size()] = '\0';
+
+        return {dest, text.size()};
+    }
+
+    std::optional<std::string_view> StringArena::store_file(const char* path)
+    {
+        FileReader file;
+        if (!file.open(path))
+            return {};
+
+        auto size = file.size();
+        char* const dest = allocate(size);
+        if (!file.read(dest, size))
+            return {};
+
+        return std::string_view{dest, size};
+    }
+
+    bool StringArena::contains(const char* ptr) const
+    {
+        return std::any_of(chunks_.begin(), chunks_.end(), [ptr](const Chunk& chunk) {
+            return ptr >= chunk.data && ptr < chunk.data + chunk.size;
+        });
+    }
+
+    void StringArena::clear()
+    {
+        // Chunks are merged into one as large as all of them, so that a
+        // parse storing as much as the last one allocates nothing
+        if (chunks_.size() > 1) {
+            std::size_t total = 0;
+            for (const auto& chunk : chunks_)
+                total += chunk.size;
+
+            const Chunk merged{static_cast<char*>(resource_->allocate(total, 1)), total};
+            for (const auto& chunk : chunks_)
+                release(chunk);
+            chunks_.assign(1, merged);
+        }
+
+        used_ = 0;
+    }
+
+    char* StringArena::allocate(std::size_t size)
+    {
+        if (chunks_.empty() || chunks_.back().size - used_ < size) {
+            // Growing geometrically keeps the chunk count logarithmic
+            const auto chunk_size = std::max({min_chunk_size, size, chunks_.empty() ? 0 : chunks_.back().size * 2});
+            chunks_.push_back({static_cast<char*>(resource_->allocate(chunk_size, 1)), chunk_size});
+            used_ = 0;
+        }
+
+        char* const dest = chunks_.back().data + used_;
+        used_ += size;
+        return dest;
+    }
+
+    void StringArena::release(const Chunk& chunk)
+    {
+        resource_->deallocate(chunk.data, chunk.size, 1);
+    }
+
+    bool ParseStorage::contains(const char* ptr) const
+    {
+        return arena.contains(ptr);
+    }
+
+    void ParseStorage::clear()
+    {
+        arena.clear();
+        sources.clear();
+    }
+
+    std::shared_ptr<ParseStorage> make_parse_storage(std::pmr::memory_resource* resource)
+    {
+        // The control block comes from the resource as well
+        return std::allocate_shared<ParseStorage>(std::pmr::polymorphic_allocator<ParseStorage>{resource}, resource);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef parse_storage_h__
+#define parse_storage_h__
+
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cliap::detail {
+    // Append-only storage for strings that must outlive a parse. Chunks are
+    // never moved, so returned views stay valid until the arena is cleared or
+    // destroyed.
+    class StringArena {
+    public:
+        explicit StringArena(std::pmr::memory_resource* resource);
+        ~StringArena();
+
+        StringArena(const StringArena&) = delete;
+        StringArena& operator=(const StringArena&) = delete;
+
+        std::string_view store(std::string_view text);
+
+        // Stores text followed by a null character, which the returned view
+        // does not include
+        std::string_view store_c_str(std::string_view text);
+
+        // Stores the contents of a whole file as it is read, so that they
+        // stay the same whatever happens to the file later; nothing when the
+        // file cannot be read
+        std::optional<std::string_view> store_file(const char* path);
+
+        bool contains(const char* ptr) const;
+
+        // Forgets all stored strings but keeps their space, in one chunk,
+        // for reuse
+        void clear();
+
+    private:
+        struct Chunk {
+            char* data;
+            std::size_t size;
+        };
+
+        char* allocate(std::size_t size);
+
+        void release(const Chunk& chunk);
+
+        std::pmr::memory_resource* resource_;
+        std::pmr::vector<Chunk> chunks_;
+        std::size_t used_{};
+    };
+
+    // Everything parsed values may point into besides borrowed argv: copies
+    // of the values and of whole files, and unescaped tokens. All of it is allocated from one memory
+    // resource, the one of the ParseResult that owns the storage.
+    struct ParseStorage {
+        // A command string or response file being tokenized; the path is
+        // empty for the command string
+        struct Source {
+            std::string_view path;
+            std::string_view rest;
+        };
+
+        explicit ParseStorage(std::pmr::memory_resource* resource)
+            : arena{resource}, sources{resource}, scratch{resource} {}
+
+        StringArena arena;
+
+        // Working buffers of the tokenizer, kept here so that later parses
+        // reuse them
+        std::pmr::vector<Source> sources;
+        std::pmr::string scratch;
+
+        bool contains(const char* ptr) const;
+
+        void clear();
+    };
+
+    std::shared_ptr<ParseStorage> make_parse_storage(std::pmr::memory_resource* resource);
+}
+
+#endif // parse_storage_h__
@@ -0,0 +1,118 @@
+#include "snapshot_format.h"
+
+namespace cliap::detail
+{
+    namespace {
+        constexpr std::string_view snapshot_magic = "CLAS";
+
+        template<typename T>
+        void write_le(std::string& out, T value)
+        {
+            for (std::size_t i = 0; i < sizeof(T); ++i)
+                out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+
+        template<typename T>
+        T read_le(std::string_view bytes)
+        {
+            T value{};
+            for (std::size_t i = 0; i < sizeof(T); ++i)
+                value |= static_cast<T>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+            return value;
+        }
+
+        void write_varint(std::string& out, std::uint64_t value)
+        {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+    }
+
+    void write_snapshot_header(std::string& out, const SnapshotHeader& header)
+    {
+        out.append(snapshot_magic);
+        write_le(out, header.version);
+        write_le(out, header.schema_hash);
+        write_le(out, header.arg_count);
+    }
+
+    void write_snapshot_arg(std::string& out, ValueSource source, bool is_parsed, ValueRange values)
+    {
+        out.push_back(static_cast<char>(source));
+        out.push_back(static_cast<char>(is_parsed));
+        write_varint(out, values.size());
+        for (const auto value : values) {
+            write_varint(out, value.size());
+            out.append(value);
+        }
+    }
+
+    bool SnapshotReader::header(SnapshotHeader& header)
+    {
+        std::string_view magic, version, schema_hash, arg_count;
+        if (!bytes(snapshot_magic.size(), magic) || magic != snapshot_magic)
+            return false;
+        if (!bytes(4, version) || !bytes(8, schema_hash) || !bytes(4, arg_count))
+            return false;
+
+        header.version = read_le<std::uint32_t>(version);
+        header.schema_hash = read_le<std::uint64_t>(schema_hash);
+        header.arg_count = read_le<std::uint32_t>(arg_count);
+        return true;
+    }
+
+    bool SnapshotReader::arg(ValueSource& source, bool& is_parsed, std::size_t& value_count)
+    {
+        std::string_view fields;
+        std::uint64_t count;
+        if (!bytes(2, fields) || !varint(count))
+            return false;
+
+        const auto source_value = static_cast<unsigned char>(fields[0]);
+        const auto parsed_value = static_cast<unsigned char>(fields[1]);
+        if (source_value > static_cast<unsigned char>(ValueSource::command_line) || parsed_value > 1)
+            return false;
+
+        // Every value takes at least its size byte
+        if (count > rest_.size())
+            return false;
+
+        source = static_cast<ValueSource>(source_value);
+        is_parsed = parsed_value != 0;
+        value_count = static_cast<std::size_t>(count);
+        return true;
+    }
+
+    bool SnapshotReader::value(std::string_view& value)
+    {
+        std::uint64_t size;
+        return varint(size) && size <= rest_.size() && bytes(static_cast<std::size_t>(size), value);
+    }
+
+    bool SnapshotReader::bytes(std::size_t size, std::string_view& out)
+    {
+        if (size > rest_.size())
+            return false;
+
+        out = rest_.substr(0, size);
+        rest_.remove_prefix(size);
+        return true;
+    }
+
+    bool SnapshotReader::varint(std::uint64_t& value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64 && !rest_.empty(); shift += 7) {
+            const auto byte = static_cast<unsigned char>(rest_.front());
+            rest_.remove_prefix(1);
+
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+}
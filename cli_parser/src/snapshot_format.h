@@ -0,0 +1,56 @@
+#ifndef snapshot_format_h__
+#define snapshot_format_h__
+
+#include "cli_parser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cliap::detail {
+    // The layout of ArgParser::save_snapshot(), integers little-endian:
+    //
+    //     "CLAS" | u32 version | u64 schema hash | u32 arg count
+    //     per arg: u8 source | u8 parsed | varint value count
+    //              per value: varint size | bytes
+    //
+    // Varints take 7 bits per byte, low bits first, the high bit set on all
+    // bytes but the last.
+    constexpr std::uint32_t snapshot_version = 1;
+
+    struct SnapshotHeader {
+        std::uint32_t version{};
+        std::uint64_t schema_hash{};
+        std::uint32_t arg_count{};
+    };
+
+    void write_snapshot_header(std::string& out, const SnapshotHeader& header);
+
+    void write_snapshot_arg(std::string& out, ValueSource source, bool is_parsed, ValueRange values);
+
+    // Reads a snapshot field by field, never past its end. Values are views
+    // into the snapshot.
+    class SnapshotReader {
+    public:
+        explicit SnapshotReader(std::string_view snapshot) : rest_{snapshot} {}
+
+        // False when the snapshot does not start with the magic and a header
+        bool header(SnapshotHeader& header);
+
+        bool arg(ValueSource& source, bool& is_parsed, std::size_t& value_count);
+
+        bool value(std::string_view& value);
+
+        bool at_end() const { return rest_.empty(); }
+
+    private:
+        bool bytes(std::size_t size, std::string_view& out);
+
+        bool varint(std::uint64_t& value);
+
+        std::string_view rest_;
+    };
+}
+
+#endif // snapshot_format_h__
@@ -0,0 +1,109 @@
+#include "suggest.h"
+
+#include <algorithm>
+
+namespace cliap::detail
+{
+    NameSuggester::NameSuggester(std::string_view key)
+        : key_{key}
+    {
+        // A single character has no typo distinguishable from another name
+        if (key_.size() < 2 || key_.size() > 64)
+            return;
+
+        for (std::size_t i = 0; i < key_.size(); ++i)
+            peq_[static_cast<unsigned char>(key_[i])] |= std::uint64_t{1} << i;
+
+        // Roughly one edit in three characters still reads as a typo
+        max_distance_ = (key_.size() + 2) / 3;
+    }
+
+    void NameSuggester::add(const std::pmr::vector<Arg>& args)
+    {
+        for (const auto& arg : args) {
+            add(arg.short_name_view(), false);
+            add(arg.long_name_view(), true);
+        }
+    }
+
+    void NameSuggester::add(std::string_view name, bool is_long)
+    {
+        if (max_distance_ == 0 || name.empty())
+            return;
+
+        // Lower bounds of the distance: the difference in length, and one
+        // edit when the names start differently
+        auto bound = name.size() > key_.size() ? name.size() - key_.size() : key_.size() - name.size();
+        if (bound == 0 && name.front() != key_.front())
+            bound = 1;
+
+        if (bound > max_distance_)
+            return;
+
+        const auto found = distance(name);
+        if (found > max_distance_)
+            return;
+
+        if (found < max_distance_ || count_ == 0) {
+            // Closer than anything so far: only names this close count from now on
+            max_distance_ = found;
+            count_ = 0;
+        }
+
+        if (count_ < best_.size())
+            best_[count_++] = {name, is_long};
+    }
+
+    std::size_t NameSuggester::distance(std::string_view text) const
+    {
+        const auto m = key_.size();
+        const std::uint64_t last = std::uint64_t{1} << (m - 1);
+
+        // Vertical deltas of the current column, all +1 in the first one
+        std::uint64_t pv = ~std::uint64_t{0};
+        std::uint64_t mv = 0;
+        std::size_t score = m;
+
+        for (const char ch : text) {
+            const auto eq = peq_[static_cast<unsigned char>(ch)];
+            const auto xv = eq | mv;
+            const auto xh = (((eq & pv) + pv) ^ pv) | eq;
+
+            auto ph = mv | ~(xh | pv);
+            auto mh = pv & xh;
+
+            if (ph & last)
+                ++score;
+            else if (mh & last)
+                --score;
+
+            // The first row grows by one per character of text
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+        }
+
+        return score;
+    }
+
+    std::string NameSuggester::message(bool with_dashes) const
+    {
+        if (count_ == 0)
+            return {};
+
+        std::string text{"Did you mean "};
+
+        for (std::size_t i = 0; i < count_; ++i) {
+            if (i > 0)
+                text += i + 1 == count_ ? " or " : ", ";
+            if (with_dashes)
+                text += best_[i].is_long ? "--" : "-";
+            text += best_[i].name;
+        }
+
+        text += '?';
+        return text;
+    }
+}
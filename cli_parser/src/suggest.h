@@ -0,0 +1,54 @@
+#ifndef suggest_h__
+#define suggest_h__
+
+#include "cli_parser.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cliap::detail {
+    // Finds the registered names closest to a misspelled one by Levenshtein
+    // distance. The distance is computed with Myers' bit-parallel algorithm
+    // (in Hyyrö's formulation), one machine word per name, after cheaper
+    // bounds from the length difference and the first character have ruled
+    // out most names. Only the closest names are kept, and every name found
+    // lowers the bar for the next ones.
+    class NameSuggester {
+    public:
+        static constexpr std::size_t max_suggestions = 3;
+
+        // Keys of one character or longer than a machine word get no
+        // suggestions
+        explicit NameSuggester(std::string_view key);
+
+        // Considers the short and long names of args
+        void add(const std::pmr::vector<Arg>& args);
+
+        // Considers a single name
+        void add(std::string_view name, bool is_long);
+
+        // "Did you mean --port?" or an empty string when nothing is close;
+        // names are written with their dashes when with_dashes is set
+        std::string message(bool with_dashes) const;
+
+        std::size_t distance(std::string_view text) const;
+
+    private:
+        struct Candidate {
+            std::string_view name;
+            bool is_long;
+        };
+
+        std::string_view key_;
+        // Bit i of peq_[c] is set when key_[i] == c
+        std::array<std::uint64_t, 256> peq_{};
+        std::size_t max_distance_{};
+        std::array<Candidate, max_suggestions> best_{};
+        std::size_t count_{};
+    };
+}
+
+#endif // suggest_h__
@@ -0,0 +1,141 @@
+#include <doctest.h>
+
+#include <cli_batch.h>
+#include <cli_parser.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+    std::shared_ptr<const cliap::ArgSchema> make_schema()
+    {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg("p,port").required())
+            .add_parameter(cliap::Arg("v,verbose").flag())
+            .add_parameter(cliap::Arg("I,include").repeated())
+            .add_parameter(cliap::Arg("input").positional());
+        return cli_parser.schema();
+    }
+
+    // Every seventh line lacks the required port, every thirteenth is blank
+    std::string make_manifest(std::size_t lines)
+    {
+        std::string text;
+        for (std::size_t number = 1; number <= lines; ++number) {
+            if (number % 13 == 0)
+                text += "  ";
+            else if (number % 7 == 0)
+                text += "tool -I 'dir " + std::to_string(number) + "'";
+            else
+                text += "tool --port " + std::to_string(number) + " -v input.txt";
+            text += number % 2 ? "\n" : "\r\n";
+        }
+        return text;
+    }
+
+    struct Line {
+        std::size_t number;
+        std::string text;
+        std::string error;
+    };
+}
+
+TEST_SUITE("Testing cliap::BatchValidator" * doctest::description("Batch validation tests")) {
+    TEST_CASE("Testing lines handed out in input order") {
+        constexpr std::size_t line_count = 3000;
+        const auto manifest = make_manifest(line_count);
+
+        for (const unsigned threads : {1u, 2u, 8u}) {
+            CAPTURE(threads);
+            const cliap::BatchValidator validator{make_schema(), {threads, 256}};
+
+            std::vector<Line> lines;
+            const auto summary = validator.validate(manifest, [&lines](const cliap::BatchLine& line) {
+                lines.push_back({line.number, std::string{line.text}, line.error ? std::string{*line.error} : ""s});
+            });
+
+            std::size_t expected_lines = 0, expected_errors = 0;
+            std::size_t next = 0;
+            for (std::size_t number = 1; number <= line_count; ++number) {
+                if (number % 13 == 0)
+                    continue;
+
+                ++expected_lines;
+                REQUIRE(next < lines.size());
+                const auto& line = lines[next++];
+                CHECK(line.number == number);
+                CHECK(line.text.back() != '\r');
+                if (number % 7 == 0) {
+                    ++expected_errors;
+                    CHECK(line.text == "tool -I 'dir " + std::to_string(number) + "'");
+                    CHECK(line.error == "Expected required parameter value: p [port]");
+                } else {
+                    CHECK(line.error.empty());
+                }
+            }
+
+            CHECK(lines.size() == expected_lines);
+            CHECK(summary.lines == expected_lines);
+            CHECK(summary.errors == expected_errors);
+        }
+    }
+
+    TEST_CASE("Testing a text that is one chunk, or none") {
+        const cliap::BatchValidator validator{make_schema(), {4, 1 << 20}};
+
+        auto summary = validator.validate("tool --port 80\ntool --prot 80");
+        CHECK(summary.lines == 2);
+        CHECK(summary.errors == 1);
+
+        summary = validator.validate("");
+        CHECK(summary.lines == 0);
+        CHECK(summary.errors == 0);
+
+        summary = validator.validate("\n \n\t\n");
+        CHECK(summary.lines == 0);
+    }
+
+    TEST_CASE("Testing an exception thrown by the line handler") {
+        const cliap::BatchValidator validator{make_schema(), {4, 64}};
+        const auto manifest = make_manifest(1000);
+
+        std::size_t handled = 0;
+        CHECK_THROWS_AS(validator.validate(manifest, [&handled](const cliap::BatchLine& line) {
+            ++handled;
+            if (line.number == 100)
+                throw std::runtime_error("stop");
+        }), std::runtime_error);
+        CHECK(handled == 93);
+    }
+
+    TEST_CASE("Testing a manifest file") {
+        const auto path = std::filesystem::temp_directory_path() / "cliap_batch_manifest.txt";
+        {
+            std::ofstream out{path, std::ios::binary};
+            out << make_manifest(500);
+        }
+
+        const cliap::BatchValidator validator{make_schema(), {2, 512}};
+        std::vector<std::size_t> failed;
+        const auto summary = validator.validate_file(path.string(), [&failed](const cliap::BatchLine& line) {
+            if (!line.ok())
+                failed.push_back(line.number);
+        });
+        std::filesystem::remove(path);
+
+        CHECK(summary.lines == 500 - 500 / 13);
+        CHECK(summary.errors == failed.size());
+        REQUIRE(!failed.empty());
+        CHECK(failed.front() == 7);
+        CHECK(failed.back() == 497);
+
+        CHECK_THROWS_AS(validator.validate_file(path.string()), std::runtime_error);
+        CHECK_THROWS_AS(cliap::BatchValidator(nullptr), std::runtime_error);
+    }
+}
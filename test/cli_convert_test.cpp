@@ -0,0 +1,112 @@
+#include <doctest.h>
+
+#include <cli_convert.h>
+
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <string>
+
+using namespace std::string_literals;
+using namespace std::chrono_literals;
+
+namespace {
+    struct Point {
+        int x{};
+        int y{};
+    };
+
+    std::istream& operator>>(std::istream& in, Point& point) {
+        char comma{};
+        if (in >> point.x >> comma && comma != ',')
+            in.setstate(std::istream::failbit);
+        return in >> point.y;
+    }
+}
+
+TEST_SUITE("Testing cliap::convert" * doctest::description("Value conversion tests")) {
+    TEST_CASE("Testing integer conversion") {
+        CHECK(cliap::convert<int>("123456789").value == 123456789);
+        CHECK(cliap::convert<int>("-42").value == -42);
+        CHECK(cliap::convert<int>("+42").value == 42);
+        CHECK(cliap::convert<int>("0x1F").value == 31);
+        CHECK(cliap::convert<int>("-0x10").value == -16);
+        CHECK(cliap::convert<unsigned>("0o755").value == 0755u);
+        CHECK(cliap::convert<unsigned>("0b1010").value == 10u);
+        CHECK(cliap::convert<int>("010").value == 10);
+        CHECK(cliap::convert<std::int64_t>("-9223372036854775808").value == INT64_MIN);
+        CHECK(cliap::convert<std::uint64_t>("18446744073709551615").value == UINT64_MAX);
+    }
+
+    TEST_CASE("Testing integer conversion errors") {
+        CHECK(cliap::convert<int>("").error == cliap::ConvertError::empty);
+        CHECK(cliap::convert<int>("12abc").error == cliap::ConvertError::trailing_characters);
+        CHECK(cliap::convert<int>("12abc").value == 0);
+        CHECK(cliap::convert<int>("abc").error == cliap::ConvertError::invalid_format);
+        CHECK(cliap::convert<std::uint16_t>("65536").error == cliap::ConvertError::out_of_range);
+        CHECK(cliap::convert<std::int8_t>("-129").error == cliap::ConvertError::out_of_range);
+        CHECK(cliap::convert<std::int8_t>("-128").value == -128);
+        CHECK(cliap::convert<unsigned>("-1").error == cliap::ConvertError::invalid_format);
+        CHECK(cliap::convert<int>("0x").error == cliap::ConvertError::trailing_characters);
+        CHECK(cliap::convert<int>("--1").error == cliap::ConvertError::invalid_format);
+    }
+
+    TEST_CASE("Testing floating point and boolean conversion") {
+        CHECK(cliap::convert<double>("10.1").value == doctest::Approx(10.1));
+        CHECK(cliap::convert<float>("-2.5e3").value == doctest::Approx(-2500.0));
+        CHECK(cliap::convert<double>("+1").value == doctest::Approx(1.0));
+        CHECK(cliap::convert<double>("1.5x").error == cliap::ConvertError::trailing_characters);
+        CHECK(cliap::convert<double>("1e999").error == cliap::ConvertError::out_of_range);
+
+        CHECK(cliap::convert<bool>("true").value);
+        CHECK(cliap::convert<bool>("YES").value);
+        CHECK(cliap::convert<bool>("on").value);
+        CHECK(!cliap::convert<bool>("Off").value);
+        CHECK(cliap::convert<bool>("0"));
+        CHECK(!cliap::convert<bool>("maybe"));
+    }
+
+    TEST_CASE("Testing character and string conversion") {
+        CHECK(cliap::convert<char>("a").value == 'a');
+        CHECK(cliap::convert<char>("ab").error == cliap::ConvertError::trailing_characters);
+        CHECK(cliap::convert<std::string>("hello world").value == "hello world"s);
+        CHECK(cliap::convert<std::string>("").error == cliap::ConvertError::none);
+    }
+
+    TEST_CASE("Testing user type conversion through operator>>") {
+        const auto point = cliap::convert<Point>("3,4");
+        CHECK(point.error == cliap::ConvertError::none);
+        CHECK(point.value.x == 3);
+        CHECK(point.value.y == 4);
+        CHECK(cliap::convert<Point>("3;4").error == cliap::ConvertError::invalid_format);
+        CHECK(cliap::convert<Point>("3,4z").error == cliap::ConvertError::trailing_characters);
+        CHECK(cliap::convert<Point>("3,4z").value.x == 0);
+    }
+
+    TEST_CASE("Testing size suffixes") {
+        CHECK(cliap::parse_size("512").value == 512u);
+        CHECK(cliap::parse_size("512B").value == 512u);
+        CHECK(cliap::parse_size("64MiB").value == 64u * 1024 * 1024);
+        CHECK(cliap::parse_size("64M").value == 64u * 1024 * 1024);
+        CHECK(cliap::parse_size("10kB").value == 10000u);
+        CHECK(cliap::parse_size("1.5G").value == 1536u * 1024 * 1024);
+        CHECK(cliap::parse_size("2 GB").value == 2000000000u);
+        CHECK(cliap::parse_size("16EiB").error == cliap::ConvertError::out_of_range);
+        CHECK(cliap::parse_size("3Q").error == cliap::ConvertError::unknown_suffix);
+        CHECK(cliap::parse_size("MiB").error == cliap::ConvertError::invalid_format);
+        CHECK(cliap::parse_size("-1K").error == cliap::ConvertError::invalid_format);
+    }
+
+    TEST_CASE("Testing duration suffixes") {
+        CHECK(cliap::parse_duration("250ms").value == 250ms);
+        CHECK(cliap::parse_duration("2h").value == 2h);
+        CHECK(cliap::parse_duration("1h30m").value == 90min);
+        CHECK(cliap::parse_duration("1.5s").value == 1500ms);
+        CHECK(cliap::parse_duration("10us").value == 10us);
+        CHECK(cliap::parse_duration("-5s").value == -5s);
+        CHECK(cliap::parse_duration("0").value == 0s);
+        CHECK(cliap::parse_duration("10").error == cliap::ConvertError::invalid_format);
+        CHECK(cliap::parse_duration("10y").error == cliap::ConvertError::unknown_suffix);
+        CHECK(cliap::parse_duration("1000000d").error == cliap::ConvertError::out_of_range);
+    }
+}
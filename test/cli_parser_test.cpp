@@ -4,10 +4,110 @@
 
 #include <cli_parser.h>
 
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
 
 using namespace std::string_literals;
 
+namespace {
+    // Per thread, so that tests which parse on worker threads do not race on it
+    thread_local std::size_t allocation_count{};
+
+    // A file in the temp directory that is removed at the end of the test
+    struct TempFile {
+        std::filesystem::path path;
+
+        TempFile(const std::string& name, const std::string& contents)
+            : path{std::filesystem::temp_directory_path() / name}
+        {
+            std::ofstream{path, std::ios::binary} << contents;
+        }
+
+        ~TempFile() { std::filesystem::remove(path); }
+
+        std::string arg() const { return "@" + path.string(); }
+    };
+
+    // An environment variable that is unset at the end of the test
+    struct TempEnv {
+        std::string name;
+
+        TempEnv(const std::string& name, const std::string& value)
+            : name{name}
+        {
+#if defined(_WIN32)
+            _putenv_s(name.c_str(), value.c_str());
+#else
+            setenv(name.c_str(), value.c_str(), 1);
+#endif
+        }
+
+        ~TempEnv()
+        {
+#if defined(_WIN32)
+            _putenv_s(name.c_str(), "");
+#else
+            unsetenv(name.c_str());
+#endif
+        }
+    };
+}
+
+// Kept out of line for the same reason as in the benchmarks: inlined by LTO,
+// they make GCC report a false -Wmismatched-new-delete
+#if defined(__GNUC__) || defined(__clang__)
+#define TEST_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define TEST_NOINLINE __declspec(noinline)
+#else
+#define TEST_NOINLINE
+#endif
+
+TEST_NOINLINE void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+TEST_NOINLINE void operator delete(void* ptr) noexcept { std::free(ptr); }
+TEST_NOINLINE void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+// The default memory resource of std::pmr allocates through the aligned forms
+TEST_NOINLINE void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    ++allocation_count;
+    const auto align = static_cast<std::size_t>(alignment);
+#if defined(_MSC_VER)
+    if (void* ptr = _aligned_malloc(size ? size : 1, align))
+        return ptr;
+#else
+    if (void* ptr = std::aligned_alloc(align, (size + align) / align * align))
+        return ptr;
+#endif
+    throw std::bad_alloc{};
+}
+
+#if defined(_MSC_VER)
+TEST_NOINLINE void operator delete(void* ptr, std::align_val_t) noexcept { _aligned_free(ptr); }
+TEST_NOINLINE void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { _aligned_free(ptr); }
+#else
+TEST_NOINLINE void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+TEST_NOINLINE void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+#endif
+
 TEST_SUITE("Testing cliap::Arg" * doctest::description("Class cliap::Arg tests")) {
     TEST_CASE("Testing cliap::Arg class construction with values") {
         const auto parm{cliap::Arg()
@@ -60,6 +160,21 @@ TEST_SUITE("Testing cliap::Arg" * doctest::description("Class cliap::Arg tests")
         parm.value("abcd"s);
         CHECK(parm.get_value_as_str() == "abcd"s);
     }
+
+    TEST_CASE("Testing cliap::Arg class checked and unit conversions") {
+        using namespace std::chrono_literals;
+        cliap::Arg parm;
+
+        parm.value("8080x"s);
+        CHECK(parm.get_value_as<int>() == 0);
+        CHECK(parm.try_get_value_as<int>().error == cliap::ConvertError::trailing_characters);
+
+        parm.value("64MiB"s);
+        CHECK(parm.get_value_as_size().value == 64u * 1024 * 1024);
+
+        parm.value("250ms"s);
+        CHECK(parm.get_value_as_duration().value == 250ms);
+    }
 }
 
 TEST_SUITE("Testing cliap::ArgParser" * doctest::description("Class cliap::ArgParser tests")) {
@@ -88,15 +203,53 @@ TEST_SUITE("Testing cliap::ArgParser" * doctest::description("Class cliap::ArgPa
             cli_parser.add_parameter(cliap::Arg().short_name("-h").long_name("--hhhh"));
 
             REQUIRE(cli_parser.parameters_count() == 1);
-            REQUIRE(cli_parser.all_params()[0]->long_name() == "hhhh");
+            REQUIRE(cli_parser.all_params()[0].long_name() == "hhhh");
         }
         SUBCASE("Checking the number of parameters added with partial duplication (long keys)") {
             cli_parser.add_parameter(cliap::Arg().short_name("-h").long_name("--help"));
             cli_parser.add_parameter(cliap::Arg().short_name("-a").long_name("--help"));
 
             REQUIRE(cli_parser.parameters_count() == 1);
-            REQUIRE(cli_parser.all_params()[0]->short_name() == "a");
+            REQUIRE(cli_parser.all_params()[0].short_name() == "a");
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser registry order and lookups") {
+        cliap::ArgParser cli_parser;
+
+        for (int i = 0; i < 200; ++i)
+            cli_parser.add_parameter(cliap::Arg().long_name("--option-" + std::to_string(i)).description("option " + std::to_string(i)));
+
+        REQUIRE(cli_parser.parameters_count() == 200);
+
+        for (int i = 0; i < 200; ++i) {
+            CHECK(cli_parser.all_params()[i].long_name() == "option-" + std::to_string(i));
+            CHECK(cli_parser.arg("option-" + std::to_string(i)).description() == "option " + std::to_string(i));
         }
+
+        CHECK(cli_parser.arg("option-200").long_name().empty());
+    }
+
+    TEST_CASE("Testing cliap::ArgParser replacing args that share names") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-a").long_name("--alpha").required())
+            .add_parameter(cliap::Arg().short_name("-b").long_name("--beta").required())
+            .add_parameter(cliap::Arg().short_name("-c").long_name("--gamma"));
+
+        // Shares "a" with the first arg and "beta" with the second one
+        cli_parser.add_parameter(cliap::Arg().short_name("-a").long_name("--beta").description("merged"));
+
+        REQUIRE(cli_parser.parameters_count() == 2);
+        CHECK(cli_parser.all_params()[0].description() == "merged"s);
+        CHECK(cli_parser.all_params()[1].long_name() == "gamma"s);
+        CHECK(cli_parser.arg("alpha").long_name().empty());
+        CHECK(cli_parser.arg("b").long_name().empty());
+        CHECK(cli_parser.arg("beta").short_name() == "a"s);
+        CHECK(cli_parser.arg("c").long_name() == "gamma"s);
+
+        std::vector<std::string> args{"program.exe"};
+        CHECK(!cli_parser.parse(args));
     }
 
     TEST_CASE("Testing cliap::ArgParser reset() method") {
@@ -172,5 +325,1502 @@ TEST_SUITE("Testing cliap::ArgParser" * doctest::description("Class cliap::ArgPa
 
         cli_parser.print_help();
     }
+
+    TEST_CASE("Testing cliap::ArgParser help text") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required().default_value("8080").description("listen port"))
+            .add_parameter(cliap::Arg().long_name("--log-level").description("how much to log: one of error, warning, info or debug"))
+            .add_parameter(cliap::Arg().short_name("-v").flag().description("verbose output"));
+        cli_parser.add_usage_string("program.exe --port=<port>");
+
+        SUBCASE("Columns line up and long descriptions wrap") {
+            const auto text = cli_parser.help_text(60);
+            CHECK(text ==
+                "Usage:\n"
+                "    program.exe --port=<port>\n"
+                "\n"
+                "    -p [ --port      ] listen port [required]\n"
+                "                       (default: 8080)\n"
+                "       [ --log-level ] how much to log: one of error,\n"
+                "                       warning, info or debug\n"
+                "    -v [             ] verbose output\n");
+
+            for (std::size_t pos = 0, end; (end = text.find('\n', pos)) != std::string_view::npos; pos = end + 1)
+                CHECK(end - pos <= 60);
+        }
+
+        SUBCASE("The text is cached until the parser changes") {
+            const auto text = cli_parser.help_text(60);
+
+            const auto before = allocation_count;
+            CHECK(cli_parser.help_text(60).data() == text.data());
+            CHECK(allocation_count == before);
+
+            std::ostringstream out;
+            cli_parser.print_help(out, 60);
+            CHECK(out.str() == text);
+
+            cli_parser.add_parameter(cliap::Arg().short_name("-q").description("quiet"));
+            CHECK(cli_parser.help_text(60).find("quiet") != std::string_view::npos);
+
+            cli_parser.reset();
+            CHECK(cli_parser.help_text(60) == "Usage:\n\n");
+        }
+
+        SUBCASE("A narrow width still keeps one word per line") {
+            const auto text = cli_parser.help_text(1);
+            CHECK(text.find("listen port [required] (default: 8080)") != std::string_view::npos);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser parse(argc, argv) copies values unless told to borrow argv") {
+        char prog[] = "program.exe", port[] = "--port=8080", key[] = "-a", addr[] = "127.0.0.1";
+        char* argv[] = {prog, port, key, addr};
+
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-a").long_name("--ip-address").required());
+
+        SUBCASE("Values outlive changes to argv") {
+            REQUIRE(!cli_parser.parse(4, argv));
+
+            std::strcpy(port, "--port=9999");
+            std::strcpy(addr, "10.0.0.10");
+            CHECK(cli_parser.arg("port").value() == "8080"s);
+            CHECK(cli_parser.arg("a").value() == "127.0.0.1"s);
+        }
+
+        SUBCASE("Borrowed values are views into argv") {
+            cli_parser.borrow_argv();
+            REQUIRE(!cli_parser.parse(4, argv));
+
+            CHECK(cli_parser.arg("port").value_view().data() == port + 7);
+            CHECK(cli_parser.arg("a").value_view().data() == addr);
+            CHECK(cli_parser.arg("a").value() == "127.0.0.1"s);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser parse(argc, argv) allocations do not grow with argc") {
+        std::vector<std::string> storage{"program.exe"};
+        for (int i = 0; i < 1000; ++i)
+            storage.emplace_back(i % 2 ? "--a-rather-long-option-name-for-flag" : "--port=8080");
+
+        std::vector<char*> argv;
+        for (auto& str : storage)
+            argv.push_back(str.data());
+
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-f").long_name("--a-rather-long-option-name-for-flag").flag());
+
+        // Creates the storage values are copied into
+        REQUIRE(!cli_parser.parse(11, argv.data()));
+
+        auto before = allocation_count;
+        const auto small_error = cli_parser.parse(11, argv.data());
+        const auto small_allocs = allocation_count - before;
+
+        before = allocation_count;
+        const auto large_error = cli_parser.parse(static_cast<int>(argv.size()), argv.data());
+        const auto large_allocs = allocation_count - before;
+
+        CHECK(!small_error);
+        CHECK(!large_error);
+        CHECK(large_allocs == small_allocs);
+    }
+
+    TEST_CASE("Testing cliap::ArgParser response files") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-n").long_name("--name"))
+            .add_parameter(cliap::Arg().short_name("-m").long_name("--message"))
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag())
+            .allow_response_files();
+
+        SUBCASE("Quoting, escapes and comments") {
+            const TempFile file{"cliap_rsp_quoting.rsp",
+                "# service options\n"
+                "--port 8080\r\n"
+                "--name 'single quoted'  --message \"say \\\"hi\\\" to $USER\"\n"
+                "-v\n"};
+
+            const std::vector<std::string> args{"program.exe", file.arg()};
+            REQUIRE(!cli_parser.parse(args));
+
+            CHECK(cli_parser.arg("port").get_value_as<int>() == 8080);
+            CHECK(cli_parser.arg("name").value() == "single quoted"s);
+            CHECK(cli_parser.arg("message").value() == "say \"hi\" to $USER"s);
+            CHECK(cli_parser.arg("verbose").is_parsed());
+        }
+
+        SUBCASE("Nested response files and argv overrides") {
+            const TempFile inner{"cliap_rsp_inner.rsp", "--name inner --port 1"};
+            const TempFile outer{"cliap_rsp_outer.rsp", "--port 2 " + inner.arg() + " --message outer"};
+
+            std::string rsp = outer.arg();
+            char prog[] = "program.exe", port[] = "--port=3";
+            char* argv[] = {prog, rsp.data(), port};
+
+            REQUIRE(!cli_parser.parse(3, argv));
+
+            CHECK(cli_parser.arg("name").value() == "inner"s);
+            CHECK(cli_parser.arg("message").value() == "outer"s);
+            CHECK(cli_parser.arg("port").value() == "3"s);
+        }
+
+        SUBCASE("Values of a large file survive the next parse") {
+            std::string contents;
+            for (int i = 0; i < 100000; ++i)
+                contents += "--port " + std::to_string(i) + "\n";
+
+            contents += "--name=from-file\n";
+
+            const TempFile file{"cliap_rsp_large.rsp", contents};
+            const std::vector<std::string> args{"program.exe", file.arg()};
+
+            REQUIRE(!cli_parser.parse(args));
+            CHECK(cli_parser.arg("port").get_value_as<int>() == 99999);
+            CHECK(cli_parser.arg("name").value() == "from-file"s);
+
+            const std::vector<std::string> second{"program.exe", "--port", "1"};
+            REQUIRE(!cli_parser.parse(second));
+            CHECK(cli_parser.arg("name").value() == "from-file"s);
+        }
+
+        SUBCASE("Values do not change when the file is rewritten or truncated") {
+            const TempFile file{"cliap_rsp_rewritten.rsp", "--port 8080 --name 'first name'\n"};
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", file.arg()}));
+
+            std::ofstream{file.path, std::ios::binary} << "--port 9999 --name 'XXXXX XXXX'\n";
+            CHECK(cli_parser.arg("port").value() == "8080"s);
+            CHECK(cli_parser.arg("name").value() == "first name"s);
+
+            std::filesystem::resize_file(file.path, 0);
+            CHECK(cli_parser.arg("port").value() == "8080"s);
+            CHECK(cli_parser.arg("name").value() == "first name"s);
+        }
+
+        SUBCASE("Errors") {
+            const TempFile unterminated{"cliap_rsp_unterminated.rsp", "--name 'oops"};
+            const auto error = cli_parser.parse(std::vector<std::string>{"program.exe", unterminated.arg()});
+            REQUIRE(error);
+            CHECK(error->find("Unterminated quote") != std::string::npos);
+
+            CHECK(cli_parser.parse(std::vector<std::string>{"program.exe", "@/nonexistent/cliap.rsp"}));
+
+            const auto self = std::filesystem::temp_directory_path() / "cliap_rsp_self.rsp";
+            const TempFile recursive{"cliap_rsp_self.rsp", "@" + self.string()};
+            const auto nested = cli_parser.parse(std::vector<std::string>{"program.exe", recursive.arg()});
+            REQUIRE(nested);
+            CHECK(nested->find("nested too deeply") != std::string::npos);
+        }
+
+        SUBCASE("Expansion is off unless allowed") {
+            cliap::ArgParser plain;
+            plain.add_parameter(cliap::Arg().short_name("-a").long_name("--address"));
+
+            REQUIRE(!plain.parse(std::vector<std::string>{"program.exe", "-a", "@host"}));
+            CHECK(plain.arg("a").value() == "@host"s);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser config files") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-n").long_name("--name").default_value("default"))
+            .add_parameter(cliap::Arg().long_name("--log.level").default_value("info"))
+            .add_parameter(cliap::Arg().short_name("-m").long_name("--message"))
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag());
+
+        SUBCASE("Sections, quoting and comments") {
+            const TempFile file{"cliap_config_syntax.ini",
+                "# service options\n"
+                "port = 8080   ; trailing comment\r\n"
+                "verbose = yes\n"
+                "message = \"say \\\"hi\\\"\\tnow\"  # comment\n"
+                "\n"
+                "[log]\n"
+                "level = 'debug #1'\n"};
+
+            cli_parser.add_config_file(file.path.string());
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe"}));
+
+            CHECK(cli_parser.arg("port").get_value_as<int>() == 8080);
+            CHECK(cli_parser.arg("port").source() == cliap::ValueSource::config_file);
+            CHECK(cli_parser.arg("verbose").is_parsed());
+            CHECK(cli_parser.arg("message").value() == "say \"hi\"\tnow"s);
+            CHECK(cli_parser.arg("log.level").value() == "debug #1"s);
+            CHECK(cli_parser.arg("name").value() == "default"s);
+            CHECK(cli_parser.arg("name").source() == cliap::ValueSource::default_value);
+            CHECK(cli_parser.arg("m").source() == cliap::ValueSource::config_file);
+        }
+
+        SUBCASE("Values do not change when the file is edited after the parse") {
+            const TempFile file{"cliap_config_edited.ini", "port = 8080\nname = first\nmessage = 'kept as is'\n"};
+            cli_parser.add_config_file(file.path.string());
+
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe"}));
+            const auto result = cli_parser.schema()->parse(std::vector<std::string>{"program.exe"});
+            REQUIRE(result.ok());
+
+            std::ofstream{file.path, std::ios::binary} << "port = 9999\nname = XXXXX\nmessage = 'XXXX XX XX'\n";
+            CHECK(cli_parser.arg("port").value() == "8080"s);
+            CHECK(cli_parser.arg("name").value() == "first"s);
+            CHECK(result.arg("message").value() == "kept as is"s);
+
+            std::filesystem::resize_file(file.path, 0);
+            CHECK(cli_parser.arg("name").value() == "first"s);
+            CHECK(cli_parser.arg("message").value() == "kept as is"s);
+            CHECK(result.arg("name").value() == "first"s);
+        }
+
+        SUBCASE("Precedence: defaults < earlier files < later files < argv") {
+            const TempFile base{"cliap_config_base.ini", "port = 1\nname = base\nmessage = base\n"};
+            const TempFile local{"cliap_config_local.ini", "port = 2\nname = local\n"};
+
+            cli_parser
+                .add_config_file(base.path.string())
+                .add_config_file(local.path.string())
+                .add_config_file("/nonexistent/cliap.ini", false);
+
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "--port", "3"}));
+
+            CHECK(cli_parser.arg("port").value() == "3"s);
+            CHECK(cli_parser.arg("port").source() == cliap::ValueSource::command_line);
+            CHECK(cli_parser.arg("name").value() == "local"s);
+            CHECK(cli_parser.arg("message").value() == "base"s);
+            CHECK(cli_parser.arg("message").source() == cliap::ValueSource::config_file);
+            CHECK(cli_parser.arg("log.level").source() == cliap::ValueSource::default_value);
+            CHECK(cli_parser.arg("verbose").source() == cliap::ValueSource::none);
+        }
+
+        SUBCASE("Thousands of keys") {
+            cliap::ArgParser large;
+            std::string contents;
+            for (int i = 0; i < 5000; ++i) {
+                const auto name = "key" + std::to_string(i);
+                large.add_parameter(cliap::Arg().long_name(name));
+                contents += name + " = " + std::to_string(i) + "\n";
+            }
+
+            const TempFile file{"cliap_config_large.ini", contents};
+            large.add_config_file(file.path.string());
+
+            REQUIRE(!large.parse(std::vector<std::string>{"program.exe"}));
+            CHECK(large.arg("key0").get_value_as<int>() == 0);
+            CHECK(large.arg("key4999").get_value_as<int>() == 4999);
+
+            // Values are views into the mapping until the next parse
+            const auto before = allocation_count;
+            REQUIRE(!large.parse(std::vector<std::string>{"program.exe"}));
+            CHECK(allocation_count - before < 16);
+            CHECK(large.arg("key1234").value() == "1234"s);
+        }
+
+        SUBCASE("Errors") {
+            const TempFile unknown{"cliap_config_unknown.ini", "port = 1\n\ncolour = red\n"};
+            cli_parser.add_config_file(unknown.path.string());
+            const auto error = cli_parser.parse(std::vector<std::string>{"program.exe"});
+            REQUIRE(error);
+            CHECK(error->find("line 3: unknown key colour") != std::string::npos);
+
+            cliap::ArgParser syntax;
+            syntax.add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag());
+
+            const TempFile bad_flag{"cliap_config_flag.ini", "verbose = maybe\n"};
+            syntax.add_config_file(bad_flag.path.string());
+            CHECK(syntax.parse(std::vector<std::string>{"program.exe"}));
+
+            syntax.reset();
+            syntax.add_parameter(cliap::Arg().long_name("--name"));
+            const TempFile unterminated{"cliap_config_quote.ini", "name = \"oops\n"};
+            syntax.add_config_file(unterminated.path.string());
+            const auto quote = syntax.parse(std::vector<std::string>{"program.exe"});
+            REQUIRE(quote);
+            CHECK(quote->find("unterminated string") != std::string::npos);
+
+            cliap::ArgParser missing;
+            missing.add_config_file("/nonexistent/cliap.ini");
+            CHECK(missing.parse(std::vector<std::string>{"program.exe"}));
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser environment variables") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .env_prefix("CLIAP_TEST_")
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-n").long_name("--name").default_value("default"))
+            .add_parameter(cliap::Arg().long_name("--log.level").default_value("info"))
+            .add_parameter(cliap::Arg().long_name("--dry-run").flag())
+            .add_parameter(cliap::Arg().short_name("-t").long_name("--token").env("CLIAP_TEST_SECRET"))
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag());
+
+        SUBCASE("Derived and explicit names") {
+            const TempEnv port{"CLIAP_TEST_PORT", "8080"};
+            const TempEnv level{"CLIAP_TEST_LOG_LEVEL", "debug"};
+            const TempEnv dry_run{"CLIAP_TEST_DRY_RUN", "on"};
+            const TempEnv secret{"CLIAP_TEST_SECRET", "s3cr3t"};
+            const TempEnv ignored{"CLIAP_TEST_TOKEN", "ignored"};
+            const TempEnv empty{"CLIAP_TEST_NAME", ""};
+
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe"}));
+
+            CHECK(cli_parser.arg("port").get_value_as<int>() == 8080);
+            CHECK(cli_parser.arg("port").source() == cliap::ValueSource::environment);
+            CHECK(cli_parser.arg("log.level").value() == "debug"s);
+            CHECK(cli_parser.arg("dry-run").is_parsed());
+            CHECK(cli_parser.arg("dry-run").source() == cliap::ValueSource::environment);
+            CHECK(cli_parser.arg("token").value() == "s3cr3t"s);
+            CHECK(cli_parser.arg("token").env() == "CLIAP_TEST_SECRET"s);
+            CHECK(cli_parser.arg("name").value() == "default"s);
+            CHECK(cli_parser.arg("name").source() == cliap::ValueSource::default_value);
+            CHECK(cli_parser.arg("verbose").source() == cliap::ValueSource::none);
+        }
+
+        SUBCASE("Precedence: defaults < config files < environment < argv") {
+            const TempFile file{"cliap_env_config.ini", "port = 1\nname = config\nlog.level = warn\n"};
+            const TempEnv port{"CLIAP_TEST_PORT", "2"};
+            const TempEnv name{"CLIAP_TEST_NAME", "env"};
+
+            cli_parser.add_config_file(file.path.string());
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "--port", "3"}));
+
+            CHECK(cli_parser.arg("port").value() == "3"s);
+            CHECK(cli_parser.arg("port").source() == cliap::ValueSource::command_line);
+            CHECK(cli_parser.arg("name").value() == "env"s);
+            CHECK(cli_parser.arg("name").source() == cliap::ValueSource::environment);
+            CHECK(cli_parser.arg("log.level").value() == "warn"s);
+            CHECK(cli_parser.arg("log.level").source() == cliap::ValueSource::config_file);
+        }
+
+        SUBCASE("Values are read on every parse, by schemas too") {
+            const auto schema = cli_parser.schema();
+            cliap::ParseResult result;
+            {
+                const TempEnv port{"CLIAP_TEST_PORT", "1"};
+                schema->parse_command_line("program.exe", result);
+                REQUIRE(result.ok());
+                CHECK(result.arg("port").value() == "1"s);
+            }
+
+            // Copied into the result, so unsetting it later changes nothing
+            CHECK(result.arg("port").value() == "1"s);
+            schema->parse_command_line("program.exe", result);
+            CHECK(!result.ok());
+
+            // A prefix set after the args were added renames them all
+            cli_parser.env_prefix("CLIAP_OTHER_");
+            const TempEnv port{"CLIAP_OTHER_PORT", "5"};
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe"}));
+            CHECK(cli_parser.arg("port").value() == "5"s);
+        }
+
+        SUBCASE("Errors") {
+            const TempEnv port{"CLIAP_TEST_PORT", "1"};
+            const TempEnv verbose{"CLIAP_TEST_VERBOSE", "maybe"};
+
+            const auto args = std::vector<std::string>{"program.exe"};
+            const auto error = cli_parser.try_parse(args);
+            REQUIRE(error);
+            CHECK(error.code() == cliap::ParseErrorCode::environment_invalid);
+            CHECK(error.subject() == "CLIAP_TEST_VERBOSE"s);
+            CHECK(error.arg() == &cli_parser.arg("verbose"));
+            CHECK(error.message() == "Environment variable error: CLIAP_TEST_VERBOSE: expected a boolean"s);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser snapshots") {
+        const auto make_parser = [](cliap::ArgParser& cli_parser, std::vector<int>* levels,
+                                    std::string_view name_default = "default", std::string_view port_description = "") {
+            cli_parser
+                .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required().description(port_description))
+                .add_parameter(cliap::Arg().short_name("-n").long_name("--name").default_value(name_default))
+                .add_parameter(cliap::Arg().short_name("-I").long_name("--include").repeated())
+                .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag())
+                .add_parameter(cliap::Arg().short_name("-q").long_name("--quiet").flag())
+                .add_parameter(cliap::Arg().long_name("--input").positional());
+            cli_parser.add_parameter_as(cliap::Arg().long_name("--level").repeated(), levels).range(0, 9);
+        };
+
+        const TempFile config{"cliap_snapshot.ini", "name = from-config\n"};
+
+        cliap::ArgParser supervisor;
+        std::vector<int> supervisor_levels;
+        make_parser(supervisor, &supervisor_levels);
+        supervisor.add_config_file(config.path.string());
+        REQUIRE(!supervisor.parse(std::vector<std::string>{"program.exe", "-p", "80", "-I", "a", "-I", "", "-I", "c d", "-v",
+            "--level", "3", "--level", "4", "input.txt"}));
+
+        const auto snapshot = supervisor.save_snapshot();
+
+        SUBCASE("Values, flags and sources come back as parsed") {
+            cliap::ArgParser worker;
+            std::vector<int> levels;
+            make_parser(worker, &levels);
+            CHECK(worker.all_params().size() == supervisor.all_params().size());
+
+            REQUIRE(!worker.load_snapshot(snapshot));
+
+            for (std::size_t i = 0; i < worker.all_params().size(); ++i) {
+                const auto& loaded = worker.all_params()[i];
+                const auto& parsed = supervisor.all_params()[i];
+                CAPTURE(parsed.long_name());
+                CHECK(loaded.value() == parsed.value());
+                CHECK(loaded.is_parsed() == parsed.is_parsed());
+                CHECK(loaded.source() == parsed.source());
+            }
+
+            CHECK(worker.arg("port").source() == cliap::ValueSource::command_line);
+            CHECK(worker.arg("name").value() == "from-config"s);
+            CHECK(worker.arg("name").source() == cliap::ValueSource::config_file);
+            CHECK(worker.arg("verbose").is_parsed());
+            CHECK(!worker.arg("quiet").is_parsed());
+            CHECK(worker.arg("input").value() == "input.txt"s);
+
+            const auto includes = worker.arg("include").values();
+            REQUIRE(includes.size() == 3);
+            CHECK(includes[0] == "a");
+            CHECK(includes[1].empty());
+            CHECK(includes[2] == "c d");
+
+            // Typed handles are filled in as after a parse
+            CHECK(levels == std::vector<int>{3, 4});
+        }
+
+        SUBCASE("Snapshots loaded from a file") {
+            const TempFile file{"cliap_snapshot.bin", snapshot};
+
+            cliap::ArgParser worker;
+            std::vector<int> levels;
+            make_parser(worker, &levels);
+            REQUIRE(!worker.load_snapshot_file(file.path.string()));
+            CHECK(worker.arg("port").value() == "80"s);
+            CHECK(worker.arg("include").values().size() == 3);
+
+            // The supervisor may reuse the file once it has been loaded
+            std::ofstream{file.path, std::ios::binary} << std::string(snapshot.size(), 'X');
+            CHECK(worker.arg("port").value() == "80"s);
+            CHECK(worker.arg("include").values()[2] == "c d");
+
+            std::filesystem::resize_file(file.path, 0);
+            CHECK(worker.arg("name").value() == "from-config"s);
+            CHECK(worker.arg("include").values()[0] == "a");
+
+            // A parse after a load replaces its values
+            REQUIRE(!worker.parse(std::vector<std::string>{"program.exe", "-p", "81", "-I", "x"}));
+            CHECK(worker.arg("port").value() == "81"s);
+            CHECK(worker.arg("include").values().size() == 1);
+
+            const auto error = worker.load_snapshot_file("/nonexistent/cliap.bin");
+            CHECK(error.code() == cliap::ParseErrorCode::snapshot_unreadable);
+            CHECK(error.message() == "Unable to open snapshot file: /nonexistent/cliap.bin"s);
+        }
+
+        SUBCASE("Snapshots of other args are rejected") {
+            cliap::ArgParser same;
+            std::vector<int> levels;
+            make_parser(same, &levels);
+            CHECK(same.schema()->hash() == supervisor.schema()->hash());
+
+            // Descriptions do not change how args parse
+            cliap::ArgParser described;
+            make_parser(described, &levels, "default", "listen port");
+            CHECK(described.schema()->hash() == supervisor.schema()->hash());
+
+            cliap::ArgParser other_default;
+            make_parser(other_default, &levels, "other");
+            CHECK(other_default.schema()->hash() != supervisor.schema()->hash());
+
+            cliap::ArgParser extended;
+            make_parser(extended, &levels);
+            extended.add_parameter(cliap::Arg().long_name("--extra"));
+
+            const auto error = extended.load_snapshot(snapshot);
+            CHECK(error.code() == cliap::ParseErrorCode::snapshot_mismatch);
+            CHECK(error.message() == "Snapshot of a parser with different args"s);
+            CHECK(extended.arg("port").source() == cliap::ValueSource::none);
+        }
+
+        SUBCASE("Damaged snapshots are rejected") {
+            cliap::ArgParser worker;
+            std::vector<int> levels;
+            make_parser(worker, &levels);
+
+            auto error = worker.load_snapshot("not a snapshot at all");
+            CHECK(error.code() == cliap::ParseErrorCode::snapshot_invalid);
+            CHECK(error.message() == "Invalid snapshot: not a snapshot"s);
+
+            for (std::size_t size = 0; size < snapshot.size(); ++size) {
+                CAPTURE(size);
+                CHECK(worker.load_snapshot(std::string_view{snapshot}.substr(0, size)).code() == cliap::ParseErrorCode::snapshot_invalid);
+            }
+
+            CHECK(worker.load_snapshot(snapshot + "x").message() == "Invalid snapshot: trailing data"s);
+
+            auto newer = snapshot;
+            newer[4] = 2;
+            CHECK(worker.load_snapshot(newer).message() == "Invalid snapshot: unsupported version"s);
+
+            REQUIRE(!worker.load_snapshot(snapshot));
+            CHECK(worker.arg("port").value() == "80"s);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser repeated and positional arguments") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-I").long_name("--include").repeated())
+            .add_parameter(cliap::Arg().short_name("-i").long_name("--input").multi_value())
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag())
+            .add_parameter(cliap::Arg().long_name("--output").positional())
+            .add_parameter(cliap::Arg().long_name("--files").positional().repeated());
+
+        SUBCASE("Repeated keys collect every value") {
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "-I", "dir", "--include=dir2", "-I", "dir3"}));
+
+            const auto includes = cli_parser.arg("include").values();
+            REQUIRE(includes.size() == 3);
+            CHECK(includes[0] == "dir");
+            CHECK(includes[1] == "dir2");
+            CHECK(includes.back() == "dir3");
+            CHECK(cli_parser.arg("I").value() == "dir3"s);
+
+            // Every parse collects afresh
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "-I", "other"}));
+            CHECK(cli_parser.arg("I").values().size() == 1);
+            CHECK(cli_parser.arg("I").values().front() == "other");
+
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe"}));
+            CHECK(cli_parser.arg("I").values().empty());
+            CHECK(!cli_parser.arg("I").is_parsed());
+        }
+
+        SUBCASE("Multi-value keys and positional args") {
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "--input", "a", "b", "c", "-v", "out", "f1", "f2"}));
+
+            std::vector<std::string_view> inputs;
+            for (const auto value : cli_parser.arg("input").values())
+                inputs.push_back(value);
+
+            CHECK(inputs == std::vector<std::string_view>{"a", "b", "c"});
+            CHECK(cli_parser.arg("verbose").is_parsed());
+            CHECK(cli_parser.arg("output").value() == "out"s);
+            CHECK(cli_parser.arg("files").values().size() == 2);
+            CHECK(cli_parser.arg("files").values()[1] == "f2");
+
+            const auto error = cli_parser.parse(std::vector<std::string>{"program.exe", "--input", "-v"});
+            REQUIRE(error);
+            CHECK(*error == "Expected value for the key: input"s);
+        }
+
+        SUBCASE("Double dash ends the options") {
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "-v", "--", "-out", "--files", "-"}));
+
+            CHECK(cli_parser.arg("output").value() == "-out"s);
+            CHECK(cli_parser.arg("files").values().size() == 2);
+            CHECK(cli_parser.arg("files").values()[0] == "--files");
+
+            cliap::ArgParser no_positional;
+            no_positional.add_parameter(cliap::Arg().short_name("-p").long_name("--port"));
+
+            const auto error = no_positional.parse(std::vector<std::string>{"program.exe", "--", "extra"});
+            REQUIRE(error);
+            CHECK(*error == "Unexpected positional argument: extra"s);
+
+            // Without positional args bare key=value tokens keep working
+            REQUIRE(!no_positional.parse(std::vector<std::string>{"program.exe", "port=1"}));
+            CHECK(no_positional.arg("port").value() == "1"s);
+        }
+
+        SUBCASE("Command-line values replace repeated values from config files") {
+            const TempFile file{"cliap_config_repeated.ini", "include = a\ninclude = b\n"};
+            cli_parser.add_config_file(file.path.string());
+
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe"}));
+            CHECK(cli_parser.arg("include").values().size() == 2);
+            CHECK(cli_parser.arg("include").source() == cliap::ValueSource::config_file);
+
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "-I", "c"}));
+            CHECK(cli_parser.arg("include").values().size() == 1);
+            CHECK(cli_parser.arg("include").values()[0] == "c");
+        }
+
+        SUBCASE("Large argv parses without per-value allocations") {
+            std::vector<std::string> storage{"program.exe"};
+            for (int i = 0; i < 1000; ++i)
+                storage.push_back(std::to_string(i));
+            storage.push_back("--input");
+            for (int i = 0; i < 100000; ++i)
+                storage.push_back("in" + std::to_string(i));
+
+            std::vector<char*> argv;
+            for (auto& str : storage)
+                argv.push_back(str.data());
+
+            REQUIRE(!cli_parser.parse(static_cast<int>(argv.size()), argv.data()));
+            CHECK(cli_parser.arg("input").values().size() == 100000);
+            CHECK(cli_parser.arg("output").value() == "0"s);
+            CHECK(cli_parser.arg("files").values().size() == 999);
+
+            // The collected views keep their capacity between parses, and the
+            // copied values fit in one chunk of storage from the second on
+            REQUIRE(!cli_parser.parse(static_cast<int>(argv.size()), argv.data()));
+            const auto before = allocation_count;
+            REQUIRE(!cli_parser.parse(static_cast<int>(argv.size()), argv.data()));
+            CHECK(allocation_count == before);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser typed handles") {
+        std::string mode;
+        std::vector<int> levels;
+
+        cliap::ArgParser cli_parser;
+        auto port = cli_parser.add_parameter_as<int>(cliap::Arg().short_name("-p").long_name("--port").default_value("8080")).range(1, 65535);
+        auto verbose = cli_parser.add_parameter_as<bool>(cliap::Arg().short_name("-v").flag());
+        auto timeout = cli_parser.add_parameter_as<std::chrono::nanoseconds>(cliap::Arg().long_name("--timeout").default_value("5s"));
+        cli_parser.add_parameter_as(cliap::Arg().long_name("--mode").default_value("fast"), &mode).choices({"fast", "slow"});
+        auto level = cli_parser.add_parameter_as(cliap::Arg().long_name("--level").repeated(), &levels).range(0, 9);
+
+        // Defaults are converted on registration
+        CHECK(*port == 8080);
+        CHECK(!*verbose);
+        CHECK(*timeout == std::chrono::seconds{5});
+        CHECK(mode == "fast"s);
+        CHECK(levels.empty());
+
+        REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "-p", "0x50", "-v", "--mode=slow", "--level", "1", "--level", "7", "--timeout", "1m"}));
+        CHECK(port.get() == 80);
+        CHECK(*verbose);
+        CHECK(*timeout == std::chrono::minutes{1});
+        CHECK(mode == "slow"s);
+        CHECK(levels == std::vector<int>{1, 7});
+
+        SUBCASE("Invalid values fail the parse and keep the previous value") {
+            auto error = cli_parser.parse(std::vector<std::string>{"program.exe", "--port", "http"});
+            REQUIRE(error);
+            CHECK(*error == "Invalid value for the key: port (invalid format)"s);
+
+            error = cli_parser.parse(std::vector<std::string>{"program.exe", "--port", "70000"});
+            REQUIRE(error);
+            CHECK(*error == "Invalid value for the key: port (must be between 1 and 65535)"s);
+            CHECK(*port == 80);
+
+            error = cli_parser.parse(std::vector<std::string>{"program.exe", "--port", "81", "--mode", "medium"});
+            REQUIRE(error);
+            CHECK(*error == "Invalid value for the key: mode (must be one of fast, slow)"s);
+
+            // Values persist between parses, the rejected one included
+            error = cli_parser.parse(std::vector<std::string>{"program.exe", "--mode", "fast", "--level", "3", "--level", "10"});
+            REQUIRE(error);
+            CHECK(*error == "Invalid value for the key: level (must be between 0 and 9)"s);
+            CHECK(levels == std::vector<int>{1, 7});
+        }
+
+        SUBCASE("Custom validators") {
+            auto even = cli_parser.add_parameter_as<long>(cliap::Arg().long_name("--even")).validate([](const long& value) -> std::optional<std::string> {
+                if (value % 2)
+                    return "must be even"s;
+                return {};
+            });
+
+            const auto error = cli_parser.parse(std::vector<std::string>{"program.exe", "--even", "3"});
+            REQUIRE(error);
+            CHECK(*error == "Invalid value for the key: even (must be even)"s);
+
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "--even", "4"}));
+            CHECK(*even == 4);
+        }
+
+        SUBCASE("Registration errors") {
+            CHECK_THROWS_AS(cli_parser.add_parameter_as<int>(cliap::Arg().long_name("--count").default_value("many")), std::runtime_error);
+            CHECK_THROWS_AS(cli_parser.add_parameter_as<int>(cliap::Arg().long_name("--dry-run").flag()), std::runtime_error);
+            CHECK_THROWS_AS(cli_parser.add_parameter_as<int>(cliap::Arg()), std::runtime_error);
+        }
+
+        SUBCASE("Constraints apply to the value held when they are added") {
+            auto listen = cli_parser.add_parameter_as<int>(cliap::Arg().long_name("--listen").default_value("0"));
+            CHECK_THROWS_AS(listen.range(1, 65535), std::runtime_error);
+            CHECK_THROWS_AS(port.range(1, 79), std::runtime_error);
+            CHECK_THROWS_AS(level.choices({1, 2}), std::runtime_error);
+
+            // The rejected constraints were not added
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "--listen", "0", "-p", "90", "--level", "5"}));
+            CHECK(*listen == 0);
+            CHECK(*port == 90);
+
+            // Without a value, nothing is checked before the next parse
+            auto backlog = cli_parser.add_parameter_as<int>(cliap::Arg().long_name("--backlog")).range(1, 128);
+            CHECK(cli_parser.parse(std::vector<std::string>{"program.exe", "--backlog", "0"}));
+            CHECK(*backlog == 0);
+        }
+
+        SUBCASE("Handles outlive reset()") {
+            cli_parser.reset();
+            CHECK(*port == 80);
+            CHECK(levels == std::vector<int>{1, 7});
+            CHECK_THROWS_AS(port.range(1, 100), std::runtime_error);
+
+            cli_parser.add_parameter(cliap::Arg().short_name("-p").long_name("--port"));
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "-p", "81"}));
+            CHECK(*port == 80);
+        }
+    }
+
+    TEST_CASE("Testing cliap::Callback") {
+        using Hook = cliap::Callback<int(int)>;
+
+        SUBCASE("Small and large callables are copied and moved") {
+            const std::array<int, 16> table{1, 2, 3};
+            Hook small{[offset = 1](int x) { return x + offset; }};
+            Hook large{[table](int x) { return table[x]; }};
+
+            Hook small_copy{small};
+            Hook large_copy{large};
+            CHECK(small_copy(1) == 2);
+            CHECK(large_copy(2) == 3);
+
+            Hook moved{std::move(large)};
+            CHECK(!large);
+            CHECK(moved(0) == 1);
+
+            moved = small;
+            CHECK(moved(41) == 42);
+            CHECK(small(1) == 2);
+        }
+
+        SUBCASE("Empty targets stay empty") {
+            CHECK(!Hook{});
+            CHECK(!Hook{nullptr});
+            CHECK(!Hook{static_cast<int (*)(int)>(nullptr)});
+            CHECK_THROWS_AS(Hook{}(0), std::logic_error);
+        }
+
+        SUBCASE("Stateful callables keep their own state per copy") {
+            int calls{};
+            Hook counter{[&calls, count = 0](int) mutable { ++calls; return ++count; }};
+            Hook copy{counter};
+
+            CHECK(counter(0) == 1);
+            CHECK(counter(0) == 2);
+            CHECK(copy(0) == 1);
+            CHECK(calls == 3);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser instrumentation") {
+        std::vector<std::string> parsed, errors;
+
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .on_arg_parsed([&parsed](const cliap::Arg& parm) { parsed.push_back(parm.long_name()); })
+            .on_error([&errors](std::string_view message) { errors.emplace_back(message); })
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag())
+            .add_parameter(cliap::Arg().long_name("--name").default_value("cli"))
+            .add_command("run", "", [](cliap::ArgParser& parser) {
+                parser.add_parameter(cliap::Arg().long_name("--fast").flag());
+            });
+        cli_parser.add_parameter_as<int>(cliap::Arg().long_name("--jobs").default_value("1"));
+
+        REQUIRE(!cli_parser.parse(std::vector<std::string>{"program.exe", "-p", "80", "--verbose", "run", "--fast"}));
+        CHECK(cli_parser.parse(std::vector<std::string>{"program.exe", "--prot", "80"}));
+        cli_parser.help_text(80);
+
+        const auto& stats = cli_parser.stats();
+
+        if constexpr (cliap::ArgParser::instrumented) {
+            CHECK(parsed == std::vector<std::string>{"fast", "port", "verbose"});
+            REQUIRE(errors.size() == 1);
+            CHECK(errors[0].find("prot") != std::string::npos);
+
+            CHECK(stats.parses == 2);
+            CHECK(stats.tokens == 8);
+            CHECK(stats.lookups == 4);
+            CHECK(stats.errors == 1);
+            CHECK(stats.allocations > 0);
+            CHECK(stats.registration.count() > 0);
+            CHECK(stats.parse >= stats.tokenization + stats.lookup + stats.conversion + stats.required_check);
+            CHECK(stats.help.count() > 0);
+
+            const auto json = stats.to_json();
+            CHECK(json.find("\"parses\": 2, \"tokens\": 8, \"lookups\": 4, ") == 1);
+            CHECK(json.find("\"help_ns\": ") != std::string::npos);
+            CHECK(json.back() == '}');
+
+            cli_parser.reset_stats();
+            CHECK(cli_parser.stats().parses == 0);
+        } else {
+            // Compiled out: no hooks, no counting
+            CHECK(parsed.empty());
+            CHECK(errors.empty());
+            CHECK(stats.parses == 0);
+            CHECK(stats.to_json().find("\"parses\": 0") != std::string::npos);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser suggestions for unknown keys") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port"))
+            .add_parameter(cliap::Arg().long_name("--sort"))
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag())
+            .add_parameter(cliap::Arg().long_name("--bat"))
+            .add_parameter(cliap::Arg().long_name("--car"));
+
+        const auto parse_error = [&cli_parser](std::string key) {
+            const auto error = cli_parser.parse(std::vector<std::string>{"program.exe", std::move(key), "1"});
+            return error.value_or("");
+        };
+
+        CHECK(parse_error("--prot") == "An unknown parameter key is specified: prot. Did you mean --port?"s);
+        CHECK(parse_error("--verbse") == "An unknown parameter key is specified: verbse. Did you mean --verbose?"s);
+        CHECK(parse_error("--vrebose=1") == "An unknown parameter key is specified: vrebose=1. Did you mean --verbose?"s);
+        CHECK(parse_error("--cat") == "An unknown parameter key is specified: cat. Did you mean --bat or --car?"s);
+        CHECK(parse_error("--pv") == "An unknown parameter key is specified: pv. Did you mean -p or -v?"s);
+        CHECK(parse_error("--xyz") == "An unknown parameter key is specified: xyz"s);
+        CHECK(parse_error("-q") == "An unknown parameter key is specified: q"s);
+        CHECK(parse_error("--" + std::string(100, 'p')) == "An unknown parameter key is specified: " + std::string(100, 'p'));
+
+        SUBCASE("Thousands of names") {
+            for (int i = 0; i < 4000; ++i)
+                cli_parser.add_parameter(cliap::Arg().long_name("--option-" + std::to_string(i)));
+
+            CHECK(parse_error("--opton-1234") == "An unknown parameter key is specified: opton-1234. Did you mean --option-1234?"s);
+            CHECK(parse_error("--option-39999") == "An unknown parameter key is specified: option-39999. Did you mean --option-3999?"s);
+            CHECK(parse_error("--option_12") == "An unknown parameter key is specified: option_12. Did you mean --option-12?"s);
+        }
+
+        SUBCASE("Commands suggest the options they inherit") {
+            cli_parser.add_command("run", "", [](cliap::ArgParser& parser) {
+                parser.add_parameter(cliap::Arg().long_name("--fast").flag());
+            });
+
+            const auto error = cli_parser.parse(std::vector<std::string>{"program.exe", "run", "--fas", "--verbos"});
+            REQUIRE(error);
+            CHECK(*error == "An unknown parameter key is specified: fas. Did you mean --fast?"s);
+
+            const auto outer = cli_parser.parse(std::vector<std::string>{"program.exe", "run", "--verbos"});
+            REQUIRE(outer);
+            CHECK(*outer == "An unknown parameter key is specified: verbos. Did you mean --verbose?"s);
+        }
+
+        SUBCASE("Config files") {
+            const TempFile config{"cliap_suggest_test.toml", "prot = 8080\n"};
+            cli_parser.add_config_file(config.path.string());
+
+            const auto error = cli_parser.parse(std::vector<std::string>{"program.exe"});
+            REQUIRE(error);
+            CHECK(error->find("line 1: unknown key prot. Did you mean port?") != std::string::npos);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser structured errors") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag())
+            .add_parameter(cliap::Arg().long_name("--name"));
+        auto count = cli_parser.add_parameter_as<int>(cliap::Arg().long_name("--count").default_value("1"));
+
+        // Subjects are views into the arguments, which must outlive the error
+        std::vector<std::string> args;
+        const auto try_parse = [&cli_parser, &args](std::vector<std::string> tail) {
+            args = std::move(tail);
+            args.insert(args.begin(), "program.exe");
+            return cli_parser.try_parse(args);
+        };
+
+        // Before the port has been given: values persist from earlier parses
+        auto error = try_parse({"-v"});
+        CHECK(error.code() == cliap::ParseErrorCode::missing_required);
+        CHECK(error.token() == cliap::ParseError::npos);
+        REQUIRE(error.arg());
+        CHECK(error.arg()->long_name() == "port"s);
+        CHECK(error.message() == "Expected required parameter value: p [port]"s);
+
+        CHECK(!try_parse({"-p", "80"}));
+        CHECK(try_parse({"-p", "80"}).code() == cliap::ParseErrorCode::none);
+
+        error = try_parse({"-p", "80", "--prot=81"});
+        CHECK(error.code() == cliap::ParseErrorCode::unknown_key);
+        CHECK(error.token() == 3);
+        CHECK(error.subject() == "prot=81");
+        CHECK(error.arg() == nullptr);
+        CHECK(error.message() == "An unknown parameter key is specified: prot=81. Did you mean --port?"s);
+
+        error = try_parse({"-v", "--name"});
+        CHECK(error.code() == cliap::ParseErrorCode::missing_value);
+        CHECK(error.token() == 2);
+        CHECK(error.arg() == &cli_parser.arg("name"));
+        CHECK(error.message() == "Expected value for the key: name"s);
+
+        error = try_parse({"-p", "80", "--count", "many"});
+        CHECK(error.code() == cliap::ParseErrorCode::invalid_value);
+        CHECK(error.subject() == "count");
+        CHECK(error.detail() == "invalid format");
+        CHECK(error.message() == "Invalid value for the key: count (invalid format)"s);
+        CHECK(*count == 1);
+
+        error = cli_parser.try_parse_command_line("program.exe -p 80 --name 'unterminated");
+        CHECK(error.code() == cliap::ParseErrorCode::unterminated_quote);
+        CHECK(error.token() == 4);
+        CHECK(error.message() == "Unterminated quote in command line"s);
+
+        SUBCASE("Rejecting a command allocates nothing") {
+            args = {"program.exe", "-p", "80", "--verbsoe"};
+            std::size_t failures = 0;
+            // The first parse sizes the buffers
+            failures += static_cast<bool>(cli_parser.try_parse(args));
+
+            const auto before = allocation_count;
+            for (int i = 0; i < 100; ++i)
+                failures += static_cast<bool>(cli_parser.try_parse(args));
+            CHECK(allocation_count == before);
+            CHECK(failures == 101);
+        }
+
+        SUBCASE("Results of a schema") {
+            const auto schema = cli_parser.schema();
+            cliap::ParseResult result;
+
+            schema->parse_command_line("program.exe -p 80 extra", result);
+            CHECK(result.failure().code() == cliap::ParseErrorCode::unknown_key);
+            CHECK(result.failure().token() == 3);
+            CHECK(*result.error() == "An unknown parameter key is specified: extra");
+
+            schema->parse_command_line("program.exe -p 80 -v", result);
+            CHECK(!result.failure());
+            CHECK(!result.error());
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser subcommands") {
+        int build_count{}, clean_count{};
+
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag())
+            .add_parameter(cliap::Arg().long_name("--config").default_value("tool.toml"))
+            .add_command("build", "Build the targets", [&build_count](cliap::ArgParser& parser) {
+                ++build_count;
+                parser
+                    .add_parameter(cliap::Arg().short_name("-j").long_name("--jobs").default_value("1"))
+                    .add_parameter(cliap::Arg().long_name("--targets").positional().repeated());
+            })
+            .add_command("clean", "Remove build outputs", [&clean_count](cliap::ArgParser& parser) {
+                ++clean_count;
+                parser.add_parameter(cliap::Arg().long_name("--all").flag());
+            });
+
+        SUBCASE("Only the selected command is built") {
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"tool", "-v", "build", "-j", "8", "app", "lib"}));
+            CHECK(build_count == 1);
+            CHECK(clean_count == 0);
+            CHECK(cli_parser.selected_command() == "build");
+            CHECK(cli_parser.arg("verbose").is_parsed());
+
+            const auto& build = cli_parser.command("build");
+            CHECK(build.arg("jobs").get_value_as<int>() == 8);
+            CHECK(build.arg("targets").values().size() == 2);
+
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"tool", "build"}));
+            CHECK(build_count == 1);
+        }
+
+        SUBCASE("Options of enclosing parsers are accepted after the command") {
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"tool", "clean", "--all", "--config=other.toml", "-v"}));
+            CHECK(cli_parser.selected_command() == "clean");
+            CHECK(cli_parser.arg("config").value() == "other.toml"s);
+            CHECK(cli_parser.arg("v").is_parsed());
+            CHECK(cli_parser.command("clean").arg("all").is_parsed());
+            CHECK(build_count == 0);
+        }
+
+        SUBCASE("Options of a command are not accepted before it") {
+            const auto error = cli_parser.parse(std::vector<std::string>{"tool", "--all", "clean"});
+            REQUIRE(error);
+            CHECK(*error == "An unknown parameter key is specified: all"s);
+            CHECK(clean_count == 0);
+        }
+
+        SUBCASE("Values of a command outlive the storage of later parses") {
+            REQUIRE(!cli_parser.parse_command_line(R"(tool build --jobs "4" "my app")"));
+            REQUIRE(!cli_parser.parse_command_line(R"(tool clean --config "next.toml")"));
+            REQUIRE(!cli_parser.parse_command_line(R"(tool clean)"));
+
+            const auto& build = cli_parser.command("build");
+            CHECK(build.arg("jobs").value() == "4"s);
+            CHECK(build.arg("targets").values().size() == 1);
+            CHECK(build.arg("targets").value() == "my app"s);
+            CHECK(cli_parser.arg("config").value() == "next.toml"s);
+        }
+
+        SUBCASE("Commands nest") {
+            cli_parser.command("build").add_command("docs", "Build the documentation", [](cliap::ArgParser& parser) {
+                parser.add_parameter(cliap::Arg().long_name("--format").default_value("html"));
+            });
+
+            REQUIRE(!cli_parser.parse(std::vector<std::string>{"tool", "build", "docs", "--format=pdf", "-j", "2", "-v"}));
+            auto& build = cli_parser.command("build");
+            CHECK(build.selected_command() == "docs");
+            CHECK(build.command("docs").arg("format").value() == "pdf"s);
+            CHECK(build.arg("jobs").value() == "2"s);
+            CHECK(cli_parser.arg("verbose").is_parsed());
+        }
+
+        SUBCASE("A schema stops at the command") {
+            char prog[] = "tool", verbose[] = "-v", clean[] = "clean", all[] = "--all";
+            char* argv[] = {prog, verbose, clean, all};
+
+            const auto result = cli_parser.schema()->parse(4, argv);
+            REQUIRE(result.ok());
+            CHECK(result.arg("verbose").is_parsed());
+            CHECK(result.command() == "clean");
+            REQUIRE(result.command_position() == 2);
+
+            const auto clean_schema = cli_parser.command("clean").schema();
+            const auto rest = clean_schema->parse(4 - 2, argv + 2);
+            CHECK(rest.ok());
+            CHECK(rest.arg("all").is_parsed());
+        }
+
+        SUBCASE("A moved parser takes its commands along") {
+            static_assert(!std::is_copy_constructible_v<cliap::ArgParser> && !std::is_copy_assignable_v<cliap::ArgParser>);
+
+            auto source = std::make_unique<cliap::ArgParser>(std::move(cli_parser));
+            REQUIRE(!source->parse(std::vector<std::string>{"tool", "build", "-j", "8"}));
+            const auto error = source->parse(std::vector<std::string>{"tool", "build", "--verbos"});
+
+            cliap::ArgParser moved{std::move(*source)};
+            source.reset();
+
+            REQUIRE(error);
+            CHECK(moved.try_parse(std::vector<std::string>{"tool", "build", "--verbos"}).message() == *error);
+            REQUIRE(!moved.parse(std::vector<std::string>{"tool", "-v", "build", "-j", "4", "app"}));
+            CHECK(moved.command("build").arg("jobs").get_value_as<int>() == 4);
+            CHECK(moved.command("build").arg("targets").value() == "app"s);
+            CHECK(build_count == 1);
+        }
+
+        SUBCASE("A parser is move assigned") {
+            static_assert(std::is_move_assignable_v<cliap::ArgParser>);
+
+            const auto move_assign = [&cli_parser, &build_count](cliap::ArgParser& target) {
+                const auto params = cli_parser.all_params().size();
+                auto source = std::make_unique<cliap::ArgParser>(std::move(cli_parser));
+                REQUIRE(!source->parse_command_line(R"(tool -v build --jobs "4" "my app" tests)"));
+                target = std::move(*source);
+                source.reset();
+
+                CHECK(target.all_params().size() == params);
+                CHECK(target.selected_command() == "build");
+                CHECK(target.arg("verbose").is_parsed());
+                const auto& build = target.command("build");
+                CHECK(build.arg("jobs").value() == "4"s);
+                REQUIRE(build.arg("targets").values().size() == 2);
+                CHECK(build.arg("targets").values()[0] == "my app");
+                CHECK(build.arg("targets").values()[1] == "tests");
+
+                REQUIRE(!target.parse(std::vector<std::string>{"tool", "clean", "--all"}));
+                CHECK(target.command("clean").arg("all").is_parsed());
+                CHECK(build_count == 1);
+            };
+
+            SUBCASE("From the same resource") {
+                cliap::ArgParser target;
+                target.add_parameter(cliap::Arg().long_name("--other"));
+                move_assign(target);
+            }
+
+            SUBCASE("From another resource") {
+                std::pmr::unsynchronized_pool_resource pool;
+                cliap::ArgParser target{&pool};
+                move_assign(target);
+            }
+
+            cli_parser = cliap::ArgParser{};
+            CHECK(cli_parser.all_params().empty());
+        }
+
+        SUBCASE("Help lists the commands without building them") {
+            const auto text = cli_parser.help_text(80);
+            CHECK(text.find("Commands:\n    build  Build the targets\n    clean  Remove build outputs\n") != std::string_view::npos);
+            CHECK(build_count == 0);
+            CHECK_THROWS_AS(cli_parser.command("install"), std::runtime_error);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgParser shell completion") {
+        int build_count{}, clean_count{};
+
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag().description("more output\nand more"))
+            .add_parameter(cliap::Arg().long_name("--color").required())
+            .add_parameter(cliap::Arg().long_name("--config"))
+            .add_command("build", "Build the targets", [&build_count](cliap::ArgParser& parser) {
+                ++build_count;
+                parser
+                    .add_parameter(cliap::Arg().short_name("-j").long_name("--jobs"))
+                    .add_parameter(cliap::Arg().long_name("--targets").positional().repeated())
+                    .set_value_provider("targets", [](std::string_view, std::vector<std::string>& candidates) {
+                        candidates = {"all", "app", "tests"};
+                    });
+            })
+            .add_command("clean", "Remove build outputs", [&clean_count](cliap::ArgParser& parser) {
+                ++clean_count;
+                parser.add_parameter(cliap::Arg().long_name("--all").flag());
+            });
+        cli_parser.set_value_provider("color", [](std::string_view prefix, std::vector<std::string>& candidates) {
+            CHECK(prefix.size() <= 2);
+            candidates = {"auto", "always", "never", "bad\nvalue"};
+        });
+
+        const auto complete = [&cli_parser](std::vector<std::string> words) {
+            return std::string{cli_parser.complete(words)};
+        };
+
+        CHECK(complete({"--c"}) == "--color\n--config\n"s);
+        CHECK(complete({"-"}) == "--verbose\tmore output\n-v\tmore output\n--color\n--config\n"s);
+        CHECK(complete({""}) == "build\tBuild the targets\nclean\tRemove build outputs\n"s);
+        CHECK(complete({"b"}) == "build\tBuild the targets\n"s);
+        CHECK(complete({}) == complete({""}));
+
+        SUBCASE("Values come from the provider without conversion or checks") {
+            CHECK(complete({"--color", ""}) == "auto\nalways\nnever\n"s);
+            CHECK(complete({"-v", "--color", "al"}) == "always\n"s);
+            CHECK(complete({"--color=a"}) == "--color=auto\n--color=always\n"s);
+            CHECK(complete({"--config", ""}).empty());
+            CHECK(complete({"--verbose=x"}).empty());
+            CHECK(complete({"--unknown", "--color", "n"}) == "never\n"s);
+
+            // The value of an option is never taken for a command
+            CHECK(complete({"--config", "build", "--j"}).empty());
+        }
+
+        SUBCASE("Commands are built only when walked through") {
+            CHECK(complete({"-v", "build", "-"}) == "--jobs\n-j\n--targets\n--verbose\tmore output\n-v\tmore output\n--color\n--config\n"s);
+            CHECK(complete({"build", "a"}) == "all\napp\n"s);
+            CHECK(complete({"build", "all", "t"}) == "tests\n"s);
+            CHECK(complete({"build", "--color", ""}) == "auto\nalways\nnever\n"s);
+            CHECK(complete({"build", "--", "-"}).empty());
+            CHECK(complete({"build", "--", "a"}) == "all\napp\n"s);
+            CHECK(build_count == 1);
+            CHECK(clean_count == 0);
+        }
+
+        SUBCASE("handle_completion() answers only the hidden key") {
+            char prog[] = "tool", key[] = "--__complete", word[] = "--verb";
+            char* argv[] = {prog, key, word};
+            char* plain[] = {prog, word};
+
+            CHECK(!cli_parser.handle_completion(2, plain));
+            CHECK(!cli_parser.handle_completion(1, argv));
+            CHECK(cli_parser.complete(1, argv + 2) == "--verbose\tmore output\n");
+
+            // Options, as the common case, complete without allocating
+            const auto before = allocation_count;
+            CHECK(!cli_parser.complete(1, argv + 2).empty());
+            CHECK(allocation_count == before);
+        }
+
+        SUBCASE("Scripts") {
+            CHECK_THROWS_AS(cli_parser.set_value_provider("colour", {}), std::runtime_error);
+
+            const auto bash = cliap::ArgParser::completion_script(cliap::Shell::bash, "my-tool");
+            CHECK(bash.find("complete -o default -F _my_tool_complete my-tool\n") != std::string::npos);
+            CHECK(bash.find("\"$1\" --__complete \"${words[@]:1}\"") != std::string::npos);
+            CHECK(bash.find("{{") == std::string::npos);
+
+            const auto zsh = cliap::ArgParser::completion_script(cliap::Shell::zsh, "my-tool");
+            CHECK(zsh.find("compdef _my_tool_complete my-tool\n") != std::string::npos);
+
+            const auto fish = cliap::ArgParser::completion_script(cliap::Shell::fish, "my-tool");
+            CHECK(fish.find("complete -c my-tool -f -a '(__my_tool_complete)'\n") != std::string::npos);
+        }
+    }
 }
 
+TEST_SUITE("Testing cliap::ArgSchema" * doctest::description("Class cliap::ArgSchema tests")) {
+    TEST_CASE("Testing cliap::ArgSchema parse results") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-n").long_name("--name").default_value("cli"))
+            .add_parameter(cliap::Arg().short_name("-I").long_name("--include").repeated())
+            .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag());
+
+        const auto schema = cli_parser.schema();
+        CHECK(schema == cli_parser.schema());
+        CHECK(schema->parameters_count() == 4);
+        CHECK(schema->find("include") == 2);
+        CHECK(schema->find("missing") == cliap::ArgSchema::npos);
+
+        const std::vector<std::string> args{"program.exe", "-p", "80", "-I", "a", "-v", "-I", "b"};
+        const auto result = schema->parse(args);
+
+        REQUIRE(result.ok());
+        CHECK(result.size() == 4);
+        CHECK(result.arg("port").get_value_as<int>() == 80);
+        CHECK(result.arg("port").source() == cliap::ValueSource::command_line);
+        CHECK(result.arg("name").value() == "cli"s);
+        CHECK(!result.arg("name").is_parsed());
+        CHECK(result.arg("name").source() == cliap::ValueSource::default_value);
+        CHECK(result.arg("v").is_parsed());
+        CHECK(result.arg("include").values().size() == 2);
+        CHECK(result[2].values()[1] == "b");
+        CHECK(result[2].spec().long_name() == "include"s);
+        CHECK(!result.arg("missing").is_parsed());
+        CHECK(result.arg("missing").value_view().empty());
+
+        // The schema and the parser are left untouched
+        CHECK(!schema->all_params()[0].is_parsed());
+        CHECK(!cli_parser.arg("port").is_parsed());
+
+        const auto failed = schema->parse(std::vector<std::string>{"program.exe", "-n", "x"});
+        REQUIRE(!failed.ok());
+        CHECK(*failed.error() == "Expected required parameter value: p [port]"s);
+
+        // Changing the parser leaves taken schemas alone
+        cli_parser.add_parameter(cliap::Arg().long_name("--extra"));
+        CHECK(cli_parser.schema() != schema);
+        CHECK(schema->parameters_count() == 4);
+        CHECK(cli_parser.schema()->parameters_count() == 5);
+    }
+
+    TEST_CASE("Testing cliap::ArgSchema reused results stop allocating") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port"))
+            .add_parameter(cliap::Arg().short_name("-I").long_name("--include").repeated());
+
+        const auto schema = cli_parser.schema();
+
+        char prog[] = "program.exe", port[] = "--port=1", include[] = "-I", dir[] = "dir";
+        char* argv[] = {prog, port, include, dir, include, dir};
+
+        cliap::ParseResult result;
+        schema->parse(6, argv, result);
+        REQUIRE(result.ok());
+
+        const auto before = allocation_count;
+        schema->parse(6, argv, result);
+        CHECK(allocation_count == before);
+        CHECK(result.ok());
+        CHECK(result.arg("include").values().size() == 2);
+
+        // Tokens that are copied into the result's storage reuse it as well
+        const std::vector<std::string> args{"program.exe", "--port=2", "-I", "dir"};
+        schema->parse(args, result);
+
+        const auto vector_before = allocation_count;
+        schema->parse(args, result);
+        CHECK(allocation_count == vector_before);
+        CHECK(result.arg("port").value() == "2"s);
+    }
+
+    TEST_CASE("Testing cliap::ArgSchema shared by many threads") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-n").long_name("--name").default_value("cli"))
+            .add_parameter(cliap::Arg().long_name("--files").positional().repeated());
+
+        const auto schema = cli_parser.schema();
+
+        constexpr int thread_count = 8;
+        constexpr int parse_count = 2000;
+        std::vector<int> failures(thread_count);
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&schema, &failures, t] {
+                cliap::ParseResult result;
+                for (int i = 0; i < parse_count; ++i) {
+                    const auto port = std::to_string(t * parse_count + i);
+                    const std::vector<std::string> args{"program.exe", "--port", port, "f" + port, "g"};
+                    schema->parse(args, result);
+
+                    const bool good = result.ok()
+                        && result.arg("port").value_view() == port
+                        && result.arg("name").value_view() == "cli"
+                        && result.arg("files").values().size() == 2
+                        && result.arg("files").values()[0] == "f" + port;
+                    failures[t] += good ? 0 : 1;
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        for (const auto count : failures)
+            CHECK(count == 0);
+    }
+
+    TEST_CASE("Testing cliap::ArgParser and cliap::ArgSchema on a memory resource") {
+        // Both arenas fail instead of falling back to the heap
+        static std::array<std::byte, 64 * 1024> schema_buffer;
+        static std::array<std::byte, 16 * 1024> parse_buffer;
+
+        const auto before = allocation_count;
+
+        std::pmr::monotonic_buffer_resource schema_arena{schema_buffer.data(), schema_buffer.size(), std::pmr::null_memory_resource()};
+        const cliap::Arg::allocator_type alloc{&schema_arena};
+
+        cliap::ArgParser cli_parser{&schema_arena};
+        cli_parser
+            .add_parameter(cliap::Arg{"p,port", alloc}.required().description("A port to listen on"))
+            .add_parameter(cliap::Arg{"n,name", alloc}.default_value("a rather long default name"))
+            .add_parameter(cliap::Arg{"I,include", alloc}.repeated());
+        cli_parser.add_usage_string("program.exe --port=<port> [-I <dir>]...");
+
+        char prog[] = "program.exe", port[] = "--port=80", include[] = "-I", dir[] = "dir";
+        char* argv[] = {prog, port, include, dir, include, dir};
+
+        SUBCASE("The parser keeps its args and values in the arena") {
+            REQUIRE(!cli_parser.parse(6, argv));
+            CHECK(cli_parser.arg("include").values().size() == 2);
+            CHECK(cli_parser.arg("p").get_value_as<int>() == 80);
+            // Instrumented parsers count allocations on their way to the arena
+            if constexpr (!cliap::ArgParser::instrumented)
+                CHECK(cli_parser.arg("port").get_allocator().resource() == &schema_arena);
+
+            REQUIRE(!cli_parser.parse_command_line(R"(program.exe --port=81 --name="quoted name")"));
+            CHECK(cli_parser.arg("name").value_view() == "quoted name");
+            CHECK(allocation_count == before);
+        }
+
+        SUBCASE("A schema and every parse live in arenas") {
+            const auto schema = cli_parser.schema();
+            if constexpr (!cliap::ArgParser::instrumented)
+                CHECK(schema->all_params()[0].get_allocator().resource() == &schema_arena);
+
+            for (int i = 0; i < 100; ++i) {
+                std::pmr::monotonic_buffer_resource parse_arena{parse_buffer.data(), parse_buffer.size(), std::pmr::null_memory_resource()};
+                cliap::ParseResult result{&parse_arena};
+
+                schema->parse_command_line(R"(program.exe -I "first dir" --port 8080 -I 'second dir')", result);
+                CHECK(result.ok());
+                CHECK(result.arg("port").value_view() == "8080");
+                CHECK(result.arg("include").values().size() == 2);
+                CHECK(result.arg("include").values()[1] == "second dir");
+            }
+
+            CHECK(allocation_count == before);
+        }
+    }
+
+    TEST_CASE("Testing cliap::ArgSchema parsing into a fixed buffer") {
+        const TempFile config{"cliap_fixed.ini", "name = from config\n[log]\nlevel = 3\n"};
+        const TempFile response{"cliap_fixed.rsp", "-I 'response dir' --verbose\n"};
+
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg("p,port").required())
+            .add_parameter(cliap::Arg("n,name"))
+            .add_parameter(cliap::Arg("log.level"))
+            .add_parameter(cliap::Arg("v,verbose").flag())
+            .add_parameter(cliap::Arg("I,include").repeated())
+            .add_parameter(cliap::Arg("t,targets").multi_value())
+            .add_parameter(cliap::Arg("input").positional())
+            .add_config_file(config.path.string())
+            .allow_response_files();
+        const auto schema = cli_parser.schema();
+
+        const auto response_arg = response.arg();
+        std::string prog{"program.exe"}, port{"--port=80"}, include{"-I"}, dir{"dir"}, input{"input.txt"}, rsp{response_arg};
+        char* argv[] = {prog.data(), port.data(), include.data(), dir.data(), rsp.data(), input.data()};
+
+        SUBCASE("Parses of every kind stay in the buffer") {
+            cliap::FixedBuffer<16 * 1024> buffer;
+            cliap::ParseResult result{&buffer};
+
+            const auto before = allocation_count;
+            std::size_t used = 0;
+            for (int i = 0; i < 100; ++i) {
+                // Freed blocks are reused: past the first round, the buffer stops filling up
+                if (i == 1)
+                    used = buffer.used();
+                schema->parse(6, argv, result);
+                REQUIRE(result.ok());
+                CHECK(result.arg("port").value_view() == "80");
+                CHECK(result.arg("name").value_view() == "from config");
+                CHECK(result.arg("log.level").get_value_as<int>() == 3);
+                CHECK(result.arg("verbose").is_parsed());
+                CHECK(result.arg("include").values().size() == 2);
+                CHECK(result.arg("include").values()[1] == "response dir");
+                CHECK(result.arg("input").value_view() == "input.txt");
+
+                schema->parse_command_line(R"(program.exe -p 81 -t "first target" second 'third target' -I "a dir")", result);
+                REQUIRE(result.ok());
+                CHECK(result.arg("targets").values().size() == 3);
+                CHECK(result.arg("targets").values()[2] == "third target");
+
+                schema->parse_command_line("program.exe --port 82 --prot", result);
+                CHECK(*result.error() == "An unknown parameter key is specified: prot");
+                CHECK(!result.capacity_exceeded());
+
+                schema->parse_command_line("program.exe --name x", result);
+                CHECK(*result.error() == "Expected required parameter value: p [port]");
+            }
+            CHECK(allocation_count == before);
+            CHECK(buffer.used() == used);
+            CHECK(buffer.used() <= buffer.capacity());
+        }
+
+        SUBCASE("A parse that does not fit fails and the buffer recovers") {
+            cliap::FixedBuffer<8 * 1024> buffer;
+            cliap::ParseResult result{&buffer};
+
+            const auto before = allocation_count;
+            const std::string huge = "program.exe -p 80 --name '" + std::string(16 * 1024, 'x') + "'";
+            const auto after_setup = allocation_count;
+
+            for (int i = 0; i < 10; ++i) {
+                schema->parse_command_line(huge, result);
+                CHECK(result.capacity_exceeded());
+                CHECK(*result.error() == "Parse capacity exceeded");
+
+                schema->parse(6, argv, result);
+                REQUIRE(result.ok());
+                CHECK(result.arg("include").values()[1] == "response dir");
+            }
+            CHECK(allocation_count == after_setup);
+            CHECK(after_setup > before);
+        }
+
+        SUBCASE("A caller-provided buffer works the same") {
+            alignas(std::max_align_t) static std::array<std::byte, 16 * 1024> storage;
+            cliap::FixedBufferResource buffer{storage.data(), storage.size()};
+            cliap::ParseResult result{&buffer};
+
+            const auto before = allocation_count;
+            schema->parse(6, argv, result);
+            CHECK(result.ok());
+            CHECK(allocation_count == before);
+        }
+
+        SUBCASE("Freed blocks keep to the alignment asked for") {
+            cliap::FixedBuffer<1024> buffer;
+            std::pmr::memory_resource& resource = buffer;
+
+            // Leaves the next block of the buffer off a 32 byte boundary
+            while (reinterpret_cast<std::uintptr_t>(resource.allocate(16, 8)) % 32 != 0) {}
+            void* const block = resource.allocate(32, 8);
+            REQUIRE(reinterpret_cast<std::uintptr_t>(block) % 32 == 16);
+
+            resource.deallocate(block, 32, 8);
+            CHECK(reinterpret_cast<std::uintptr_t>(resource.allocate(32, 32)) % 32 == 0);
+            CHECK(resource.allocate(32, 8) == block);
+            CHECK_THROWS_AS(static_cast<void>(resource.allocate(std::numeric_limits<std::size_t>::max(), 8)), std::bad_alloc);
+        }
+    }
+}
@@ -0,0 +1,220 @@
+#include <doctest.h>
+
+#include <cli_parser.h>
+#include <cli_reload.h>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <signal.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace {
+    // Replaces the file as deployment tools do: written aside, then renamed
+    void replace_file(const std::filesystem::path& path, const std::string& contents)
+    {
+        auto staged = path;
+        staged += ".new";
+        std::ofstream{staged, std::ios::binary} << contents;
+        std::filesystem::rename(staged, path);
+    }
+
+    // Waits up to a few seconds for the config to reach the version
+    bool wait_for_version(const cliap::LiveConfig& config, std::uint64_t version)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+        while (config.snapshot().version() < version) {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        }
+        return true;
+    }
+
+    struct ReloadFixture {
+        std::filesystem::path path{std::filesystem::temp_directory_path() / "cliap_reload.ini"};
+        std::shared_ptr<const cliap::ArgSchema> schema;
+
+        ReloadFixture()
+        {
+            std::ofstream{path, std::ios::binary} << "port = 1\nname = first\n";
+
+            cliap::ArgParser cli_parser;
+            cli_parser
+                .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+                .add_parameter(cliap::Arg().short_name("-n").long_name("--name"))
+                .add_parameter(cliap::Arg().short_name("-v").long_name("--verbose").flag())
+                .add_config_file(path.string());
+            schema = cli_parser.schema();
+        }
+
+        ~ReloadFixture() { std::filesystem::remove(path); }
+    };
+}
+
+TEST_SUITE("Testing cliap::LiveConfig" * doctest::description("Live reload tests")) {
+    TEST_CASE("Testing reloads that publish and reloads that fail") {
+        const ReloadFixture fixture;
+        cliap::LiveConfig config{fixture.schema, {"service", "-v"}};
+
+        auto before = config.snapshot();
+        CHECK(before.version() == 1);
+        CHECK(before->arg("port").get_value_as<int>() == 1);
+        CHECK(before->arg("verbose").is_parsed());
+
+        replace_file(fixture.path, "port = 2\nname = second\n");
+
+        std::string reported;
+        CHECK(config.reload([&reported](const cliap::ParseResult& result) {
+            reported = result.arg("name").value();
+        }));
+        CHECK(reported == "second"s);
+
+        // A snapshot taken before goes on seeing the values it was taken with
+        CHECK(before->arg("name").value() == "first"s);
+        before = config.snapshot();
+        CHECK(before.version() == 2);
+        CHECK(before->arg("port").get_value_as<int>() == 2);
+        CHECK(before->arg("verbose").is_parsed());
+
+        replace_file(fixture.path, "port = 3\ncolour = red\n");
+        before = config.snapshot();
+
+        std::string error;
+        CHECK(!config.reload([&error](const cliap::ParseResult& result) {
+            error = std::string{result.error().value_or("")};
+        }));
+        CHECK(error.find("unknown key colour") != std::string::npos);
+        CHECK(config.snapshot().version() == 2);
+        CHECK(config.snapshot()->arg("port").value() == "2"s);
+    }
+
+    TEST_CASE("Testing a snapshot that outlives its LiveConfig") {
+        const ReloadFixture fixture;
+        auto config = std::make_unique<cliap::LiveConfig>(fixture.schema, std::vector<std::string>{"service", "--name", "kept"});
+        const auto snapshot = config->snapshot();
+        config.reset();
+
+        CHECK(snapshot->arg("name").value() == "kept"s);
+        CHECK(snapshot->arg("name").spec().long_name() == "name"s);
+    }
+
+    TEST_CASE("Testing a snapshot while its config file is rewritten in place") {
+        const ReloadFixture fixture;
+        cliap::LiveConfig config{fixture.schema, {"service"}};
+        const auto snapshot = config.snapshot();
+
+        // As `cat > file` does, before the watch would reload
+        std::ofstream{fixture.path, std::ios::binary} << "port = 2\nname = XXXXX\n";
+        CHECK(snapshot->arg("name").value() == "first"s);
+        CHECK(snapshot->arg("port").value() == "1"s);
+
+        std::filesystem::resize_file(fixture.path, 0);
+        CHECK(snapshot->arg("name").value() == "first"s);
+        CHECK(snapshot->arg("port").value() == "1"s);
+
+        // Without the required port the reload fails and publishes nothing
+        CHECK(!config.reload());
+        CHECK(config.snapshot()->arg("name").value() == "first"s);
+    }
+
+    TEST_CASE("Testing a first parse that fails") {
+        const ReloadFixture fixture;
+        CHECK_THROWS_AS(cliap::LiveConfig(fixture.schema, {"service", "--unknown"}), std::runtime_error);
+        CHECK_THROWS_AS(cliap::LiveConfig(nullptr, {"service"}), std::runtime_error);
+    }
+
+    TEST_CASE("Testing reloads on file changes and SIGHUP") {
+        const ReloadFixture fixture;
+        cliap::LiveConfig config{fixture.schema, {"service"}};
+
+#if !defined(_WIN32)
+        struct sigaction before{};
+        REQUIRE(::sigaction(SIGHUP, nullptr, &before) == 0);
+#endif
+
+        std::atomic<int> reloads{0};
+        config.watch({}, [&reloads](const cliap::ParseResult&) { ++reloads; });
+        CHECK_THROWS_AS(config.watch(), std::runtime_error);
+
+        replace_file(fixture.path, "port = 2\n");
+        REQUIRE(wait_for_version(config, 2));
+        CHECK(config.snapshot()->arg("port").value() == "2"s);
+
+        std::ofstream{fixture.path, std::ios::binary} << "port = 3\n";
+        REQUIRE(wait_for_version(config, 3));
+        CHECK(config.snapshot()->arg("port").value() == "3"s);
+
+#if !defined(_WIN32)
+        {
+            // Every watch gets the signal
+            cliap::LiveConfig other{fixture.schema, {"service"}};
+            other.watch();
+            std::raise(SIGHUP);
+            REQUIRE(wait_for_version(config, 4));
+            REQUIRE(wait_for_version(other, 2));
+            CHECK(config.snapshot()->arg("port").value() == "3"s);
+        }
+#endif
+
+        config.stop();
+
+#if !defined(_WIN32)
+        // The last watch gives SIGHUP back to whoever had it
+        struct sigaction after{};
+        REQUIRE(::sigaction(SIGHUP, nullptr, &after) == 0);
+        CHECK(after.sa_handler == before.sa_handler);
+#endif
+        const auto seen = reloads.load();
+        CHECK(seen >= 2);
+
+        replace_file(fixture.path, "port = 5\n");
+        CHECK(config.reload());
+        CHECK(reloads == seen);
+        CHECK(config.snapshot()->arg("port").value() == "5"s);
+    }
+
+    TEST_CASE("Testing readers during reloads") {
+        const ReloadFixture fixture;
+        replace_file(fixture.path, "port = 0\nname = 0\n");
+        cliap::LiveConfig config{fixture.schema, {"service"}};
+
+        std::atomic<bool> done{false};
+        std::atomic<int> torn{0};
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 4; ++i) {
+            readers.emplace_back([&config, &done, &torn] {
+                std::uint64_t last_version = 0;
+                while (!done) {
+                    const auto snapshot = config.snapshot();
+                    if (snapshot->arg("port").value() != snapshot->arg("name").value() || snapshot.version() < last_version)
+                        ++torn;
+                    last_version = snapshot.version();
+                }
+            });
+        }
+
+        for (int i = 1; i <= 50; ++i) {
+            replace_file(fixture.path, "port = " + std::to_string(i) + "\nname = " + std::to_string(i) + "\n");
+            CHECK(config.reload());
+        }
+
+        done = true;
+        for (auto& reader : readers)
+            reader.join();
+
+        CHECK(torn == 0);
+        CHECK(config.snapshot().version() == 51);
+        CHECK(config.snapshot()->arg("port").value() == "50"s);
+    }
+}
@@ -0,0 +1,103 @@
+#include <doctest.h>
+
+#include <cli_static_schema.h>
+
+#include <string>
+#include <utility>
+
+using namespace std::string_literals;
+
+namespace {
+    constexpr auto server_schema = cliap::make_static_schema(
+        cliap::StaticArg().short_name("-h").long_name("--help").flag().description("show help message"),
+        cliap::StaticArg().short_name("-p").long_name("--port").required().default_value("8080").description("listen port"),
+        cliap::StaticArg().short_name("-a").long_name("--ip-address").required().description("ip address"),
+        cliap::StaticArg().long_name("--verbose").flag()
+    );
+
+    static_assert(server_schema.find("h") == 0);
+    static_assert(server_schema.find("help") == 0);
+    static_assert(server_schema.find("port") == 1);
+    static_assert(server_schema.find("a") == 2);
+    static_assert(server_schema.find("verbose") == 3);
+    static_assert(server_schema.find("unknown") == decltype(server_schema)::npos);
+    static_assert(server_schema.find("") == decltype(server_schema)::npos);
+
+    constexpr std::size_t big_schema_size = 300;
+
+    struct NameTable {
+        char names[big_schema_size][8]{};
+    };
+
+    constexpr NameTable make_names() {
+        NameTable table{};
+        for (std::size_t i = 0; i < big_schema_size; ++i) {
+            table.names[i][0] = 'o';
+            table.names[i][1] = 'p';
+            table.names[i][2] = 't';
+            table.names[i][3] = '-';
+            table.names[i][4] = static_cast<char>('0' + i / 100);
+            table.names[i][5] = static_cast<char>('0' + i / 10 % 10);
+            table.names[i][6] = static_cast<char>('0' + i % 10);
+        }
+        return table;
+    }
+
+    constexpr NameTable big_names = make_names();
+
+    template<std::size_t... I>
+    constexpr auto make_big_schema(std::index_sequence<I...>) {
+        return cliap::make_static_schema(cliap::StaticArg().long_name(std::string_view{big_names.names[I], 7})...);
+    }
+
+    constexpr auto big_schema = make_big_schema(std::make_index_sequence<big_schema_size>{});
+}
+
+TEST_SUITE("Testing cliap::StaticSchema" * doctest::description("Compile-time schema tests")) {
+    TEST_CASE("Testing cliap::StaticSchema lookup over a large schema") {
+        for (std::size_t i = 0; i < big_schema_size; ++i)
+            CHECK(big_schema.find(std::string_view{big_names.names[i], 7}) == i);
+
+        CHECK(big_schema.find("opt-300") == decltype(big_schema)::npos);
+        CHECK(big_schema.find("opt-00") == decltype(big_schema)::npos);
+    }
+
+    TEST_CASE("Testing cliap::StaticArgParser parse result") {
+        char prog[] = "program.exe", help[] = "--help", port[] = "--port=9090", key[] = "-a", addr[] = "127.0.0.1";
+        char* argv[] = {prog, help, port, key, addr};
+
+        cliap::StaticArgParser cli_parser{server_schema};
+
+        REQUIRE(!cli_parser.parse(5, argv));
+
+        CHECK(cli_parser.arg("h").is_parsed());
+        CHECK(cli_parser.arg("port").get_value_as<int>() == 9090);
+        CHECK(cli_parser.arg("ip-address").value_view().data() == addr);
+        CHECK(!cli_parser.arg("verbose").is_parsed());
+        CHECK(cli_parser.arg("missing").spec().long_name().empty());
+    }
+
+    TEST_CASE("Testing cliap::StaticArgParser errors and defaults") {
+        char prog[] = "program.exe", key[] = "-a", addr[] = "10.0.0.1", bad[] = "--bogus";
+        cliap::StaticArgParser cli_parser{server_schema};
+
+        SUBCASE("Default value satisfies a required arg") {
+            char* argv[] = {prog, key, addr};
+            REQUIRE(!cli_parser.parse(3, argv));
+            CHECK(cli_parser.arg("p").value() == "8080"s);
+            CHECK(!cli_parser.arg("p").is_parsed());
+        }
+
+        SUBCASE("Unknown key") {
+            char* argv[] = {prog, key, addr, bad};
+            const auto error = cli_parser.parse(4, argv);
+            REQUIRE(error);
+            CHECK(*error == "An unknown parameter key is specified: bogus"s);
+        }
+
+        SUBCASE("Missing value") {
+            char* argv[] = {prog, addr, key};
+            CHECK(cli_parser.parse(3, argv));
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#include <doctest.h>
+
+#include <cli_parser.h>
+#include <cli_tokenizer.h>
+
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+    std::vector<std::string> split_all(cliap::ShellTokenizer& tokenizer, cliap::TokenStatus& last)
+    {
+        std::vector<std::string> tokens;
+        std::string_view token;
+        while ((last = tokenizer.next(token)) == cliap::TokenStatus::token)
+            tokens.emplace_back(token);
+        return tokens;
+    }
+
+    std::vector<std::string> split(std::string_view text)
+    {
+        cliap::ShellTokenizer tokenizer{text};
+        cliap::TokenStatus last{};
+        return split_all(tokenizer, last);
+    }
+}
+
+TEST_SUITE("Testing cliap::ShellTokenizer" * doctest::description("Command string tokenizer tests")) {
+    TEST_CASE("Testing whitespace, quoting, escapes and comments") {
+        CHECK(split("").empty());
+        CHECK(split(" \t\r\n ").empty());
+        CHECK(split("run  --port\t8080\n-v") == std::vector<std::string>{"run", "--port", "8080", "-v"});
+        CHECK(split("a 'b c' \"d \\\"e\\\" $f\" g\\ h") == std::vector<std::string>{"a", "b c", "d \"e\" $f", "g h"});
+        CHECK(split("x'y'\"z\"w") == std::vector<std::string>{"xyzw"});
+        CHECK(split("'' \"\"") == std::vector<std::string>{"", ""});
+        CHECK(split("a # comment\nb#not-a-comment") == std::vector<std::string>{"a", "b#not-a-comment"});
+        CHECK(split("\"line \\\ncontinued\"") == std::vector<std::string>{"line continued"});
+        CHECK(split("trailing\\") == std::vector<std::string>{"trailing\\"});
+    }
+
+    TEST_CASE("Testing plain tokens are views into the input") {
+        const std::string text = "run --name=plain 'quoted'";
+        cliap::ShellTokenizer tokenizer{text};
+        std::string_view token;
+
+        REQUIRE(tokenizer.next(token) == cliap::TokenStatus::token);
+        CHECK(token.data() == text.data());
+        REQUIRE(tokenizer.next(token) == cliap::TokenStatus::token);
+        CHECK(token.data() == text.data() + 4);
+        REQUIRE(tokenizer.next(token) == cliap::TokenStatus::token);
+        CHECK(token == "quoted");
+        CHECK(tokenizer.next(token) == cliap::TokenStatus::end);
+    }
+
+    TEST_CASE("Testing unterminated quotes") {
+        cliap::ShellTokenizer tokenizer{"ok 'open"};
+        cliap::TokenStatus last{};
+        CHECK(split_all(tokenizer, last) == std::vector<std::string>{"ok"});
+        CHECK(last == cliap::TokenStatus::unterminated);
+    }
+
+    TEST_CASE("Testing the delimiter search around block boundaries") {
+        const std::string specials = " \t\n\v\f\r'\"\\";
+        for (std::size_t length = 0; length < 40; ++length) {
+            for (std::size_t at = 0; at <= length; ++at) {
+                for (const char special : specials) {
+                    std::string text(length, 'x');
+                    // Bytes just outside the special ranges must not match
+                    for (std::size_t i = 0; i < text.size(); i += 3)
+                        text[i] = i % 2 ? '\x08' : '\x0e';
+                    if (at < length)
+                        text[at] = special;
+
+                    CHECK(cliap::detail::find_shell_special(text) == at);
+                }
+            }
+        }
+
+        const std::string high(64, '\xe9');
+        CHECK(cliap::detail::find_shell_special(high) == high.size());
+    }
+
+    TEST_CASE("Testing incremental input in chunks of every size") {
+        const std::string text =
+            "deploy --name \"web server\" --tag=a\\ b 'x y' # note\n"
+            "--replicas 3 --long-option-name-beyond-one-block=value-beyond-one-block \"\"";
+        const auto expected = split(text);
+
+        for (std::size_t chunk = 1; chunk <= text.size(); ++chunk) {
+            cliap::ShellTokenizer tokenizer;
+            std::vector<std::string> tokens;
+            cliap::TokenStatus last{};
+
+            for (std::size_t pos = 0; pos < text.size(); pos += chunk) {
+                tokenizer.feed(std::string_view{text}.substr(pos, chunk));
+                for (const auto& token : split_all(tokenizer, last))
+                    tokens.push_back(token);
+                CHECK(last == cliap::TokenStatus::need_more);
+            }
+
+            tokenizer.finish();
+            for (const auto& token : split_all(tokenizer, last))
+                tokens.push_back(token);
+
+            CHECK(last == cliap::TokenStatus::end);
+            CHECK(tokens == expected);
+        }
+
+        cliap::ShellTokenizer open;
+        cliap::TokenStatus last{};
+        open.feed("a \"still open");
+        CHECK(split_all(open, last) == std::vector<std::string>{"a"});
+        CHECK(last == cliap::TokenStatus::need_more);
+        open.finish();
+        CHECK(split_all(open, last).empty());
+        CHECK(last == cliap::TokenStatus::unterminated);
+    }
+
+    TEST_CASE("Testing parse_command_line") {
+        cliap::ArgParser cli_parser;
+        cli_parser
+            .add_parameter(cliap::Arg().short_name("-p").long_name("--port").required())
+            .add_parameter(cliap::Arg().short_name("-n").long_name("--name"))
+            .add_parameter(cliap::Arg().long_name("--files").positional().repeated());
+
+        SUBCASE("Through the parser") {
+            std::string line = "server --port 8080 --name 'my service' a.txt \"b c.txt\"";
+            REQUIRE(!cli_parser.parse_command_line(line));
+
+            // Values do not point into the caller's buffer
+            line.assign(line.size(), '#');
+
+            CHECK(cli_parser.arg("port").get_value_as<int>() == 8080);
+            CHECK(cli_parser.arg("name").value() == "my service"s);
+            CHECK(cli_parser.arg("files").values().size() == 2);
+            CHECK(cli_parser.arg("files").values()[1] == "b c.txt");
+
+            CHECK(cli_parser.parse_command_line("server --name 'open"));
+        }
+
+        SUBCASE("Through a schema with a reused result") {
+            const auto schema = cli_parser.schema();
+            cliap::ParseResult result;
+
+            const std::string line = "server -p 1 --name=\"quoted name\" f1 f2 f3";
+            schema->parse_command_line(line, result);
+            REQUIRE(result.ok());
+
+            schema->parse_command_line(line, result);
+            CHECK(result.ok());
+            CHECK(result.arg("name").value() == "quoted name"s);
+            CHECK(result.arg("files").values().size() == 3);
+
+            const auto missing = schema->parse_command_line("server --name x");
+            REQUIRE(!missing.ok());
+            CHECK(*missing.error() == "Expected required parameter value: p [port]"s);
+        }
+    }
+}
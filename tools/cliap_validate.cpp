@@ -0,0 +1,144 @@
+// cliap-validate: checks files holding one command line per line against a
+// schema, on every hardware thread, and prints the lines that do not parse.
+
+#include <cli_batch.h>
+#include <cli_parser.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+
+namespace {
+    constexpr int exit_invalid = 1;
+    constexpr int exit_usage = 2;
+
+    // A schema file declares one arg per line: its names as cliap::Arg takes
+    // them, then any of required, flag, repeated, multi_value, positional and
+    // default=<value>. Blank lines and lines starting with '#' are skipped.
+    //
+    //     p,port     required
+    //     v,verbose  flag
+    //     I,include  repeated
+    //     input      positional
+    std::optional<std::string> read_schema(const std::string& path, cliap::ArgParser& parser)
+    {
+        std::ifstream in{path};
+        if (!in)
+            return "Unable to read " + path;
+
+        std::string line;
+        for (std::size_t number = 1; std::getline(in, line); ++number) {
+            std::istringstream words{line};
+            std::string names;
+            if (!(words >> names) || names.front() == '#')
+                continue;
+
+            cliap::Arg arg{names};
+            for (std::string word; words >> word;) {
+                if (word == "required")
+                    arg.required();
+                else if (word == "flag")
+                    arg.flag();
+                else if (word == "repeated")
+                    arg.repeated();
+                else if (word == "multi_value")
+                    arg.multi_value();
+                else if (word == "positional")
+                    arg.positional();
+                else if (word.rfind("default=", 0) == 0)
+                    arg.default_value(word.substr(8));
+                else
+                    return path + ":" + std::to_string(number) + ": unknown attribute: " + word;
+            }
+
+            try {
+                parser.add_parameter(std::move(arg));
+            } catch (const std::exception& e) {
+                return path + ":" + std::to_string(number) + ": " + e.what();
+            }
+        }
+
+        return {};
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::ios::sync_with_stdio(false);
+
+    cliap::ArgParser cli;
+    cli
+        .add_parameter(cliap::Arg().short_name("-h").long_name("--help").flag().description("show help message"))
+        .add_parameter(cliap::Arg().short_name("-s").long_name("--schema").description("schema file, one arg per line"))
+        .add_parameter(cliap::Arg().short_name("-j").long_name("--threads").default_value("0").description("worker threads, 0 for one per hardware thread"))
+        .add_parameter(cliap::Arg().long_name("--chunk-size").default_value("256KiB").description("bytes of lines handed to a worker at a time"))
+        .add_parameter(cliap::Arg().long_name("--response-files").flag().description("expand @file arguments of the lines"))
+        .add_parameter(cliap::Arg().short_name("-q").long_name("--quiet").flag().description("print the summary only"))
+        .add_parameter(cliap::Arg("manifest").positional().description("file of command lines, - for standard input"));
+    cli.add_usage_string("cliap-validate --schema tool.schema [--threads 0] [--quiet] manifest.txt");
+
+    if (const auto error = cli.parse(argc, argv)) {
+        std::cerr << *error << "\n";
+        return exit_usage;
+    }
+
+    if (cli.arg("help").is_parsed()) {
+        cli.print_help();
+        return EXIT_SUCCESS;
+    }
+
+    const auto schema_path = cli.arg("schema").value();
+    const auto manifest = cli.arg("manifest").value();
+    if (schema_path.empty() || manifest.empty()) {
+        std::cerr << "Expected a schema file and a manifest\n";
+        return exit_usage;
+    }
+
+    const auto threads = cli.arg("threads").try_get_value_as<unsigned>();
+    if (!threads) {
+        std::cerr << "--threads: " << cliap::convert_error_message(threads.error) << "\n";
+        return exit_usage;
+    }
+
+    const auto chunk_size = cli.arg("chunk-size").get_value_as_size();
+    if (!chunk_size) {
+        std::cerr << "--chunk-size: " << cliap::convert_error_message(chunk_size.error) << "\n";
+        return exit_usage;
+    }
+
+    cliap::ArgParser tool;
+    if (const auto error = read_schema(schema_path, tool)) {
+        std::cerr << *error << "\n";
+        return exit_usage;
+    }
+    if (cli.arg("response-files").is_parsed())
+        tool.allow_response_files();
+
+    const cliap::BatchValidator validator{tool.schema(), {threads.value, static_cast<std::size_t>(chunk_size.value)}};
+    const bool quiet = cli.arg("quiet").is_parsed();
+    const auto print_error = [&manifest, quiet](const cliap::BatchLine& line) {
+        if (!line.ok() && !quiet)
+            std::cout << manifest << ':' << line.number << ": " << *line.error << '\n';
+    };
+
+    cliap::BatchSummary summary;
+    try {
+        if (manifest == "-") {
+            const std::string text{std::istreambuf_iterator<char>{std::cin}, std::istreambuf_iterator<char>{}};
+            summary = validator.validate(text, print_error);
+        } else {
+            summary = validator.validate_file(manifest, print_error);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return exit_usage;
+    }
+
+    std::cout.flush();
+    std::cerr << summary.lines << " lines, " << summary.errors << " invalid\n";
+    return summary.errors == 0 ? EXIT_SUCCESS : exit_invalid;
+}